@@ -137,7 +137,7 @@ private:
 	void init_prolog_regs();
 
 	//TODO: xxx not a good solution
-	void check_file_symbolics();
+	vector<string> check_file_symbolics();
 
 	void init_concolics();
 	void cleanup_concolics();
@@ -2,6 +2,7 @@
 #include "../Core/Memory.h"
 #include "klee/ExecutionState.h"
 #include "crete/test_case.h"
+#include "crete/trace_container.h"
 
 #include <iostream>
 #include <sstream>
@@ -148,7 +149,7 @@ map_concolics_ty QemuRuntimeInfo::get_mapConcolics() const
  * */
 void QemuRuntimeInfo::init_prolog_regs()
 {
-	ifstream i_regs("dump_tbPrologue_regs.bin", ios_base::binary);
+	crete::TraceArtifactStream i_regs(".", "dump_tbPrologue_regs.bin");
 	assert(i_regs && "Fail to open file: dump_tbPrologue_regs.bin\n");
 
 	uint64_t offset_regs;
@@ -185,17 +186,18 @@ void QemuRuntimeInfo::init_prolog_regs()
 	i_regs.clear();
 }
 
-void QemuRuntimeInfo::check_file_symbolics()
+// Entries of "dump_mo_symbolics.txt", without duplicates, in order
+vector<string> QemuRuntimeInfo::check_file_symbolics()
 {
-    ifstream ifs("dump_mo_symbolics.txt", ios_base::binary);
+    crete::TraceArtifactStream ifs(".", "dump_mo_symbolics.txt");
+    assert(ifs && "failed to open dump_mo_symbolics file!");
+
     vector<string> symbolics;
     string symbolic_entry;
     while(getline(ifs, symbolic_entry, '\n')) {
     	symbolics.push_back(symbolic_entry);
     }
 
-    ifs.close();
-
     set<string> unique_symbolics;
     vector<string> output_symbolics;
     for(vector<string>::iterator i = symbolics.begin();
@@ -205,12 +207,7 @@ void QemuRuntimeInfo::check_file_symbolics()
     	}
     }
 
-    ofstream ofs("dump_mo_symbolics.txt", ios_base::binary);
-    for(vector<string>::iterator i = output_symbolics.begin();
-        		i != output_symbolics.end(); ++i) {
-    	ofs << *i << '\n';
-    }
-    ofs.close();
+    return output_symbolics;
 }
 
 //Get the information of concolic variables from file "dump_mo_symbolics" and "concrete_inputs.bin"
@@ -218,9 +215,9 @@ void QemuRuntimeInfo::init_concolics()
 {
     using namespace crete;
 
-    check_file_symbolics();
+    vector<string> symbolics = check_file_symbolics();
 
-    ifstream inputs("concrete_inputs.bin", ios_base::in | ios_base::binary);
+    crete::TraceArtifactStream inputs(".", "concrete_inputs.bin");
     assert(inputs && "failed to open concrete_inputs file!");
     TestCase tc = read_test_case(inputs);
 
@@ -237,9 +234,6 @@ void QemuRuntimeInfo::init_concolics()
     }
     assert(map_concrete_value.size() == tc_elements.size());
 
-    ifstream ifs("dump_mo_symbolics.txt");
-    assert(ifs && "failed to open dump_mo_symbolics file!");
-
     string name;
     vector<uint8_t> concrete_value;
     uint64_t data_size;
@@ -251,10 +245,10 @@ void QemuRuntimeInfo::init_concolics()
 
     map<string, cv_concrete_ty>::iterator map_it;
     ConcolicVariable *cv;
-    string line;
 
-    while(getline(ifs, line)) {
-        stringstream sym_ss(line);
+    for(vector<string>::iterator line = symbolics.begin();
+        line != symbolics.end(); ++line) {
+        stringstream sym_ss(*line);
         sym_ss >> name;
         sym_ss >> name_addr;
         sym_ss >> fake_val;
@@ -305,7 +299,7 @@ void QemuRuntimeInfo::cleanup_concolics()
  * */
 void QemuRuntimeInfo::init_memoSyncTables()
 {
-	ifstream i_sm("dump_sync_memos.bin", ios_base::binary);
+	crete::TraceArtifactStream i_sm(".", "dump_sync_memos.bin");
 	assert(i_sm && "open file failed: dump_sync_memos.bin\n");
 
 	// - amount of dumped TBs (amt_dumped_tbs)// 8 bytes
@@ -368,8 +362,6 @@ void QemuRuntimeInfo::init_memoSyncTables()
 	assert(amt_memoSyncTables == 0 &&
 			"Reading file error: the amount of non-empty memoSyncTable is not matched.\n");
 
-	i_sm.close();
-
 	CRETE_DBG(print_memoSyncTables(););
 }
 
@@ -412,7 +404,7 @@ void QemuRuntimeInfo::print_memoSyncTables()
  * */
 void QemuRuntimeInfo::init_interruptStates()
 {
-	ifstream i_sm("dump_qemu_interrupt_info.bin", ios_base::binary);
+	crete::TraceArtifactStream i_sm(".", "dump_qemu_interrupt_info.bin");
 	assert(i_sm && "open file failed: dump_qemu_interrupt_info.bin\n");
 
 	// sizeof(QemuInterruptInfo) (size_QemuInterruptInfo) // 8 bytes
@@ -459,8 +451,6 @@ void QemuRuntimeInfo::init_interruptStates()
 
 	assert(amt_valid_interruptStates == 0 &&
 			"Reading file error: the amount of non-empty interruptState is not matched.\n");
-
-	i_sm.close();
 }
 #else
 /* The format of "dump_qemu_interrupt_info.bin" is:
@@ -476,7 +466,7 @@ void QemuRuntimeInfo::init_interruptStates()
  * */
 void QemuRuntimeInfo::init_interruptStates()
 {
-	ifstream i_sm("dump_qemu_interrupt_info.bin", ios_base::binary);
+	crete::TraceArtifactStream i_sm(".", "dump_qemu_interrupt_info.bin");
 	assert(i_sm && "open file failed: dump_qemu_interrupt_info.bin\n");
 
 	// sizeof(QemuInterruptInfo) (size_QemuInterruptInfo) // 8 bytes
@@ -532,8 +522,6 @@ void QemuRuntimeInfo::init_interruptStates()
 
 	assert(amt_valid_interruptStates == 0 &&
 			"Reading file error: the amount of non-empty interruptState is not matched.\n");
-
-	i_sm.close();
 }
 #endif
 
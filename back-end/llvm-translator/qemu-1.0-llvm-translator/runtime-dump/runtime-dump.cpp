@@ -1849,19 +1849,12 @@ void RuntimeEnv::writeTBBranchResults()
 #endif // defined(HAVLICEK_TB_GRAPH)
 
 
-void RuntimeEnv::dump_tlo_tb_pc(const uint64_t pc)
+uint64_t RuntimeEnv::dump_tb_ir(const uint64_t pc,
+		const TCGContext &tcg_ctx,
+		const vector<uint16_t> &opc_buf,
+		const vector<uint64_t> &opparam_buf)
 {
-	m_tcg_llvm_offline_ctx.dump_tlo_tb_pc(pc);
-}
-
-void RuntimeEnv::dump_tcg_ctx(const TCGContext &tcg_ctx)
-{
-	m_tcg_llvm_offline_ctx.dump_tcg_ctx(tcg_ctx);
-}
-
-void RuntimeEnv::dump_tcg_temp(const vector<TCGTemp> &tcg_temp)
-{
-	m_tcg_llvm_offline_ctx.dump_tcg_temp(tcg_temp);
+	return m_tcg_llvm_offline_ctx.dump_tb(pc, tcg_ctx, opc_buf, opparam_buf);
 }
 
 void RuntimeEnv::dump_tcg_helper_name(const TCGContext &tcg_ctx)
@@ -1869,16 +1862,6 @@ void RuntimeEnv::dump_tcg_helper_name(const TCGContext &tcg_ctx)
 	m_tcg_llvm_offline_ctx.dump_tcg_helper_name(tcg_ctx);
 }
 
-void RuntimeEnv::dump_tlo_opc_buf(const uint64_t *opc_buf)
-{
-	m_tcg_llvm_offline_ctx.dump_tlo_opc_buf(opc_buf);
-}
-
-void RuntimeEnv::dump_tlo_opparam_buf(const uint64_t *opparam_buf)
-{
-	m_tcg_llvm_offline_ctx.dump_tlo_opparam_buf(opparam_buf);
-}
-
 void RuntimeEnv::writeTcgLlvmCtx()
 {
 	cout << "writeTcgLlvmCtx is invoked." << endl;
@@ -314,15 +314,12 @@ public:
     void verifyDumpData();
 #endif
 
-    void dump_tlo_tb_pc(const uint64_t pc);
-
-    void dump_tcg_ctx(const TCGContext& tcg_ctx);
-    void dump_tcg_temp(const vector<TCGTemp>& tcg_temp);
+    uint64_t dump_tb_ir(const uint64_t pc,
+                        const TCGContext& tcg_ctx,
+                        const vector<uint16_t>& opc_buf,
+                        const vector<uint64_t>& opparam_buf);
     void dump_tcg_helper_name(const TCGContext &tcg_ctx);
 
-    void dump_tlo_opc_buf(const uint64_t *opc_buf);
-    void dump_tlo_opparam_buf(const uint64_t *opparam_buf);
-
 private:
 	string getOutputFilename(const string &fileName);
 	llvm::raw_ostream* openOutputFile(const string &fileName);
@@ -5,8 +5,19 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <set>
+#include <sstream>
 #include <string>
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 extern "C" {
 #include "tcg.h"
@@ -15,9 +26,13 @@ extern "C" {
 #include "tcg-llvm.h"
 #include "runtime-dump/custom-instructions.h"
 
+#include <crete/trace_container.h>
+
 #include <iostream>
 #include <fstream>
 
+#include <llvm/Function.h>
+#include <llvm/Module.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Path.h>
 
@@ -27,19 +42,69 @@ extern "C" {
 const TCGLLVMOfflineContext *g_tcg_llvm_offline_ctx = 0;
 }
 
-void TCGLLVMOfflineContext::dump_tlo_tb_pc(const uint64_t pc)
+// Whether two temps translate the same: only what the translator reads of a temp is compared,
+// as the rest (e.g. the register a global was last allocated) changes from one translation to the next.
+static bool same_temp(const TCGTemp &a, const TCGTemp &b)
 {
-	m_tlo_tb_pc.push_back(pc);
+	return a.base_type == b.base_type &&
+			a.type == b.type &&
+			a.fixed_reg == b.fixed_reg &&
+			a.temp_local == b.temp_local &&
+			(!a.fixed_reg || a.reg == b.reg) &&
+			a.mem_reg == b.mem_reg &&
+			a.mem_offset == b.mem_offset &&
+			(a.name == b.name || (a.name && b.name && strcmp(a.name, b.name) == 0));
 }
 
-void TCGLLVMOfflineContext::dump_tcg_ctx(const TCGContext& tcg_ctx)
+uint64_t TCGLLVMOfflineContext::dump_tb(const uint64_t pc,
+		const TCGContext& tcg_ctx,
+		const vector<uint16_t>& opc_buf,
+		const vector<uint64_t>& opparam_buf)
 {
+	assert(!opc_buf.empty() && opc_buf.back() == INDEX_op_end);
+	assert(opc_buf.size() <= OPC_BUF_SIZE);
+	assert(opparam_buf.size() <= OPPARAM_BUF_SIZE);
+
+	size_t hash = 0;
+	boost::hash_combine(hash, boost::hash_range(opc_buf.begin(), opc_buf.end()));
+	boost::hash_combine(hash, boost::hash_range(opparam_buf.begin(), opparam_buf.end()));
+
+	const pair<uint64_t, uint64_t> key(pc, hash);
+
+	typedef multimap<pair<uint64_t, uint64_t>, uint64_t>::const_iterator iter_ty;
+	pair<iter_ty, iter_ty> range = m_tb_ids.equal_range(key);
+
+	for(iter_ty it = range.first; it != range.second; ++it) {
+		const uint64_t id = it->second;
+		const TCGContext &ctx = m_tcg_ctx[id];
+		const vector<TCGTemp> &temps = m_tcg_temps[id];
+
+		if(ctx.nb_globals != tcg_ctx.nb_globals ||
+				ctx.nb_labels != tcg_ctx.nb_labels ||
+				temps.size() != (uint64_t)tcg_ctx.nb_temps ||
+				m_gen_opc_buf[id] != opc_buf ||
+				m_gen_opparam_buf[id] != opparam_buf)
+			continue;
+
+		bool same = true;
+		for(uint64_t i = 0; same && i < temps.size(); ++i)
+			same = same_temp(temps[i], tcg_ctx.temps[i]);
+
+		if(same)
+			return id;
+	}
+
+	const uint64_t id = m_tlo_tb_pc.size();
+
+	m_tlo_tb_pc.push_back(pc);
 	m_tcg_ctx.push_back(tcg_ctx);
-}
+	m_tcg_temps.push_back(vector<TCGTemp>(tcg_ctx.temps, tcg_ctx.temps + tcg_ctx.nb_temps));
+	m_gen_opc_buf.push_back(opc_buf);
+	m_gen_opparam_buf.push_back(opparam_buf);
 
-void TCGLLVMOfflineContext::dump_tcg_temp(const vector<TCGTemp>& tcg_temp)
-{
-	m_tcg_temps.push_back(tcg_temp);
+	m_tb_ids.insert(make_pair(key, id));
+
+	return id;
 }
 
 void TCGLLVMOfflineContext::dump_tcg_helper_name(const TCGContext &tcg_ctx)
@@ -57,30 +122,6 @@ void TCGLLVMOfflineContext::dump_tcg_helper_name(const TCGContext &tcg_ctx)
 			<< m_helper_names.size() << endl;
 }
 
-void TCGLLVMOfflineContext::dump_tlo_opc_buf(const uint64_t *opc_buf)
-{
-	vector<uint64> temp_opc_buf;
-	temp_opc_buf.reserve(OPC_BUF_SIZE);
-
-	for(uint32_t i = 0; i < OPC_BUF_SIZE; ++i)
-		temp_opc_buf.push_back(opc_buf[i]);
-	assert(temp_opc_buf.size() == OPC_BUF_SIZE);
-
-	m_gen_opc_buf.push_back(temp_opc_buf);
-}
-
-void TCGLLVMOfflineContext::dump_tlo_opparam_buf(const uint64_t *opparam_buf)
-{
-	vector<uint64> temp_opparam_buf;
-	temp_opparam_buf.reserve(OPPARAM_BUF_SIZE);
-
-	for(uint32_t i = 0; i < OPPARAM_BUF_SIZE; ++i)
-		temp_opparam_buf.push_back(opparam_buf[i]);
-	assert(temp_opparam_buf.size() == OPPARAM_BUF_SIZE);
-
-	m_gen_opparam_buf.push_back(temp_opparam_buf);;
-}
-
 const uint64_t TCGLLVMOfflineContext::get_tlo_tb_pc(const uint64_t tb_index)
 {
 	return m_tlo_tb_pc[tb_index];
@@ -105,7 +146,7 @@ const string TCGLLVMOfflineContext::get_helper_name(const uint64_t func_addr) co
 	return it->second;
 }
 
-const vector<uint64_t>& TCGLLVMOfflineContext::get_tlo_opc_buf(const uint64_t tb_index)
+const vector<uint16_t>& TCGLLVMOfflineContext::get_tlo_opc_buf(const uint64_t tb_index)
 {
 	return m_gen_opc_buf[tb_index];
 }
@@ -154,13 +195,187 @@ uint64_t TCGLLVMOfflineContext::get_size()
 }
 
 /*****************************/
-/* Functions for QEMU c code */
-void x86_llvm_translator()
-{
-	cout << "this is the new main function from tcg-llvm-offline.\n" << endl;
+/* Offline translation */
 
+// Translates TBs [begin, end) of the dump into tcg_llvm_ctx, in order of their IDs, which
+// is the order their functions get added to the module. Returns the functions' names.
+static set<string> translate_tbs(TCGLLVMOfflineContext &ctx,
+		const uint64_t begin, const uint64_t end)
+{
 	TranslationBlock temp_tb = {};
 	TCGContext *s = &tcg_ctx;
+	TCGTemp temp_tcg_temps[TCG_MAX_TEMPS];
+	set<string> tb_names;
+
+    // The i-th TB must become the tcg-llvm-tb-<i>-<pc> that main_function.ll calls for every
+    // occurrence of it, wherever the translation starts.
+    tcg_llvm_ctx->setTbCount((int)begin);
+
+    for(uint64_t i = begin; i < end; ++i) {
+        //1 update temp_tb
+    	temp_tb.pc = (target_long)ctx.get_tlo_tb_pc(i);
+
+        //2 update tcg_ctx
+    	const TCGContext& temp_tcg_ctx = ctx.get_tcg_ctx(i);
+    	memcpy((void *)s, (const void *)&temp_tcg_ctx, sizeof(TCGContext));
+
+    	assert(s->temps == NULL);
+    	s->temps = temp_tcg_temps;
+
+    	//3 update tcg_ctx->temps
+    	const vector<TCGTemp>& temp_tcg_temp = ctx.get_tcg_temp(i);
+    	assert( temp_tcg_temp.size() == s->nb_temps);
+    	for(uint64_t j = 0; j < s->nb_temps; ++j)
+    		temp_tcg_temps[j].assign(temp_tcg_temp[j]);
+
+    	//4 update gen_opc_buf and gen_opparam_buf
+    	//  Only the ops up to INDEX_op_end were dumped, which is all generateCode() reads
+    	const vector<uint16_t>& temp_opc_buf = ctx.get_tlo_opc_buf(i);
+    	assert(temp_opc_buf.size() <= OPC_BUF_SIZE);
+    	for(uint64_t j = 0; j < temp_opc_buf.size(); ++j)
+    		gen_opc_buf[j] = temp_opc_buf[j];
+
+    	const vector<uint64_t>& temp_opparam_buf = ctx.get_tlo_opparam_buf(i);
+    	assert(temp_opparam_buf.size() <= OPPARAM_BUF_SIZE);
+    	for(uint64_t j = 0; j < temp_opparam_buf.size(); ++j)
+    		gen_opparam_buf[j] = (TCGArg)temp_opparam_buf[j];
+
+        //5 generate llvm bitcode
+        temp_tb.tcg_llvm_context = NULL;
+        temp_tb.llvm_function = NULL;
+
+    	tcg_llvm_ctx->generateCode(s, &temp_tb);
+
+    	assert(temp_tb.tcg_llvm_context != NULL);
+        assert(temp_tb.llvm_function != NULL);
+
+        tb_names.insert(temp_tb.llvm_function->getName().str());
+    }
+
+    return tb_names;
+}
+
+// Strips a worker's module down to the TB functions it translated. What they use of the
+// helper libraries is left as declarations, resolved against the main process's module,
+// which has the libraries linked, when the shard is linked into it.
+static void strip_to_tbs(llvm::Module *m, const set<string> &tb_names)
+{
+	for(llvm::Module::iterator it = m->begin(); it != m->end(); ++it) {
+		if(tb_names.count(it->getName().str()) == 0 &&
+				!it->isDeclaration() && !it->hasLocalLinkage())
+			it->deleteBody(); // Also makes the linkage external.
+	}
+
+	for(llvm::Module::global_iterator it = m->global_begin(); it != m->global_end(); ++it) {
+		if(it->hasInitializer() && !it->hasLocalLinkage()) {
+			it->setInitializer(NULL);
+			it->setLinkage(llvm::GlobalValue::ExternalLinkage);
+		}
+	}
+
+	// Local definitions are kept while the TBs use them (the linker renames them apart).
+	// Drop what nothing uses any more, which frees up more, until nothing changes.
+	bool changed = true;
+	while(changed) {
+		changed = false;
+
+		for(llvm::Module::iterator it = m->begin(); it != m->end(); ) {
+			llvm::Function *f = it++;
+
+			if(f->use_empty() && tb_names.count(f->getName().str()) == 0 &&
+					(f->isDeclaration() || f->hasLocalLinkage())) {
+				f->eraseFromParent();
+				changed = true;
+			}
+		}
+
+		for(llvm::Module::global_iterator it = m->global_begin(); it != m->global_end(); ) {
+			llvm::GlobalVariable *g = it++;
+
+			if(g->use_empty() && (g->isDeclaration() || g->hasLocalLinkage())) {
+				g->eraseFromParent();
+				changed = true;
+			}
+		}
+	}
+}
+
+static string shard_file_name(const unsigned shard)
+{
+	ostringstream ss;
+	ss << "dump_llvm_offline." << shard << ".bc";
+
+	return ss.str();
+}
+
+// Translates the dump's TBs in up to 'jobs' processes, each forked after the helper libraries were
+// linked, so each starts from its own copy of the module. Every worker translates a contiguous
+// shard of the TBs and writes just those; the shards are then linked into tcg_llvm_ctx in shard
+// order, which gives the same functions in the same order as translating them all here.
+// The translation relies on process globals (tcg_ctx, gen_opc_buf, the LLVM global context, ...),
+// hence processes rather than threads.
+static void translate_tbs_in_parallel(TCGLLVMOfflineContext &offline_ctx,
+		const uint64_t tb_count, const unsigned jobs)
+{
+	const uint64_t shard_size = (tb_count + jobs - 1) / jobs;
+	const unsigned shard_count = (unsigned)((tb_count + shard_size - 1) / shard_size);
+	vector<pid_t> workers;
+
+	cout.flush(); // Or a worker would write out whatever is buffered again.
+
+	for(unsigned shard = 0; shard < shard_count; ++shard) {
+		const uint64_t begin = shard * shard_size;
+		const uint64_t end = min(begin + shard_size, tb_count);
+
+		pid_t pid = fork();
+
+		if(pid == -1) {
+			cerr << "[CRETE ERROR] fork() failed: " << strerror(errno) << endl;
+			exit(EXIT_FAILURE);
+		}
+
+		if(pid == 0) {
+			const set<string> tb_names = translate_tbs(offline_ctx, begin, end);
+
+			strip_to_tbs(tcg_llvm_ctx->getModule(), tb_names);
+			tcg_llvm_ctx->writeBitCodeToFile(shard_file_name(shard));
+
+			_exit(EXIT_SUCCESS); // Leave the parent's atexit handlers and buffers to the parent.
+		}
+
+		workers.push_back(pid);
+	}
+
+	bool failed = false;
+
+	for(unsigned shard = 0; shard < workers.size(); ++shard) {
+		int status = 0;
+
+		while(waitpid(workers[shard], &status, 0) == -1 && errno == EINTR)
+			;
+
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+			cerr << "[CRETE ERROR] translation of TB shard " << shard << " failed" << endl;
+			failed = true;
+		}
+	}
+
+	for(unsigned shard = 0; shard < workers.size() && !failed; ++shard)
+		tcg_linkWithLibrary(tcg_llvm_ctx, shard_file_name(shard).c_str());
+
+	for(unsigned shard = 0; shard < workers.size(); ++shard)
+		remove(shard_file_name(shard).c_str());
+
+	if(failed)
+		exit(EXIT_FAILURE);
+}
+
+/*****************************/
+/* Functions for QEMU c code */
+
+void x86_llvm_translator(unsigned jobs)
+{
+	cout << "this is the new main function from tcg-llvm-offline.\n" << endl;
 
 	//1. initialize llvm dependencies
     tcg_llvm_ctx = tcg_llvm_initialize();
@@ -179,7 +394,9 @@ void x86_llvm_translator()
 
     TCGLLVMOfflineContext temp_tcg_llvm_offline_ctx;
 
-    ifstream ifs("dump_tcg_llvm_offline.bin");
+    // Read in place from the trace container, when the trace has one.
+    crete::TraceArtifactStream ifs(".", "dump_tcg_llvm_offline.bin");
+    assert(ifs && "failed to open dump_tcg_llvm_offline.bin");
     boost::archive::binary_iarchive ia(ifs);
     ia >> temp_tcg_llvm_offline_ctx;
 
@@ -192,50 +409,21 @@ void x86_llvm_translator()
     g_tcg_llvm_offline_ctx = &temp_tcg_llvm_offline_ctx;
 
     //3. Translate
-	TCGTemp temp_tcg_temps[TCG_MAX_TEMPS];
-    for(uint64_t i = 0; i < temp_tcg_llvm_offline_ctx.get_size(); ++i) {
-        //3.1 update temp_tb
-    	temp_tb.pc = (target_long)temp_tcg_llvm_offline_ctx.get_tlo_tb_pc(i);
+    //   The dump holds each distinct TB once, in the order of their IDs
+    const uint64_t tb_count = temp_tcg_llvm_offline_ctx.get_size();
 
-        //3.2 update tcg_ctx
-    	const TCGContext temp_tcg_ctx = temp_tcg_llvm_offline_ctx.get_tcg_ctx(i);
-    	memcpy((void *)s, (void *)&temp_tcg_ctx, sizeof(TCGContext));
+    if(jobs > tb_count)
+    	jobs = (unsigned)max<uint64_t>(tb_count, 1);
 
-    	assert(s->temps == NULL);
-    	s->temps = temp_tcg_temps;
-
-    	//3.3 update tcg_ctx->temps
-    	const vector<TCGTemp> temp_tcg_temp = temp_tcg_llvm_offline_ctx.get_tcg_temp(i);
-    	assert( temp_tcg_temp.size() == s->nb_temps);
-    	for(uint64_t j = 0; j < s->nb_temps; ++j)
-    		temp_tcg_temps[j].assign(temp_tcg_temp[j]);
-
-    	//3.4 update gen_opc_buf and gen_opparam_buf
-    	const vector<uint64_t>& temp_opc_buf = temp_tcg_llvm_offline_ctx.get_tlo_opc_buf(i);
-    	assert(temp_opc_buf.size() == OPC_BUF_SIZE);
-    	for(uint64_t j = 0; j < OPC_BUF_SIZE; ++j)
-    		gen_opc_buf[j] = (uint16_t)temp_opc_buf[j];
-
-    	const vector<uint64_t>& temp_opparam_buf = temp_tcg_llvm_offline_ctx.get_tlo_opparam_buf(i);
-    	assert(temp_opparam_buf.size() == OPPARAM_BUF_SIZE);
-    	for(uint64_t j = 0; j < OPPARAM_BUF_SIZE; ++j)
-    		gen_opparam_buf[j] = (TCGArg)temp_opparam_buf[j];
-
-        //3.5 generate llvm bitcode
-    	cout << "tcg_llvm_ctx->generateCode(s, &temp_tb) will be invoked." << endl;
-        temp_tb.tcg_llvm_context = NULL;
-        temp_tb.llvm_function = NULL;
-
-    	tcg_llvm_ctx->generateCode(s, &temp_tb);
-    	cout << "tcg_llvm_ctx->generateCode(s, &temp_tb) is done." << endl;
-
-
-    	assert(temp_tb.tcg_llvm_context != NULL);
-        assert(temp_tb.llvm_function != NULL);
-
-//        break;
-    }
+    if(jobs <= 1)
+    	translate_tbs(temp_tcg_llvm_offline_ctx, 0, tb_count);
+    else
+    	translate_tbs_in_parallel(temp_tcg_llvm_offline_ctx, tb_count, jobs);
 
+#if defined(CRETE_DEBUG)
+    cout << "translated " << dec << tb_count << " distinct TBs in "
+    		<< jobs << " job(s)" << endl;
+#endif
 
 	//4. Write out the translated llvm bitcode to file in the current folder
 	llvm::sys::Path bitcode_path = llvm::sys::Path::GetCurrentDirectory();
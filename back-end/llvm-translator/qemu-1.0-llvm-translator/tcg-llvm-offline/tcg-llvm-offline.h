@@ -8,7 +8,7 @@ extern "C" {
 struct TCGLLVMOfflineContext;
 extern const struct TCGLLVMOfflineContext *g_tcg_llvm_offline_ctx;
 
-void x86_llvm_translator();
+void x86_llvm_translator(unsigned jobs); // Translates in up to jobs processes.
 
 #ifdef __cplusplus
 }
@@ -31,17 +31,22 @@ struct TCGTemp;
 class TCGLLVMOfflineContext
 {
 private:
-	// Required information from QEMU for the offline translation
+	// Required information from QEMU for the offline translation, one entry per distinct TB,
+	// indexed by its ID. A TB retranslated to the same IR, e.g. after a flush, keeps its ID, and
+	// the execution sequence refers to TBs by the ID in their function's name (tcg-llvm-tb-<ID>-<pc>).
 	vector<uint64_t> m_tlo_tb_pc;
 
 	vector<TCGContext> m_tcg_ctx;
 	vector<vector<TCGTemp> > m_tcg_temps;
 	map<uint64_t, string> m_helper_names;
 
-	// QEMU IR opc and opparam for each TB that will be translated
-	vector<vector<uint64_t> > m_gen_opc_buf;
+	// QEMU IR opc and opparam for each TB that will be translated, up to its INDEX_op_end
+	vector<vector<uint16_t> > m_gen_opc_buf;
 	vector<vector<uint64_t> > m_gen_opparam_buf;
 
+	// (pc, hash of the IR) -> IDs of the TBs with it. Only needed while dumping.
+	multimap<pair<uint64_t, uint64_t>, uint64_t> m_tb_ids;
+
 public:
 	TCGLLVMOfflineContext() {};
 	~TCGLLVMOfflineContext() {};
@@ -59,22 +64,20 @@ public:
         ar & m_gen_opparam_buf;
     }
 
-    void dump_tlo_tb_pc(const uint64_t pc);
-
-    void dump_tcg_ctx(const TCGContext& tcg_ctx);
-    void dump_tcg_temp(const vector<TCGTemp>& tcg_temp);
+    // Returns the ID of the TB with this IR, adding the TB if its IR is new
+    uint64_t dump_tb(const uint64_t pc,
+                     const TCGContext& tcg_ctx,
+                     const vector<uint16_t>& opc_buf,
+                     const vector<uint64_t>& opparam_buf);
     void dump_tcg_helper_name(const TCGContext &tcg_ctx);
 
-    void dump_tlo_opc_buf(const uint64_t *opc_buf);
-    void dump_tlo_opparam_buf(const uint64_t *opparam_buf);
-
     const uint64_t get_tlo_tb_pc(const uint64_t tb_index);
 
     const TCGContext& get_tcg_ctx(const uint64_t tb_index);
     const vector<TCGTemp>& get_tcg_temp(const uint64_t tb_index);
     const string get_helper_name(const uint64_t func_addr) const;
 
-    const vector<uint64_t>& get_tlo_opc_buf(const uint64_t tb_index);
+    const vector<uint16_t>& get_tlo_opc_buf(const uint64_t tb_index);
     const vector<uint64_t>& get_tlo_opparam_buf(const uint64_t tb_index);
 
     void print_info();
@@ -1442,15 +1442,9 @@ void TCGLLVMContextPrivate::generateCode(TCGContext *s, TranslationBlock *tb)
     /* Prepare globals and temps information */
     initGlobalsAndLocalTemps();
 
-    cout << "initGlobalsAndLocalTemps() finished." << endl;
-    uint64_t inst_count = 0;
-
     /* Generate code for each opc */
     const TCGArg *args = gen_opparam_buf;
     for(int opc_index=0; ;++opc_index) {
-
-    	// cout << "inst_count: " << dec << inst_count++ << endl;
-
     	int opc = gen_opc_buf[opc_index];
 
         if(opc == INDEX_op_end)
@@ -1592,6 +1586,10 @@ int TCGLLVMContext::getTbCount(){
 	return m_private->m_tbCount;
 }
 
+void TCGLLVMContext::setTbCount(int count){
+	m_private->m_tbCount = count;
+}
+
 void TCGLLVMContext::writeBitCodeToFile(const std::string &fileName) {
 	assert(fileName.c_str());
 	m_private->writeBitCodeToFile(fileName);
@@ -147,6 +147,7 @@ public:
 
 #ifdef BCT_RT_DUMP
     int getTbCount();
+    void setTbCount(int count); // Numbers the functions of the TBs generated next from count on.
     void writeBitCodeToFile(const std::string &fileName);
     void linkWithLibrary(const std::string& libraryName);
 #endif
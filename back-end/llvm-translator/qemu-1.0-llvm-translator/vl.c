@@ -2223,7 +2223,29 @@ static void free_and_trace(gpointer mem)
 #include "tcg-llvm-offline/tcg-llvm-offline.h"
 
 int main(int argc, char **argv) {
+	unsigned jobs = 1;
+	int opt;
+
 	crete_set_data_dir(argv[0]);
-	x86_llvm_translator();
+
+	while((opt = getopt(argc, argv, "j:")) != -1) {
+		char *end = NULL;
+		long n;
+
+		switch(opt) {
+		case 'j':
+			n = strtol(optarg, &end, 10);
+			if(*end == '\0' && n > 0) {
+				jobs = (unsigned)n;
+				break;
+			}
+			/* fall through */
+		default:
+			fprintf(stderr, "usage: %s [-j jobs]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	x86_llvm_translator(jobs);
 	return 0;
 }
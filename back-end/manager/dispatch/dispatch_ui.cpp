@@ -76,6 +76,7 @@ auto DispatchUI::process_config(const pt::ptree& config) -> option::Dispatch
         opts.trace.print_graph_only_branches = trace.get<bool>("print-graph-branches-only", false);
         opts.trace.print_elf_info = trace.get<bool>("print-elf-info", false);
         opts.trace.compress = trace.get<bool>("compress", false);
+        opts.trace.cache_size = trace.get<uint64_t>("cache-size-mb", opts.trace.cache_size / (1024u * 1024u)) * 1024u * 1024u;
 
         if(opts.trace.print_graph && !opts.trace.filter_traces)
             throw Exception{} << err::parse{"trace.print-graph requires trace.filter-traces"};
@@ -165,6 +166,8 @@ auto DispatchUI::process_config(const pt::ptree& config) -> option::Dispatch
         opts.svm.args.symbolic = svm.get<std::string>("args.symbolic", "");
     }
 
+    opts.journal.resume = crete.get<bool>("journal.resume", false);
+
     if(crete.get_child_optional("profile"))
     {
         auto const& profile = crete.get_child("profile");
@@ -34,6 +34,10 @@ void dump_IR(void *, unsigned long long);
 
 #endif
 
+#if defined(CRETE_DEP_ANALYSIS)
+#include "runtime-dump/tci_analyzer.h"
+#endif // defined(CRETE_DEP_ANALYSIS)
+
 int generate_llvm = 0;
 int execute_llvm = 0;
 
@@ -597,9 +601,13 @@ int cpu_exec(CPUState *env)
 #endif
 
 #if defined(CRETE_DEP_ANALYSIS)
+                    /* Until symbolic data appears, a TB that makes none could
+                       only be found concrete: run it without the analyzer's
+                       hooks. */
                     if(is_begin_capture &&
                        is_target_pid &&
-                       is_user_code)
+                       is_user_code &&
+                       crete_tci_analyze_block(tb->crete_makes_concolic))
                     {
                         next_tb = crete_tcg_qemu_tb_exec(env, tc_ptr);
                     }
@@ -192,6 +192,12 @@ struct TranslationBlock {
     struct TranslationBlock* llvm_tb_next[2];
 #endif
 
+#if defined(CRETE_DEP_ANALYSIS)
+    /* set at translation when the TB holds a MAKE_CONCOLIC custom
+       instruction, which brings in symbolic data partway through it */
+    uint8_t crete_makes_concolic;
+#endif
+
 #if defined(CRETE_DBG_INST_BASED_CALL_STACK)
     /*  list of Customized last_opc:
      *  0xFFFF, tb ended by gen_jmp_tb() or unknown
@@ -228,6 +234,10 @@ static inline unsigned int tb_phys_hash_func(tb_page_addr_t pc)
 
 void tb_free(TranslationBlock *tb);
 void tb_flush(CPUState *env);
+#if defined(CRETE_CONFIG)
+void tb_flush_llvm(void);
+extern uint64_t crete_tb_gen_count;
+#endif
 void tb_link_page(TranslationBlock *tb,
                   tb_page_addr_t phys_pc, tb_page_addr_t phys_page2);
 void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr);
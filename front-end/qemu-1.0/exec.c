@@ -240,6 +240,9 @@ static int log_append = 0;
 static int tlb_flush_count;
 #endif
 static int tb_flush_count;
+#if defined(CRETE_CONFIG)
+uint64_t crete_tb_gen_count; /* TBs translated to host code */
+#endif
 static int tb_phys_invalidate_count;
 
 #ifdef _WIN32
@@ -697,6 +700,10 @@ static TranslationBlock *tb_alloc(target_ulong pc)
     tcg_llvm_tb_alloc(tb);
 #endif
 
+#if defined(CRETE_DEP_ANALYSIS)
+    tb->crete_makes_concolic = 0;
+#endif
+
     return tb;
 }
 
@@ -791,6 +798,20 @@ void tb_flush(CPUState *env1)
     tb_flush_count++;
 }
 
+#if defined(CRETE_CONFIG)
+/* Drop the TBs' references to the LLVM functions of a finished trace, whose
+   context is about to be freed, while keeping their host code: TBs are
+   translated to LLVM again, on demand, when the next trace executes them. */
+void tb_flush_llvm(void)
+{
+#if defined(CONFIG_LLVM)
+    int i;
+    for(i = 0; i < nb_tbs; ++i)
+        tcg_llvm_tb_free(&tbs[i]);
+#endif
+}
+#endif
+
 #ifdef DEBUG_TB_CHECK
 
 static void tb_invalidate_check(target_ulong address)
@@ -1023,6 +1044,9 @@ TranslationBlock *tb_gen_code(CPUState *env,
     int code_gen_size;
 
     phys_pc = get_page_addr_code(env, pc);
+#if defined(CRETE_CONFIG)
+    crete_tb_gen_count++;
+#endif
     tb = tb_alloc(pc);
     if (!tb) {
         /* flush must be done */
@@ -20,6 +20,7 @@ extern "C" {
 #include <tcg-llvm.h>
 #include <crete/custom_opcode.h>
 #include <crete/debug_flags.h>
+#include <crete/trace_channel.h>
 #include <boost/system/system_error.hpp>
 #include <boost/filesystem/fstream.hpp>
 
@@ -67,6 +68,11 @@ static bool crete_flag_write_initial_input = false;
 
 const std::string crete_trace_ready_file_name = "trace_ready";
 
+static string crete_test_input; // Serialized TestCase of the current test.
+static bool crete_test_input_read = false;
+static const int crete_test_input_drain_timeout_ms = 1000; // Sent before the test starts: long there by its dump.
+static bool crete_read_test_input();
+
 class PCFilter
 {
 public:
@@ -199,9 +205,9 @@ static void dump_guest_memory(uint64_t msg_addr) {
 
 static void feed_test_case(uint64_t msg_addr) {
 	//======================
-	ifstream i_myfile("hostfile//input_arguments.bin");
+	if (crete_read_test_input()) {
+		istringstream i_myfile(crete_test_input);
 
-	if (i_myfile) {
 		// To feed new test case to guest os by chaning the vlue of argv[i]
 		stringstream tc_ss;
 		vector<string> tc_str_parsed;
@@ -285,9 +291,7 @@ static void feed_test_case(uint64_t msg_addr) {
 
 		if(tc_host_address != -1)
 			memcpy((char *)tc_host_address, input_value.c_str(), input_value.size());
-	} // end of if(i_myfile)
-
-	i_myfile.close();
+	} // end of if(crete_read_test_input())
 }
 
 static void guest_printf_handler(uint64_t msg_addr) {
@@ -356,6 +360,31 @@ static void runtime_dump_cleanup(void)
     }
 }
 
+// TBs translated to host code and to LLVM during the test being dumped.
+// To compare with flushing the TB cache after every test, as was done before: build once with
+// CRETE_DBG_FLUSH_TB_PER_TEST and once without, run the same tests on each, and compare these
+// lines in QEMU's stderr.
+static void print_translation_counts(void)
+{
+    static uint64_t tb_gen_count_at_test_start = 0;
+
+    std::cerr << "[CRETE] translated TBs in this test: "
+              << crete_tb_gen_count - tb_gen_count_at_test_start << " to host code, "
+              << (tcg_llvm_ctx ? get_llvm_tbCount(tcg_llvm_ctx) : 0) << " to LLVM\n";
+
+    tb_gen_count_at_test_start = crete_tb_gen_count;
+}
+
+// Must follow runtime_dump_cleanup()
+static void release_translations(void)
+{
+#if defined(CRETE_DBG_FLUSH_TB_PER_TEST)
+    tb_flush(g_cpuState_bct); // The whole TB cache, as was done before it was kept across tests
+#else
+    tb_flush_llvm(); // Host code stays cached for the next test; only references to tcg_llvm_ctx are dropped.
+#endif // defined(CRETE_DBG_FLUSH_TB_PER_TEST)
+}
+
 struct PIDWriter
 {
     PIDWriter()
@@ -386,6 +415,59 @@ struct PIDWriter
     }
 } pid_writer; // Ctor writes PID when program starts.
 
+struct TraceChannelListener
+{
+    TraceChannelListener()
+    {
+        try
+        {
+            channel.listen(fs::path("hostfile") / crete::trace_channel_file_name);
+        }
+        catch(std::runtime_error& e) // Without the channel, the files in hostfile/ are used.
+        {
+            cerr << "[CRETE] " << e.what() << endl;
+        }
+    }
+
+    crete::TraceChannel channel;
+} trace_channel_listener; // Listens from startup, after pid_writer has made hostfile/, for the VM node to connect.
+
+// Reads the input of the current test, once per test: from the VM node over the trace channel, or,
+// with no node connected, from hostfile/input_arguments.bin. False if there's neither.
+static bool crete_read_test_input()
+{
+    if(crete_test_input_read)
+        return true;
+
+    crete::TraceChannel& channel = trace_channel_listener.channel;
+
+    if(channel.accept(0))
+    {
+        uint32_t type = 0;
+
+        channel.receive(type, crete_test_input, -1); // Sent by the node before the guest starts the test.
+
+        if(type != crete::trace_channel_test_input)
+            throw runtime_error("unexpected message on the trace channel");
+    }
+    else
+    {
+        ifstream ifs("hostfile/input_arguments.bin", ios_base::in | ios_base::binary);
+
+        if(!ifs)
+            return false;
+
+        ostringstream os(ios_base::out | ios_base::binary);
+        os << ifs.rdbuf();
+
+        crete_test_input = os.str();
+    }
+
+    crete_test_input_read = true;
+
+    return true;
+}
+
 static void verify_contiguous_host_address(uint64_t guest_addr, uint64_t size)
 {
     uint64_t host_addr = RuntimeEnv::getHostAddress(g_cpuState_bct, guest_addr, 1);
@@ -445,9 +527,6 @@ static void bct_tcg_custom_instruction_handler(uint64_t arg) {
             return;
         }
 
-        while(fs::exists(crete_trace_ready_file_name))
-            ; // Wait for it to not exist. TODO: not efficient.
-
         if(g_crete_tmp_workaround == true) // Temporary. May be false in case error (bug) happened and need to bypass dump.
         {
             g_custom_inst_emit = 0;
@@ -466,8 +545,9 @@ static void bct_tcg_custom_instruction_handler(uint64_t arg) {
             // Release
             dump_printInfo(runtime_env);
             dump_writeRtEnvToFile(runtime_env, NULL);
-            runtime_dump_cleanup(); // Cleanup must happen before tb_flush (or crash occurs).
-            tb_flush(g_cpuState_bct); // Flush tb cache, so references to runtime_env/tcg_llvm_ctx are destroyed.
+            print_translation_counts();
+            runtime_dump_cleanup();
+            release_translations();
             // Reacquire
             runtime_env = runtime_dump_initialize();
             assert(runtime_env);
@@ -493,8 +573,9 @@ static void bct_tcg_custom_instruction_handler(uint64_t arg) {
             // Release
             dump_printInfo(runtime_env);
             dump_writeRtEnvToFile(runtime_env, NULL);
-            runtime_dump_cleanup(); // Cleanup must happen before tb_flush (or crash occurs).
-            tb_flush(g_cpuState_bct); // Flush tb cache, so references to runtime_env/tcg_llvm_ctx are destroyed.
+            print_translation_counts();
+            runtime_dump_cleanup();
+            release_translations();
             // Reacquire
             runtime_env = runtime_dump_initialize();
             assert(runtime_env);
@@ -505,6 +586,26 @@ static void bct_tcg_custom_instruction_handler(uint64_t arg) {
             crete_tci_next_iteration();
         }
 
+        // A test that never reached MAKE_CONCOLIC left its input on the channel: drop it, or the next
+        // test would take it for its own. Reading it also frees the node, if it's still sending it.
+        // Bounded, so a node that sent nothing can't stall the dump.
+        if(!crete_test_input_read && trace_channel_listener.channel.accept(0))
+        {
+            uint32_t type = 0;
+            string unread;
+
+            if(trace_channel_listener.channel.receive(type, unread, crete_test_input_drain_timeout_ms) &&
+               type != crete::trace_channel_test_input)
+            {
+                throw runtime_error("unexpected message on the trace channel");
+            }
+        }
+
+        if(trace_channel_listener.channel.accept(0))
+        {
+            trace_channel_listener.channel.send(crete::trace_channel_trace_ready, string());
+        }
+        else
         {
             fs::ofstream ofs(fs::path("hostfile") / crete_trace_ready_file_name);
 
@@ -514,6 +615,8 @@ static void bct_tcg_custom_instruction_handler(uint64_t arg) {
             }
         }
 
+        crete_test_input_read = false; // The next test brings its own.
+
         break;
     }
     case CRETE_INSTR_MAKE_CONCOLIC_VALUE: // Dump Memory Object (MO) value/addr start.
@@ -552,7 +655,9 @@ static void bct_tcg_custom_instruction_handler(uint64_t arg) {
             }
 #endif // !defined(TARGET_X86_64)
 
-            if(flag_is_first_iteration && !boost::filesystem::exists("hostfile/input_arguments.bin"))
+            const bool has_test_input = crete_read_test_input();
+
+            if(flag_is_first_iteration && !has_test_input)
             {
                 memset((void*)cmo.data_host_addr_, 0, cmo.data_size_);
 
@@ -560,7 +665,7 @@ static void bct_tcg_custom_instruction_handler(uint64_t arg) {
             }
             else
             {
-                runtime_env->feed_test_case("hostfile/input_arguments.bin");
+                runtime_env->feed_test_case(crete_test_input);
             }
         }
         catch(std::runtime_error& e) // Temporary "tee" bug workaround
@@ -0,0 +1,145 @@
+#include "memo_sync_table.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace std;
+
+ConcreteMemoInfo::ConcreteMemoInfo(uint64_t addr, uint32_t size, const uint8_t *data)
+	: m_addr(addr), m_size(size)
+{
+	assert(size > 0);
+
+	if(size <= sizeof(m_inline))
+		memcpy(m_inline, data, size);
+	else
+		m_data.assign(data, data + size);
+}
+
+// The first entry overlapping a range that starts at addr, or, if there is none, the first
+// entry after addr
+MemoSyncTable::entries_ty::iterator MemoSyncTable::first_overlap(uint64_t addr)
+{
+	entries_ty::iterator it = m_entries.upper_bound(addr);
+
+	if(it != m_entries.begin()) {
+		entries_ty::iterator prev = it;
+		--prev;
+
+		if(prev->second.end() > addr)
+			return prev;
+	}
+
+	return it;
+}
+
+void MemoSyncTable::add(uint64_t addr, uint32_t size, const uint8_t *data)
+{
+	const uint64_t end = addr + size;
+
+	entries_ty::iterator first = first_overlap(addr);
+	entries_ty::iterator last = first;
+	while(last != m_entries.end() && last->first < end)
+		++last;
+
+	// No overlaps: a new entry
+	if(first == last) {
+		m_entries.insert(last, make_pair(addr, ConcreteMemoInfo(addr, size, data)));
+		return;
+	}
+
+	// Within an existing entry, which keeps its bytes: nothing changes. The common case of
+	// the same memory being read again.
+	if(first->first <= addr && end <= first->second.end())
+		return;
+
+	entries_ty::iterator back = last;
+	--back;
+
+	const uint64_t merged_addr = min(addr, first->first);
+	const uint64_t merged_end = max(end, back->second.end());
+	vector<uint8_t> merged(merged_end - merged_addr);
+
+	memcpy(&merged[addr - merged_addr], data, size);
+
+	for(entries_ty::iterator it = first; it != last; ++it)
+		memcpy(&merged[it->first - merged_addr], it->second.data(), it->second.m_size);
+
+	m_entries.erase(first, last);
+	m_entries.insert(last, make_pair(merged_addr,
+			ConcreteMemoInfo(merged_addr, merged.size(), &merged[0])));
+}
+
+void MemoSyncTable::merge(const MemoSyncTable &later)
+{
+	// A few entries into a large table, like a single TB's into those of a long run of TBs, are
+	// quicker added one by one, in O(k log n), than by going over the whole table
+	if(later.size() * 16 < size()) {
+		for(const_iterator it = later.begin(); it != later.end(); ++it)
+			add(it->first, it->second.m_size, it->second.data());
+
+		return;
+	}
+
+	merge_linear(later);
+}
+
+// Union of the two sorted lists of ranges in one pass. Each run of ranges that overlap one another,
+// from either table, becomes one entry, as adding them one by one would make it.
+void MemoSyncTable::merge_linear(const MemoSyncTable &later)
+{
+	entries_ty merged;
+	const_iterator a = m_entries.begin();
+	const_iterator b = later.begin();
+
+	while(a != m_entries.end() || b != later.end()) {
+		const const_iterator a_first = a;
+		const const_iterator b_first = b;
+		uint64_t run_addr;
+		uint64_t run_end;
+		uint32_t run_count = 1;
+
+		if(b == later.end() || (a != m_entries.end() && a->first <= b->first)) {
+			run_addr = a->first;
+			run_end = a->second.end();
+			++a;
+		} else {
+			run_addr = b->first;
+			run_end = b->second.end();
+			++b;
+		}
+
+		for(;;) {
+			if(a != m_entries.end() && a->first < run_end) {
+				run_end = max(run_end, a->second.end());
+				++a;
+			} else if(b != later.end() && b->first < run_end) {
+				run_end = max(run_end, b->second.end());
+				++b;
+			} else {
+				break;
+			}
+
+			++run_count;
+		}
+
+		if(run_count == 1) {
+			merged.insert(merged.end(), a_first != a ? *a_first : *b_first);
+			continue;
+		}
+
+		vector<uint8_t> bytes(run_end - run_addr);
+
+		for(const_iterator it = b_first; it != b; ++it)
+			memcpy(&bytes[it->first - run_addr], it->second.data(), it->second.m_size);
+
+		for(const_iterator it = a_first; it != a; ++it) // This table's bytes win
+			memcpy(&bytes[it->first - run_addr], it->second.data(), it->second.m_size);
+
+		merged.insert(merged.end(), make_pair(run_addr,
+				ConcreteMemoInfo(run_addr, bytes.size(), &bytes[0])));
+	}
+
+	m_entries.swap(merged);
+}
@@ -0,0 +1,56 @@
+#ifndef CRETE_MEMO_SYNC_TABLE_H
+#define CRETE_MEMO_SYNC_TABLE_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+// Concrete bytes read from guest memory, from one load or several overlapping ones
+struct ConcreteMemoInfo
+{
+	uint64_t m_addr;
+	uint32_t m_size;
+
+	ConcreteMemoInfo(uint64_t addr, uint32_t size, const uint8_t *data);
+
+	uint64_t end() const { return m_addr + m_size; }
+	const uint8_t *data() const { return m_size <= sizeof(m_inline) ? m_inline : &m_data[0]; }
+
+private:
+	uint8_t m_inline[8]; // Data of a single load, which is at most 8 bytes, without a heap allocation
+	std::vector<uint8_t> m_data; // Larger data, from merged loads
+};
+
+/*
+ * The concrete memory read by a TB, or by a run of TBs once merged: disjoint byte ranges keyed by
+ * their start address. A range added over others is merged with them into one, the bytes already
+ * in the table keeping their values. Ranges that only touch are not merged.
+ *
+ * Since the ranges are disjoint, the only one starting before an address that can reach over it is
+ * the last one to, so the overlaps of a range are found in O(log n).
+ */
+class MemoSyncTable
+{
+public:
+	typedef std::map<uint64_t, ConcreteMemoInfo> entries_ty;
+	typedef entries_ty::const_iterator const_iterator;
+
+	void add(uint64_t addr, uint32_t size, const uint8_t *data);
+	void merge(const MemoSyncTable &later); // Adds later's ranges; the bytes in this table win.
+
+	bool empty() const { return m_entries.empty(); }
+	size_t size() const { return m_entries.size(); }
+	const_iterator begin() const { return m_entries.begin(); }
+	const_iterator end() const { return m_entries.end(); }
+	void clear() { m_entries.clear(); }
+
+private:
+	entries_ty::iterator first_overlap(uint64_t addr);
+	void merge_linear(const MemoSyncTable &later);
+
+private:
+	entries_ty m_entries;
+};
+
+#endif // CRETE_MEMO_SYNC_TABLE_H
@@ -27,6 +27,7 @@ extern "C" {
 #include <stack>
 
 #include <crete/test_case.h>
+#include <crete/trace_container.h>
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -216,153 +217,11 @@ void RuntimeEnv::addMemoSyncTableEntry(uint64_t addr, uint32_t size, uint64_t va
 	assert(size <= 8 && "[CRETE ERROR] Data size dumped from qemu is more than 8 bytes!\n");
 	memoSyncTable_ty &last_memoSyncTable = m_memoSyncTables.back();
 
-	vector<uint8_t> v_value;
-	for(uint32_t i = 0; i < size; ++i) {
-		uint8_t temp_value = (value >> i*8) & 0xff;
-		v_value.push_back(temp_value);
-	}
-
-	addMemoSyncTableEntryInternal(addr, size, v_value, last_memoSyncTable);
-
-}
-
-void RuntimeEnv::addMemoSyncTableEntryInternal(uint64_t addr, uint32_t size, vector<uint8_t> v_value,
-		 memoSyncTable_ty& target_memoSyncTable)
-{
-	assert(v_value.size() == size);
-
-	//Find the existing entries that overlap with the new entry
-	vector<uint64_t> overlapped_entries= overlapsMemoSyncEntry(addr, size, target_memoSyncTable);
-
-	// If there is no overlaps, just insert the new entry
-	if(overlapped_entries.empty()){
-		ConcreteMemoInfo entry_memoSyncTable(addr, size, v_value);
-		assert(!m_memoSyncTables.empty());
-
-		target_memoSyncTable.insert(pair<uint64_t, ConcreteMemoInfo>(addr, entry_memoSyncTable));
-	} else {
-		// If there are overlaps, combine them, including the new given one, to one entry while keeping values
-		// of the overlapped bytes from existing entries
-
-		// The address of the new merged entry should be the smallest address
-		uint64_t first_overlapped_addr = overlapped_entries.front();
-		uint64_t new_merged_addr = (first_overlapped_addr < addr) ?
-				first_overlapped_addr : addr;
-
-		uint64_t last_overlapped_addr = overlapped_entries.back();
-		uint64_t last_overlapped_size = target_memoSyncTable.find(last_overlapped_addr)->second.m_size;
-		uint64_t new_merged_end_addr = ((last_overlapped_addr + last_overlapped_size) > (addr + size) ) ?
-				(last_overlapped_addr + last_overlapped_size) : (addr + size);
-
-		uint32_t new_merged_size = new_merged_end_addr - new_merged_addr;
-		vector<uint8_t> new_merged_value;
-
-//		cerr << "new_merged_addr = 0x" << hex << new_merged_addr
-//				<< ", new_merged_size = 0x" << new_merged_size << endl;
-
-		// Write values for new merged entry
-		uint64_t current_writing_byte_addr = new_merged_addr; // The address of the byte that is writing to
-		for(vector<uint64_t>::iterator it = overlapped_entries.begin();
-				it != overlapped_entries.end(); ++it) {
-			memoSyncTable_ty::iterator it_memo_entry = target_memoSyncTable.find(*it);
-			assert(it_memo_entry != target_memoSyncTable.end());
-			uint64_t exist_entry_addr = it_memo_entry->second.m_addr;
-			uint32_t exist_entry_size = it_memo_entry->second.m_size;
-			const vector<uint8_t>& exist_entry_value = it_memo_entry->second.m_data;
-
-//			cerr << "1. exist entry: (0x" << hex << exist_entry_addr << ", 0x" << exist_entry_size << ")" << endl;
-
-			// If the current_writing_byte_addr is smaller, that means we need to get the missing bytes from
-			// the new given entry
-			if (current_writing_byte_addr != exist_entry_addr) {
-//				cerr << "2.1 Get value from new entry.\n";
-				assert(current_writing_byte_addr < exist_entry_addr);
-				while(current_writing_byte_addr < exist_entry_addr){
-					uint32_t offset_given_entry = current_writing_byte_addr - addr;
-					new_merged_value.push_back(v_value[offset_given_entry]);
-					++current_writing_byte_addr;
-				}
-			}
-
-//			cerr << "2.2 Get value from exist entry.\n";
-			assert(current_writing_byte_addr == exist_entry_addr);
-			while(current_writing_byte_addr < exist_entry_addr + exist_entry_size){
-				uint32_t offset_exist_entry = current_writing_byte_addr - exist_entry_addr;
-				assert(offset_exist_entry >= 0 && offset_exist_entry < exist_entry_size);
-				new_merged_value.push_back(exist_entry_value[offset_exist_entry]);
-				++current_writing_byte_addr;
-			}
-
-//			cerr << "3. Erase" << endl;
-			// Delete the overlapped entry
-			target_memoSyncTable.erase(it_memo_entry);
-		}
-
-		if(current_writing_byte_addr < new_merged_end_addr) {
-			assert( current_writing_byte_addr < (addr + size) );
+	uint8_t value_bytes[8];
+	for(uint32_t i = 0; i < size; ++i)
+		value_bytes[i] = (value >> i*8) & 0xff;
 
-			while( current_writing_byte_addr < (addr + size) ){
-				uint32_t offset_given_entry = current_writing_byte_addr - addr;
-				new_merged_value.push_back(v_value[offset_given_entry]);
-				++current_writing_byte_addr;
-			}
-		}
-
-//		cerr << "4. check for addMemoSyncTableEntryInternal\n";
-
-		assert(new_merged_value.size() == new_merged_size);
-		assert(overlapsMemoSyncEntry(addr, size, target_memoSyncTable).empty() &&
-				" There should be no overlapped entries anymore after the merge" );
-		// Insert the new merged entry to
-		ConcreteMemoInfo entry_memoSyncTable(new_merged_addr, new_merged_size, new_merged_value);
-		assert(!m_memoSyncTables.empty());
-
-		target_memoSyncTable.insert(pair<uint64_t, ConcreteMemoInfo>(new_merged_addr, entry_memoSyncTable));
-	}
-}
-
-
-// Check whether the given entry (addr, size) overlaps with existing entries in target_memoSyncTable
-// Return the the address of all the overlapped entries
-vector<uint64_t> RuntimeEnv::overlapsMemoSyncEntry(uint64_t addr, uint32_t size,
-		memoSyncTable_ty target_memoSyncTable)
-{
-	if(target_memoSyncTable.empty())
-		return vector<uint64_t>();
-
-	// Find the last entry that goes before given address, "last before" entry, if found
-	// If all the entries goes after the given address, it_last_before points to the first entry
-	memoSyncTable_ty::iterator it_last_before = target_memoSyncTable.begin();
-	for(memoSyncTable_ty::iterator temp_it = target_memoSyncTable.begin();
-			temp_it != target_memoSyncTable.end(); ++temp_it) {
-		if(temp_it->first < addr) {
-			it_last_before = temp_it;
-//			cerr << "entry goes before is found: (0x " << it_last_before->second.m_addr
-//					<< ", 0x " << it_last_before->second.m_size << ")\n";
-		} else {
-			break;
-		}
-	}
-
-	vector<uint64_t> ret_addrs;
-	// Check the coming entries one by one to see whether they overlaps with the given entry
-	for(memoSyncTable_ty::iterator it_temp = it_last_before;
-			it_temp !=  target_memoSyncTable.end(); ++it_temp){
-		// if the current one overlaps, return it
-		if( (it_temp->second.m_addr + it_temp->second.m_size > addr) &&
-				(it_temp->second.m_addr < addr + size) ) {
-			ret_addrs.push_back(it_temp->second.m_addr);
-
-//			cerr << "overlaps: addr = 0x" << hex << it_temp->second.m_addr
-//					<< ", size = " << dec <<  it_temp->second.m_size << endl;
-		}
-
-		if(it_temp->second.m_addr >= (addr + size)){
-			break;
-		}
-	}
-
-	return ret_addrs;
+	last_memoSyncTable.add(addr, size, value_bytes);
 }
 
 void RuntimeEnv::addMemoMergePoint(MemoMergePoint_ty type_MMP)
@@ -515,22 +374,28 @@ void RuntimeEnv::writeRtEnvToFile(const string& outputDirectory)
 
     dumpConcolicData();
 
+    // Each artifact is a section of one container, named after the file it used to be.
+    crete::TraceContainerWriter container(getOutputFilename(crete::trace_container_file_name));
+
     //	initOutputDirectory(outputDirectory);
-	writeLlvmMainFunction();
+	writeLlvmMainFunction(container);
 //	writeDebugToFile();
-    writeSymbolicMemo();
-	writePrologRegs();
-	writeMemoSyncTables();
-	writeInterruptStates();
-	writeTcgLlvmCtx();
+    writeSymbolicMemo(container);
+	writePrologRegs(container);
+	writeMemoSyncTables(container);
+	writeInterruptStates(container);
+	writeTcgLlvmCtx(container);
+	writeConcreteInputs(container);
 
 #if defined(DBG_TCG_LLVM_OFFLINE)
 	tcg_llvm_ctx->writeBitCodeToFile(getOutputFilename("dump_llvm_online.bc"));
 #endif
 
 #if defined(CRETE_DBG_TB_GRAPH)
-    writeTBAddresses();
+    writeTBAddresses(container);
 #endif // defined(CRETE_DBG_TB_GRAPH)
+
+    container.close();
 }
 
 void RuntimeEnv::printInfo()
@@ -558,16 +423,18 @@ llvm::raw_ostream* RuntimeEnv::openOutputFile(const string &fileName)
 }
 
 
-void RuntimeEnv::feed_test_case(const string& file_name)
+void RuntimeEnv::feed_test_case(const string& test_input)
 {
     using namespace std;
     using namespace crete;
-    ifstream inputs(file_name.c_str(), ios_base::in | ios_base::binary);
+    istringstream inputs(test_input, ios_base::in | ios_base::binary);
 
-    assert(inputs && "failed to open input argument file!");
+    assert(!test_input.empty() && "no input for the test!");
 
     TestCase tc = read_test_case(inputs);
 
+    m_concrete_inputs = test_input;
+
     size_t found_inputs = 0;
     for(vector<TestCaseElement>::const_iterator tc_iter = tc.get_elements().begin();
         tc_iter !=  tc.get_elements().end();
@@ -739,10 +606,10 @@ void RuntimeEnv::writeDebugToFile()
     delete f_debugRaw;
 }
 
-void RuntimeEnv::writeSymbolicMemo()
+void RuntimeEnv::writeSymbolicMemo(crete::TraceContainerWriter& container)
 {
 	if(!m_symbMemos.empty()) {
-		ofstream o_symbMos(getOutputFilename("dump_mo_symbolics.txt").c_str());
+		ostringstream o_symbMos;
 
 		for(vector<string>::iterator it = m_symbMemos.begin();
 				it != m_symbMemos.end(); ++it) {
@@ -750,7 +617,7 @@ void RuntimeEnv::writeSymbolicMemo()
 //			cerr << *it;
 		}
 
-		o_symbMos.close();
+		container.add("dump_mo_symbolics.txt", o_symbMos.str(), true);
 	}
 
 }
@@ -762,7 +629,7 @@ void RuntimeEnv::writeSymbolicMemo()
  * flag to indicate whether a TB needs to update regs // amt_tb bytes
  * data of dumped regs // (amount of TB needs to update regs) * sizeof(regs) bytes
  * */
-void RuntimeEnv::writePrologRegs()
+void RuntimeEnv::writePrologRegs(crete::TraceContainerWriter& container)
 {
 	assert(m_prolog_regs.size() == rt_dump_tb_count);
 
@@ -782,8 +649,7 @@ void RuntimeEnv::writePrologRegs()
 		}
 	}
 
-    ofstream o_regs(getOutputFilename("dump_tbPrologue_regs.bin").c_str(),
-    		ios_base::binary);
+    ostringstream o_regs(ios_base::out | ios_base::binary);
 
     o_regs.write((const char*)&offset_regs, sizeof(offset_regs));
     o_regs.write((const char*)&size_regs_entry, sizeof(size_regs_entry));
@@ -797,7 +663,7 @@ void RuntimeEnv::writePrologRegs()
 		}
 	}
 
-    o_regs.close();
+    container.add("dump_tbPrologue_regs.bin", o_regs.str(), true);
 }
 
 bool RuntimeEnv::overlaps_with_existing_mo(uint64_t addr, size_t size)
@@ -820,7 +686,7 @@ bool RuntimeEnv::overlaps_with_existing_mo(uint64_t addr, size_t size)
 }
 
 // Write main function for off-line replay in the format of llvm
-void RuntimeEnv::writeLlvmMainFunction()
+void RuntimeEnv::writeLlvmMainFunction(crete::TraceContainerWriter& container)
 {
 	if(m_cpuStates.empty()) {
         return;//exit(-1);
@@ -828,7 +694,7 @@ void RuntimeEnv::writeLlvmMainFunction()
 
 	assert(m_tbExecSequ.size() == rt_dump_tb_count);
 
-    ofstream o_mainFunc(getOutputFilename("main_function.ll").c_str());
+    ostringstream o_mainFunc;
 #if defined(TARGET_X86_64)
     string file_name = crete_find_file(CRETE_FILE_TYPE_LLVM_TEMPLATE, "crete-qemu-1.0-template-main-x64.ll");
 #else
@@ -836,9 +702,6 @@ void RuntimeEnv::writeLlvmMainFunction()
 #endif // defined(TARGET_X86_64)
     ifstream i_template(file_name.c_str());
 
-    std::cerr << getOutputFilename("main_function.ll").c_str() << std::endl;
-
-	assert(o_mainFunc);
 	assert(i_template && "template_main.ll is missing in the current folder.\n");
 
     string content_line;
@@ -895,8 +758,9 @@ void RuntimeEnv::writeLlvmMainFunction()
 		}
 	}
 
-	o_mainFunc.close();
 	i_template.close();
+
+	container.add("main_function.ll", o_mainFunc.str(), true);
 }
 
 /*
@@ -1017,13 +881,7 @@ void RuntimeEnv::mergeMemoSyncTables()
 		assert(dst_mst && src_mst);
 
 		//insert source memorySyncTable to destination memorySyncTable
-		for(memoSyncTable_ty::iterator it = src_mst->begin();
-						it != src_mst->end(); ++it){
-			uint64_t src_entry_addr = it->second.m_addr;
-			uint64_t src_entry_size = it->second.m_size;
-			vector<uint8_t> src_entry_value = it->second.m_data;
-			addMemoSyncTableEntryInternal(src_entry_addr, src_entry_size, src_entry_value, *dst_mst);
-		}
+		dst_mst->merge(*src_mst);
 
 		src_mst->clear();
 		assert(m_memoSyncTables[i].empty());
@@ -1046,7 +904,7 @@ void RuntimeEnv::mergeMemoSyncTables()
  * - data_size (size_memo_sync)// 4 bytes
  * - data (data_memo_sync)// data_size bytes
  * */
-void RuntimeEnv::writeMemoSyncTables()
+void RuntimeEnv::writeMemoSyncTables(crete::TraceContainerWriter& container)
 {
 	mergeMemoSyncTables();
 
@@ -1057,9 +915,7 @@ void RuntimeEnv::writeMemoSyncTables()
 			assert(m_memoSyncTables[i].empty() && "Something is wrong in mergeMemoSyncTables().\n");
 	}
 
-	ofstream o_sm(getOutputFilename("dump_sync_memos.bin").c_str(),
-    		ios_base::binary);
-	assert(o_sm && "Create file failed: dump_sync_memos.bin\n");
+	ostringstream o_sm(ios_base::out | ios_base::binary);
 
 	// - amount of dumped TBs (amt_dumped_tbs)// 8 bytes
 	uint64_t amt_dumped_tbs = m_memoMergePoints.size();
@@ -1089,25 +945,25 @@ void RuntimeEnv::writeMemoSyncTables()
 			o_sm.write((const char*)&amt_memo_entries, sizeof(amt_memo_entries));
 
 			// write data of one memoSyncTable to file
-			for(memoSyncTable_ty::iterator it = m_memoSyncTables[i].begin();
+			for(memoSyncTable_ty::const_iterator it = m_memoSyncTables[i].begin();
 					it != m_memoSyncTables[i].end(); ++it) {
-				ConcreteMemoInfo v_concMemo_info = it->second;
+				const ConcreteMemoInfo& v_concMemo_info = it->second;
 
 				uint64_t addr_memo_sync = v_concMemo_info.m_addr;
 				uint32_t size_memo_sync = v_concMemo_info.m_size;
-				vector<uint8_t> data_memo_sync = v_concMemo_info.m_data;
+				const uint8_t *data_memo_sync = v_concMemo_info.data();
 
 				// - address (addr_memo_sync)// 8bytes
 				o_sm.write((const char*)&addr_memo_sync, sizeof(addr_memo_sync));
 				// - data_size (size_memo_sync)// 4 bytes
 				o_sm.write((const char*)&size_memo_sync, sizeof(size_memo_sync));
 				// - data (data_memo_sync)// data_size bytes
-				o_sm.write((const char*)data_memo_sync.data(), data_memo_sync.size()*sizeof(uint8_t));
+				o_sm.write((const char*)data_memo_sync, size_memo_sync*sizeof(uint8_t));
 			}
 		}
 	}
 
-	o_sm.clear();
+	container.add("dump_sync_memos.bin", o_sm.str(), true);
 }
 
 void RuntimeEnv::debugMergeMemoSync()
@@ -1608,13 +1464,11 @@ void RuntimeEnv::dumpCpuStateForInterrupt(void *dumpCpuState)
  *   data of size_QemuInterruptInfo // size_QemuInterruptInfo bytes
  *   data of CPUState // size_CPUSate bytes
  * */
-void RuntimeEnv::writeInterruptStates()
+void RuntimeEnv::writeInterruptStates(crete::TraceContainerWriter& container)
 {
 	assert(m_interruptStates.size() == rt_dump_tb_count);
 
-	ofstream o_sm(getOutputFilename("dump_qemu_interrupt_info.bin").c_str(),
-    		ios_base::binary);
-	assert(o_sm && "Create file failed: dump_qemu_interrupt_info.bin\n");
+	ostringstream o_sm(ios_base::out | ios_base::binary);
 
 	// sizeof(QemuInterruptInfo) (size_QemuInterruptInfo) // 8 bytes
 	uint64_t size_QemuInterruptInfo= sizeof(QemuInterruptInfo);
@@ -1659,7 +1513,7 @@ void RuntimeEnv::writeInterruptStates()
 		}
 	}
 
-	o_sm.clear();
+	container.add("dump_qemu_interrupt_info.bin", o_sm.str(), true);
 }
 
 /*
@@ -1686,23 +1540,15 @@ void RuntimeEnv::addTBGraphInfo(TranslationBlock *tb)
     m_tbExecSequInt.push_back(tb->pc);
 }
 
-void RuntimeEnv::writeTBAddresses()
+void RuntimeEnv::writeTBAddresses(crete::TraceContainerWriter& container)
 {
     assert(m_tbExecSequInt.size() <= m_tbExecSequ.size());
 
-    string path = getOutputFilename("tb-seq.bin");
-    ofstream ofs(path.c_str(), ios_base::out | ios_base::binary);
-
-    if(!ofs.good())
-        throw runtime_error("can't open file: " + path);
-
-    for(vector<uint64_t>::iterator iter = m_tbExecSequInt.begin();
-        iter != m_tbExecSequInt.end();
-        ++iter)
-    {
-        ofs.write(reinterpret_cast<const char*>(&*iter),
-                  sizeof(uint64_t));
-    }
+    // Stored as is, so the trace analyzer can map it in place.
+    container.add("tb-seq.bin",
+                  m_tbExecSequInt.data(),
+                  m_tbExecSequInt.size() * sizeof(uint64_t),
+                  false);
 }
 
 // TODO: remove. Obsolete.
@@ -1724,19 +1570,12 @@ void RuntimeEnv::writeNewTraceLog() // TODO: should this really be in under CRET
         fs::create_directory_symlink(m_outputDirectory, path);
 }
 
-void RuntimeEnv::dump_tlo_tb_pc(const uint64_t pc)
+uint64_t RuntimeEnv::dump_tb_ir(const uint64_t pc,
+		const TCGContext &tcg_ctx,
+		const vector<uint16_t> &opc_buf,
+		const vector<uint64_t> &opparam_buf)
 {
-	m_tcg_llvm_offline_ctx.dump_tlo_tb_pc(pc);
-}
-
-void RuntimeEnv::dump_tcg_ctx(const TCGContext &tcg_ctx)
-{
-	m_tcg_llvm_offline_ctx.dump_tcg_ctx(tcg_ctx);
-}
-
-void RuntimeEnv::dump_tcg_temp(const vector<TCGTemp> &tcg_temp)
-{
-	m_tcg_llvm_offline_ctx.dump_tcg_temp(tcg_temp);
+	return m_tcg_llvm_offline_ctx.dump_tb(pc, tcg_ctx, opc_buf, opparam_buf);
 }
 
 void RuntimeEnv::dump_tcg_helper_name(const TCGContext &tcg_ctx)
@@ -1744,24 +1583,36 @@ void RuntimeEnv::dump_tcg_helper_name(const TCGContext &tcg_ctx)
 	m_tcg_llvm_offline_ctx.dump_tcg_helper_name(tcg_ctx);
 }
 
-void RuntimeEnv::dump_tlo_opc_buf(const uint64_t *opc_buf)
+void RuntimeEnv::writeTcgLlvmCtx(crete::TraceContainerWriter& container)
 {
-	m_tcg_llvm_offline_ctx.dump_tlo_opc_buf(opc_buf);
-}
+	ostringstream os(ios_base::out | ios_base::binary);
 
-void RuntimeEnv::dump_tlo_opparam_buf(const uint64_t *opparam_buf)
-{
-	m_tcg_llvm_offline_ctx.dump_tlo_opparam_buf(opparam_buf);
+	{
+		boost::archive::binary_oarchive oa(os);
+		oa << m_tcg_llvm_offline_ctx;
+	}
+
+	container.add("dump_tcg_llvm_offline.bin", os.str(), true);
 }
 
-void RuntimeEnv::writeTcgLlvmCtx()
+// The test case this run was fed, as the VM node used to copy it in beside the trace.
+void RuntimeEnv::writeConcreteInputs(crete::TraceContainerWriter& container)
 {
-	string path = getOutputFilename("dump_tcg_llvm_offline.bin");
+	if(!m_concrete_inputs.empty()) {
+		container.add("concrete_inputs.bin", m_concrete_inputs, false);
+		return;
+	}
+
+	// The initial test case, written by dump_initial_input()
+	ifstream ifs("hostfile/input_arguments.bin", ios_base::in | ios_base::binary);
+
+	if(!ifs)
+		return;
 
-	ofstream ofs(path.c_str());
+	ostringstream os(ios_base::out | ios_base::binary);
+	os << ifs.rdbuf();
 
-    boost::archive::binary_oarchive oa(ofs);
-    oa << m_tcg_llvm_offline_ctx;
+	container.add("concrete_inputs.bin", os.str(), false);
 }
 
 /*****************************/
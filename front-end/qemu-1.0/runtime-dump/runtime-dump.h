@@ -125,24 +125,15 @@ void dump_Ebp(struct RuntimeEnv *rt, void *env_CpuState);
 #include <stack>
 #include <sstream>
 
+#include "memo_sync_table.h"
+
 /***********************************/
 /* External interface for C++ code */
 #include <llvm/Support/raw_ostream.h>
 
 using namespace std;
 
-struct ConcreteMemoInfo
-{
-	uint64_t m_addr;
-	uint32_t m_size;
-	vector<uint8_t> m_data;
-
-	ConcreteMemoInfo(uint64_t addr, uint32_t size, vector<uint8_t> data)
-	:m_addr(addr), m_size(size), m_data(data) {}
-};
-
-// addr is the key for this map
-typedef map<uint64_t, ConcreteMemoInfo> memoSyncTable_ty;
+typedef MemoSyncTable memoSyncTable_ty;
 typedef vector<memoSyncTable_ty> memoSyncTables_ty;
 
 #if defined(CRETE_DBG_REPLAY_INTERRUPT)
@@ -193,6 +184,11 @@ pair<uint64_t, vector<uint8_t> > guest_read_buf(uint64_t addr, uint64_t size, vo
 
 #include "tcg-llvm-offline/tcg-llvm-offline.h"
 
+namespace crete
+{
+class TraceContainerWriter;
+}
+
 class RuntimeEnv
 {
 public:
@@ -228,6 +224,7 @@ private:
 	vector<string> m_symbMemos;
 
     vector<ConcolicMemoryObject> m_makeConcolics; // TODO: Should be a set, or unordered_set (boost), for fast lookup, nonredudance
+    string m_concrete_inputs; // The test case fed to this run, serialized.
 
 	// Execution sequence in terms of Translation Block
     vector<string> m_tbExecSequ;
@@ -290,7 +287,7 @@ public:
     		uint64_t guest_virtual_addr, int mmu_idx, int is_write = 1);
 
     void dumpConcolicData();
-    void feed_test_case(const string& file_name);
+    void feed_test_case(const string& test_input); // A serialized TestCase.
     void dump_initial_input();
 
     void initOutputDirectory(const string& outputDirectory);
@@ -316,15 +313,12 @@ public:
     void verifyDumpData();
 #endif
 
-    void dump_tlo_tb_pc(const uint64_t pc);
-
-    void dump_tcg_ctx(const TCGContext& tcg_ctx);
-    void dump_tcg_temp(const vector<TCGTemp>& tcg_temp);
+    uint64_t dump_tb_ir(const uint64_t pc,
+                        const TCGContext& tcg_ctx,
+                        const vector<uint16_t>& opc_buf,
+                        const vector<uint64_t>& opparam_buf);
     void dump_tcg_helper_name(const TCGContext &tcg_ctx);
 
-    void dump_tlo_opc_buf(const uint64_t *opc_buf);
-    void dump_tlo_opparam_buf(const uint64_t *opparam_buf);
-
 #if defined(CRETE_DBG_TB_GRAPH)
     void addTBGraphInfo(TranslationBlock *tb);
 #endif // defined(CRETE_DBG_TB_GRAPH)
@@ -333,22 +327,16 @@ private:
 	string getOutputFilename(const string &fileName);
 	llvm::raw_ostream* openOutputFile(const string &fileName);
 	void writeDebugToFile();
-    void writeLlvmMainFunction();
+    void writeLlvmMainFunction(crete::TraceContainerWriter& container);
 
-    void writeSymbolicMemo();
+    void writeSymbolicMemo(crete::TraceContainerWriter& container);
 
-    void writePrologRegs();
+    void writePrologRegs(crete::TraceContainerWriter& container);
 
     bool overlaps_with_existing_mo(uint64_t addr, size_t size);
 
 	void mergeMemoSyncTables();
-	void writeMemoSyncTables();
-
-	vector<uint64_t> overlapsMemoSyncEntry(uint64_t addr,
-			uint32_t size, memoSyncTable_ty target_memoSyncTable);
-
-	void addMemoSyncTableEntryInternal(uint64_t addr, uint32_t size, vector<uint8_t> v_value,
-			 memoSyncTable_ty& target_memoSyncTable);
+	void writeMemoSyncTables(crete::TraceContainerWriter& container);
 
 	void verifyMemoSyncTable(const memoSyncTable_ty& target_memoSyncTable);
 	void debugMergeMemoSync();
@@ -360,13 +348,14 @@ private:
 #endif
 
 #if defined(CRETE_DBG_REPLAY_INTERRUPT)
-    void writeInterruptStates();
+    void writeInterruptStates(crete::TraceContainerWriter& container);
 #endif
 
-	void writeTcgLlvmCtx();
+	void writeTcgLlvmCtx(crete::TraceContainerWriter& container);
+	void writeConcreteInputs(crete::TraceContainerWriter& container);
 
 #if defined(CRETE_DBG_TB_GRAPH)
-    void writeTBAddresses();
+    void writeTBAddresses(crete::TraceContainerWriter& container);
     void writeNewTraceLog();
 #endif // defined(CRETE_DBG_TB_GRAPH)
 
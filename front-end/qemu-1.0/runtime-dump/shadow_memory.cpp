@@ -0,0 +1,155 @@
+#include "shadow_memory.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+
+// Bits [first, first + count) of a word, count in 1..64
+inline uint64_t word_mask(unsigned first, unsigned count)
+{
+	return (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << first;
+}
+
+} // namespace
+
+ShadowMemory::Page::Page()
+	: m_symbolic_count(0)
+{
+	memset(m_words, 0, sizeof(m_words));
+}
+
+ShadowMemory::ShadowMemory()
+	: m_last_num(0), m_last_page(NULL)
+{
+}
+
+// The cached page belongs to the other table: not copied
+ShadowMemory::ShadowMemory(const ShadowMemory &other)
+	: m_pages(other.m_pages), m_last_num(0), m_last_page(NULL)
+{
+}
+
+ShadowMemory &ShadowMemory::operator=(const ShadowMemory &other)
+{
+	m_pages = other.m_pages;
+	m_last_page = NULL;
+
+	return *this;
+}
+
+const ShadowMemory::Page *ShadowMemory::find_page(uint64_t page_num) const
+{
+	if(m_last_page && m_last_num == page_num)
+		return m_last_page;
+
+	pages_ty::const_iterator it = m_pages.find(page_num);
+	if(it == m_pages.end())
+		return NULL;
+
+	m_last_num = page_num;
+	m_last_page = &it->second; // Elements of an unordered_map stay put across rehashes
+
+	return m_last_page;
+}
+
+bool ShadowMemory::is_symbolic(uint64_t addr, uint64_t size) const
+{
+	if(m_pages.empty())
+		return false;
+
+	const uint64_t end = addr + size;
+
+	while(addr < end) {
+		const uint64_t page_num = addr >> page_bits;
+		const uint64_t page_end = min(end, (page_num + 1) << page_bits);
+		const Page *page = find_page(page_num);
+
+		if(!page) {
+			addr = page_end;
+			continue;
+		}
+
+		while(addr < page_end) {
+			const unsigned offset = addr & (page_size - 1);
+			const unsigned bit = offset % 64;
+			const unsigned count = min<uint64_t>(64 - bit, page_end - addr);
+
+			if(page->m_words[offset / 64] & word_mask(bit, count))
+				return true;
+
+			addr += count;
+		}
+	}
+
+	return false;
+}
+
+void ShadowMemory::make_symbolic(uint64_t addr, uint64_t size)
+{
+	const uint64_t end = addr + size;
+
+	while(addr < end) {
+		const uint64_t page_num = addr >> page_bits;
+		const uint64_t page_end = min(end, (page_num + 1) << page_bits);
+		Page &page = m_pages[page_num];
+
+		while(addr < page_end) {
+			const unsigned offset = addr & (page_size - 1);
+			const unsigned bit = offset % 64;
+			const unsigned count = min<uint64_t>(64 - bit, page_end - addr);
+			uint64_t &word = page.m_words[offset / 64];
+			const uint64_t mask = word_mask(bit, count);
+
+			page.m_symbolic_count += __builtin_popcountll(mask & ~word);
+			word |= mask;
+
+			addr += count;
+		}
+	}
+}
+
+void ShadowMemory::make_concrete(uint64_t addr, uint64_t size)
+{
+	if(m_pages.empty())
+		return;
+
+	const uint64_t end = addr + size;
+
+	while(addr < end) {
+		const uint64_t page_num = addr >> page_bits;
+		const uint64_t page_end = min(end, (page_num + 1) << page_bits);
+		pages_ty::iterator it = m_pages.find(page_num);
+
+		if(it == m_pages.end()) {
+			addr = page_end;
+			continue;
+		}
+
+		Page &page = it->second;
+
+		while(addr < page_end) {
+			const unsigned offset = addr & (page_size - 1);
+			const unsigned bit = offset % 64;
+			const unsigned count = min<uint64_t>(64 - bit, page_end - addr);
+			uint64_t &word = page.m_words[offset / 64];
+			const uint64_t mask = word_mask(bit, count);
+
+			page.m_symbolic_count -= __builtin_popcountll(mask & word);
+			word &= ~mask;
+
+			addr += count;
+		}
+
+		// Entirely concrete again: no page, so later lookups fail fast
+		if(page.m_symbolic_count == 0) {
+			if(m_last_page == &page)
+				m_last_page = NULL;
+
+			m_pages.erase(it);
+		}
+	}
+}
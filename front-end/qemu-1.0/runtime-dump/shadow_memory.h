@@ -0,0 +1,54 @@
+#ifndef CRETE_SHADOW_MEMORY_H
+#define CRETE_SHADOW_MEMORY_H
+
+#include <cstddef>
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+/*
+ * Which bytes of an address space are symbolic: one bit per byte, in 4 KB pages allocated on the
+ * first symbolic byte and released once the last one is made concrete again. A page missing from
+ * the table is entirely concrete, so testing a concrete address costs a single lookup, and an
+ * access of up to 64 bits tests at most two words of one page, or one word of each of two.
+ */
+class ShadowMemory
+{
+public:
+	ShadowMemory();
+	ShadowMemory(const ShadowMemory &other);
+	ShadowMemory &operator=(const ShadowMemory &other);
+
+	bool is_symbolic(uint64_t addr, uint64_t size) const;
+	void make_symbolic(uint64_t addr, uint64_t size);
+	void make_concrete(uint64_t addr, uint64_t size);
+
+	bool empty() const { return m_pages.empty(); }
+
+	static const unsigned page_bits = 12;
+	static const uint64_t page_size = uint64_t(1) << page_bits;
+
+private:
+	static const unsigned page_words = page_size / 64;
+
+	struct Page
+	{
+		Page();
+
+		uint64_t m_words[page_words];
+		uint32_t m_symbolic_count;
+	};
+
+	typedef boost::unordered_map<uint64_t, Page> pages_ty;
+
+	const Page *find_page(uint64_t page_num) const;
+
+private:
+	pages_ty m_pages;
+
+	// The page last looked up, as accesses tend to stay on one. Invalidated when a page goes.
+	mutable uint64_t m_last_num;
+	mutable const Page *m_last_page;
+};
+
+#endif // CRETE_SHADOW_MEMORY_H
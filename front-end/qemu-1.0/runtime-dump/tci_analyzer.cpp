@@ -1,7 +1,7 @@
 #include "tci_analyzer.h"
+#include "shadow_memory.h"
 
 #include <boost/array.hpp>
-#include <boost/unordered_set.hpp>
 
 #include <iostream> // testing
 #include <fstream>
@@ -40,8 +40,6 @@ struct InstrRange
 
 class Analyzer
 {
-public:
-    typedef boost::unordered_set<uint64_t> MemSet;
 public:
     void terminate_block();
 
@@ -49,22 +47,24 @@ public:
     void make_reg_symbolic(uint64_t index);
     void make_reg_concrete(uint64_t index);
 
-    bool is_guest_mem_symbolic(uint64_t addr);
-    void make_guest_mem_symbolic(uint64_t addr);
-    void make_guest_mem_concrete(uint64_t addr);
+    bool is_guest_mem_symbolic(uint64_t addr, uint64_t size);
+    void make_guest_mem_symbolic(uint64_t addr, uint64_t size);
+    void make_guest_mem_concrete(uint64_t addr, uint64_t size);
 
-    bool is_host_mem_symbolic(uint64_t addr);
-    void make_host_mem_symbolic(uint64_t addr);
-    void make_host_mem_concrete(uint64_t addr);
+    bool is_host_mem_symbolic(uint64_t addr, uint64_t size);
+    void make_host_mem_symbolic(uint64_t addr, uint64_t size);
+    void make_host_mem_concrete(uint64_t addr, uint64_t size);
 
     bool is_block_symbolic();
     void mark_block_symbolic();
 
+    bool has_symbolic_state() const;
+
 private:
     Block current_block_;
     boost::array<Reg, register_count> reg_;
-    MemSet guest_mem_;
-    MemSet host_mem_;
+    ShadowMemory guest_mem_;
+    ShadowMemory host_mem_;
 };
 
 void Analyzer::terminate_block()
@@ -98,62 +98,38 @@ void Analyzer::make_reg_concrete(uint64_t index)
         std::cerr << "make_reg_concrete[" << std::dec << index <<"]\n";
 }
 
-bool Analyzer::is_guest_mem_symbolic(uint64_t addr)
+bool Analyzer::is_guest_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    MemSet::const_iterator it = guest_mem_.find(addr);
-
-    return it != guest_mem_.end();
+    return guest_mem_.is_symbolic(addr, size);
 }
 
-void Analyzer::make_guest_mem_symbolic(uint64_t addr)
+void Analyzer::make_guest_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    MemSet::iterator it = guest_mem_.find(addr);
-
-    if(it == guest_mem_.end())
-    {
-        guest_mem_.insert(addr);
-    }
+    guest_mem_.make_symbolic(addr, size);
 
     mark_block_symbolic();
 }
 
-void Analyzer::make_guest_mem_concrete(uint64_t addr)
+void Analyzer::make_guest_mem_concrete(uint64_t addr, uint64_t size)
 {
-    MemSet::const_iterator it = guest_mem_.find(addr);
-
-    if(it != guest_mem_.end())
-    {
-        guest_mem_.erase(it);
-    }
+    guest_mem_.make_concrete(addr, size);
 }
 
-bool Analyzer::is_host_mem_symbolic(uint64_t addr)
+bool Analyzer::is_host_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    MemSet::const_iterator it = host_mem_.find(addr);
-
-    return it != host_mem_.end();
+    return host_mem_.is_symbolic(addr, size);
 }
 
-void Analyzer::make_host_mem_symbolic(uint64_t addr)
+void Analyzer::make_host_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    MemSet::iterator it = host_mem_.find(addr);
-
-    if(it == host_mem_.end())
-    {
-        host_mem_.insert(addr);
-    }
+    host_mem_.make_symbolic(addr, size);
 
     mark_block_symbolic();
 }
 
-void Analyzer::make_host_mem_concrete(uint64_t addr)
+void Analyzer::make_host_mem_concrete(uint64_t addr, uint64_t size)
 {
-    MemSet::const_iterator it = host_mem_.find(addr);
-
-    if(it != host_mem_.end())
-    {
-        host_mem_.erase(it);
-    }
+    host_mem_.make_concrete(addr, size);
 }
 
 bool Analyzer::is_block_symbolic()
@@ -166,8 +142,27 @@ void Analyzer::mark_block_symbolic()
     current_block_.symbolic_block_ = true;
 }
 
+// Without symbolic registers or memory, nothing a TB does can make any of them symbolic.
+bool Analyzer::has_symbolic_state() const
+{
+    for(boost::array<Reg, register_count>::const_iterator it = reg_.begin();
+        it != reg_.end();
+        ++it)
+    {
+        if(it->symbolic)
+            return true;
+    }
+
+    return !guest_mem_.empty() || !host_mem_.empty();
+}
+
 static Analyzer analyzer;
 static bool is_block_branching = false;
+#if defined(CRETE_DBG_DEP_BYPASS)
+// Every TB is analyzed; those that would have been bypassed are checked to come out the same.
+static bool is_block_bypassable = false;
+static bool is_block_marked_by_helper = false;
+#endif // defined(CRETE_DBG_DEP_BYPASS)
 
 inline
 bool is_current_block_symbolic()
@@ -263,357 +258,39 @@ void terminate_block()
 }
 
 inline
-bool is_guest_mem_symbolic(uint64_t addr)
-{
-    return analyzer.is_guest_mem_symbolic(addr);
-}
-
-inline
-bool is_guest_mem_symbolic(uint64_t addr1, uint64_t addr2)
-{
-    return is_guest_mem_symbolic(addr1)
-        || is_guest_mem_symbolic(addr2);
-}
-
-inline
-bool is_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3)
-{
-    return is_guest_mem_symbolic(addr1, addr2)
-        || is_guest_mem_symbolic(addr3);
-}
-
-inline
-bool is_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4)
-{
-    return is_guest_mem_symbolic(addr1, addr2, addr3)
-        || is_guest_mem_symbolic(addr4);
-}
-
-inline
-bool is_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                           uint64_t addr5)
-{
-    return is_guest_mem_symbolic(addr1, addr2, addr3, addr4)
-        || is_guest_mem_symbolic(addr5);
-}
-
-inline
-bool is_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                           uint64_t addr5, uint64_t addr6)
-{
-    return is_guest_mem_symbolic(addr1, addr2, addr3, addr4, addr5)
-        || is_guest_mem_symbolic(addr6);
-}
-
-inline
-bool is_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                           uint64_t addr5, uint64_t addr6, uint64_t addr7)
-{
-    return is_guest_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6)
-        || is_guest_mem_symbolic(addr7);
-}
-
-inline
-bool is_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                           uint64_t addr5, uint64_t addr6, uint64_t addr7, uint64_t addr8)
-{
-    return is_guest_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6, addr7)
-        || is_guest_mem_symbolic(addr8);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr)
-{
-    analyzer.make_guest_mem_symbolic(addr);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr1, uint64_t addr2)
-{
-    make_guest_mem_symbolic(addr1);
-    make_guest_mem_symbolic(addr2);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3)
-{
-    make_guest_mem_symbolic(addr1, addr2);
-    make_guest_mem_symbolic(addr3);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4)
-{
-    make_guest_mem_symbolic(addr1, addr2, addr3);
-    make_guest_mem_symbolic(addr4);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5)
-{
-    make_guest_mem_symbolic(addr1, addr2, addr3, addr4);
-    make_guest_mem_symbolic(addr5);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5, uint64_t addr6)
-{
-    make_guest_mem_symbolic(addr1, addr2, addr3, addr4, addr5);
-    make_guest_mem_symbolic(addr6);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5, uint64_t addr6, uint64_t addr7)
-{
-    make_guest_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6);
-    make_guest_mem_symbolic(addr7);
-}
-
-inline
-void make_guest_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5, uint64_t addr6, uint64_t addr7, uint64_t addr8)
-{
-    make_guest_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6, addr7);
-    make_guest_mem_symbolic(addr8);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr)
-{
-    analyzer.make_guest_mem_concrete(addr);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr1, uint64_t addr2)
-{
-    make_guest_mem_concrete(addr1);
-    make_guest_mem_concrete(addr2);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3)
-{
-    make_guest_mem_concrete(addr1, addr2);
-    make_guest_mem_concrete(addr3);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4)
-{
-    make_guest_mem_concrete(addr1, addr2, addr3);
-    make_guest_mem_concrete(addr4);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5)
-{
-    make_guest_mem_concrete(addr1, addr2, addr3, addr4);
-    make_guest_mem_concrete(addr5);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5, uint64_t addr6)
-{
-    make_guest_mem_concrete(addr1, addr2, addr3, addr4, addr5);
-    make_guest_mem_concrete(addr6);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5, uint64_t addr6, uint64_t addr7)
-{
-    make_guest_mem_concrete(addr1, addr2, addr3, addr4, addr5, addr6);
-    make_guest_mem_concrete(addr7);
-}
-
-inline
-void make_guest_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                             uint64_t addr5, uint64_t addr6, uint64_t addr7, uint64_t addr8)
+bool is_guest_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    make_guest_mem_concrete(addr1, addr2, addr3, addr4, addr5, addr6, addr7);
-    make_guest_mem_concrete(addr8);
+    return analyzer.is_guest_mem_symbolic(addr, size);
 }
 
 inline
-bool is_host_mem_symbolic(uint64_t addr)
+void make_guest_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    return analyzer.is_host_mem_symbolic(addr);
+    analyzer.make_guest_mem_symbolic(addr, size);
 }
 
 inline
-bool is_host_mem_symbolic(uint64_t addr1, uint64_t addr2)
+void make_guest_mem_concrete(uint64_t addr, uint64_t size)
 {
-    return is_host_mem_symbolic(addr1)
-        || is_host_mem_symbolic(addr2);
+    analyzer.make_guest_mem_concrete(addr, size);
 }
 
 inline
-bool is_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3)
+bool is_host_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    return is_host_mem_symbolic(addr1, addr2)
-        || is_host_mem_symbolic(addr3);
+    return analyzer.is_host_mem_symbolic(addr, size);
 }
 
 inline
-bool is_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4)
+void make_host_mem_symbolic(uint64_t addr, uint64_t size)
 {
-    return is_host_mem_symbolic(addr1, addr2, addr3)
-        || is_host_mem_symbolic(addr4);
+    analyzer.make_host_mem_symbolic(addr, size);
 }
 
 inline
-bool is_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                          uint64_t addr5)
+void make_host_mem_concrete(uint64_t addr, uint64_t size)
 {
-    return is_host_mem_symbolic(addr1, addr2, addr3, addr4)
-        || is_host_mem_symbolic(addr5);
-}
-
-inline
-bool is_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                          uint64_t addr5, uint64_t addr6)
-{
-    return is_host_mem_symbolic(addr1, addr2, addr3, addr4, addr5)
-        || is_host_mem_symbolic(addr6);
-}
-
-inline
-bool is_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                          uint64_t addr5, uint64_t addr6, uint64_t addr7)
-{
-    return is_host_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6)
-        || is_host_mem_symbolic(addr7);
-}
-
-inline
-bool is_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                          uint64_t addr5, uint64_t addr6, uint64_t addr7, uint64_t addr8)
-{
-    return is_host_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6, addr7)
-        || is_host_mem_symbolic(addr8);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr)
-{
-    analyzer.make_host_mem_symbolic(addr);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr1, uint64_t addr2)
-{
-    make_host_mem_symbolic(addr1);
-    make_host_mem_symbolic(addr2);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3)
-{
-    make_host_mem_symbolic(addr1, addr2);
-    make_host_mem_symbolic(addr3);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4)
-{
-    make_host_mem_symbolic(addr1, addr2, addr3);
-    make_host_mem_symbolic(addr4);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5)
-{
-    make_host_mem_symbolic(addr1, addr2, addr3, addr4);
-    make_host_mem_symbolic(addr5);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5, uint64_t addr6)
-{
-    make_host_mem_symbolic(addr1, addr2, addr3, addr4, addr5);
-    make_host_mem_symbolic(addr6);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5, uint64_t addr6, uint64_t addr7)
-{
-    make_host_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6);
-    make_host_mem_symbolic(addr7);
-}
-
-inline
-void make_host_mem_symbolic(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5, uint64_t addr6, uint64_t addr7, uint64_t addr8)
-{
-    make_host_mem_symbolic(addr1, addr2, addr3, addr4, addr5, addr6, addr7);
-    make_host_mem_symbolic(addr8);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr)
-{
-    analyzer.make_host_mem_concrete(addr);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr1, uint64_t addr2)
-{
-    make_host_mem_concrete(addr1);
-    make_host_mem_concrete(addr2);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3)
-{
-    make_host_mem_concrete(addr1, addr2);
-    make_host_mem_concrete(addr3);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4)
-{
-    make_host_mem_concrete(addr1, addr2, addr3);
-    make_host_mem_concrete(addr4);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5)
-{
-    make_host_mem_concrete(addr1, addr2, addr3, addr4);
-    make_host_mem_concrete(addr5);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5, uint64_t addr6)
-{
-    make_host_mem_concrete(addr1, addr2, addr3, addr4, addr5);
-    make_host_mem_concrete(addr6);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5, uint64_t addr6, uint64_t addr7)
-{
-    make_host_mem_concrete(addr1, addr2, addr3, addr4, addr5, addr6);
-    make_host_mem_concrete(addr7);
-}
-
-inline
-void make_host_mem_concrete(uint64_t addr1, uint64_t addr2, uint64_t addr3, uint64_t addr4,
-                            uint64_t addr5, uint64_t addr6, uint64_t addr7, uint64_t addr8)
-{
-    make_host_mem_concrete(addr1, addr2, addr3, addr4, addr5, addr6, addr7);
-    make_host_mem_concrete(addr8);
+    analyzer.make_host_mem_concrete(addr, size);
 }
 
 inline
@@ -672,7 +349,7 @@ void crete_tci_write_reg(uint64_t index)
 void crete_tci_ld8u_i32(uint64_t t0, uint64_t t1, uint64_t offset)
 {
     uint64_t addr = t1 + offset;
-    if(is_host_mem_symbolic(addr))
+    if(is_host_mem_symbolic(addr, 1))
     {
         make_reg_symbolic(t0);
     }
@@ -688,7 +365,7 @@ void crete_tci_ld8u_i32(uint64_t t0, uint64_t t1, uint64_t offset)
 void crete_tci_ld_i32(uint64_t t0, uint64_t t1, uint64_t offset)
 {
     uint64_t addr = t1 + offset;
-    if(is_host_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3))
+    if(is_host_mem_symbolic(addr, 4))
     {
         make_reg_symbolic(t0);
     }
@@ -706,11 +383,11 @@ void crete_tci_st8_i32(uint64_t t1, uint64_t offset)
     uint64_t addr = t1 + offset;
     if(crete_read_was_symbolic)
     {
-        make_host_mem_symbolic(addr);
+        make_host_mem_symbolic(addr, 1);
     }
     else
     {
-        make_host_mem_concrete(addr);
+        make_host_mem_concrete(addr, 1);
     }
 }
 
@@ -722,11 +399,11 @@ void crete_tci_st16_i32(uint64_t t1, uint64_t offset)
     uint64_t addr = t1 + offset;
     if(crete_read_was_symbolic)
     {
-        make_host_mem_symbolic(addr, addr + 1);
+        make_host_mem_symbolic(addr, 2);
     }
     else
     {
-        make_host_mem_concrete(addr, addr + 1);
+        make_host_mem_concrete(addr, 2);
     }
 }
 
@@ -738,11 +415,11 @@ void crete_tci_st_i32(uint64_t t1, uint64_t offset)
     uint64_t addr = t1 + offset;
     if(crete_read_was_symbolic)
     {
-        make_host_mem_symbolic(addr, addr + 1, addr + 2, addr + 3);
+        make_host_mem_symbolic(addr, 4);
     }
     else
     {
-        make_host_mem_concrete(addr, addr + 1, addr + 2, addr + 3);
+        make_host_mem_concrete(addr, 4);
     }
 }
 
@@ -764,8 +441,7 @@ void crete_tci_ld32s_i64(uint64_t t0, uint64_t t1, uint64_t offset)
 void crete_tci_ld_i64(uint64_t t0, uint64_t t1, uint64_t offset)
 {
     uint64_t addr = t1 + offset;
-    if(is_host_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3,
-                            addr + 4, addr + 5, addr + 6, addr + 7))
+    if(is_host_mem_symbolic(addr, 8))
     {
         make_reg_symbolic(t0);
     }
@@ -795,19 +471,17 @@ void crete_tci_st_i64(uint64_t t1, uint64_t offset)
     uint64_t addr = t1 + offset;
     if(crete_read_was_symbolic)
     {
-        make_host_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3,
-                               addr + 4, addr + 5, addr + 6, addr + 7);
+        make_host_mem_symbolic(addr, 8);
     }
     else
     {
-        make_host_mem_concrete(addr + 0, addr + 1, addr + 2, addr + 3,
-                               addr + 4, addr + 5, addr + 6, addr + 7);
+        make_host_mem_concrete(addr, 8);
     }
 }
 
 void crete_tci_qemu_ld8u(uint64_t t0, uint64_t addr)
 {
-    if(is_guest_mem_symbolic(addr))
+    if(is_guest_mem_symbolic(addr, 1))
     {
         make_reg_symbolic(t0);
     }
@@ -824,7 +498,7 @@ void crete_tci_qemu_ld8s(uint64_t t0, uint64_t addr)
 
 void crete_tci_qemu_ld16u(uint64_t t0, uint64_t addr)
 {
-    if(is_guest_mem_symbolic(addr + 0, addr + 1))
+    if(is_guest_mem_symbolic(addr, 2))
     {
         make_reg_symbolic(t0);
     }
@@ -841,7 +515,7 @@ void crete_tci_qemu_ld16s(uint64_t t0, uint64_t addr)
 
 void crete_tci_qemu_ld32u(uint64_t t0, uint64_t addr)
 {
-    if(is_guest_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3))
+    if(is_guest_mem_symbolic(addr, 4))
     {
         make_reg_symbolic(t0);
     }
@@ -863,8 +537,7 @@ void crete_tci_qemu_ld32(uint64_t t0, uint64_t addr)
 
 void crete_tci_qemu_ld64(uint64_t t0, uint64_t addr)
 {
-    if(is_guest_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3,
-                             addr + 4, addr + 5, addr + 6, addr + 7))
+    if(is_guest_mem_symbolic(addr, 8))
     {
         make_reg_symbolic(t0);
     }
@@ -876,8 +549,7 @@ void crete_tci_qemu_ld64(uint64_t t0, uint64_t addr)
 
 void crete_tci_qemu_ld64_32(uint64_t t0, uint64_t t1, uint64_t addr)
 {
-    if(is_guest_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3,
-                             addr + 4, addr + 5, addr + 6, addr + 7))
+    if(is_guest_mem_symbolic(addr, 8))
     {
         make_reg_symbolic(t0);
         make_reg_symbolic(t1);
@@ -893,11 +565,11 @@ void crete_tci_qemu_st8(uint64_t t0, uint64_t addr)
 {
     if(is_reg_symbolic(t0))
     {
-        make_guest_mem_symbolic(addr);
+        make_guest_mem_symbolic(addr, 1);
     }
     else
     {
-        make_guest_mem_concrete(addr);
+        make_guest_mem_concrete(addr, 1);
     }
 }
 
@@ -905,11 +577,11 @@ void crete_tci_qemu_st16(uint64_t t0, uint64_t addr)
 {
     if(is_reg_symbolic(t0))
     {
-        make_guest_mem_symbolic(addr + 0, addr + 1);
+        make_guest_mem_symbolic(addr, 2);
     }
     else
     {
-        make_guest_mem_concrete(addr + 0, addr + 1);
+        make_guest_mem_concrete(addr, 2);
     }
 }
 
@@ -917,11 +589,11 @@ void crete_tci_qemu_st32(uint64_t t0, uint64_t addr)
 {
     if(is_reg_symbolic(t0))
     {
-        make_guest_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3);
+        make_guest_mem_symbolic(addr, 4);
     }
     else
     {
-        make_guest_mem_concrete(addr + 0, addr + 1, addr + 2, addr + 3);
+        make_guest_mem_concrete(addr, 4);
     }
 }
 
@@ -929,31 +601,43 @@ void crete_tci_qemu_st64(uint64_t addr)
 {
     if(crete_read_was_symbolic)
     {
-        make_guest_mem_symbolic(addr + 0, addr + 1, addr + 2, addr + 3,
-                                addr + 4, addr + 5, addr + 6, addr + 7);
+        make_guest_mem_symbolic(addr, 8);
     }
     else
     {
-        make_guest_mem_concrete(addr + 0, addr + 1, addr + 2, addr + 3,
-                                addr + 4, addr + 5, addr + 6, addr + 7);
+        make_guest_mem_concrete(addr, 8);
     }
 }
 
 void crete_tci_make_symbolic(uint64_t addr, uint64_t size)
 {
-    for(uint64_t i = 0; i < size; ++i)
-    {
-        make_guest_mem_symbolic(addr + i);
-    }
+    make_guest_mem_symbolic(addr, size);
 }
 
 void crete_tci_next_block()
 {
+#if defined(CRETE_DBG_DEP_BYPASS)
+    // A bypassed TB is only marked by helpers, which run on either interpreter, and leaves
+    // nothing symbolic behind.
+    if(is_block_bypassable)
+    {
+        assert(is_current_block_symbolic() == is_block_marked_by_helper);
+        assert(!analyzer.has_symbolic_state());
+    }
+
+    is_block_bypassable = false;
+    is_block_marked_by_helper = false;
+#endif // defined(CRETE_DBG_DEP_BYPASS)
+
     terminate_block();
 }
 
 void crete_tci_mark_block_symbolic()
 {
+#if defined(CRETE_DBG_DEP_BYPASS)
+    is_block_marked_by_helper = true;
+#endif // defined(CRETE_DBG_DEP_BYPASS)
+
     mark_block_symbolic();
 }
 
@@ -971,3 +655,18 @@ void crete_tci_next_iteration()
 {
     analyzer = Analyzer();
 }
+
+// Until something is symbolic, only a TB that makes data concolic can find anything symbolic,
+// other than through the helpers, which mark the TB the same on the plain interpreter.
+bool crete_tci_analyze_block(bool makes_concolic)
+{
+    const bool analyze = makes_concolic || analyzer.has_symbolic_state();
+
+#if defined(CRETE_DBG_DEP_BYPASS)
+    is_block_bypassable = !analyze;
+
+    return true;
+#else
+    return analyze;
+#endif // defined(CRETE_DBG_DEP_BYPASS)
+}
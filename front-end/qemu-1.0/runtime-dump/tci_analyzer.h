@@ -17,6 +17,7 @@ bool crete_is_current_block_symbolic(void);
 void crete_tci_make_symbolic(uint64_t addr, uint64_t size);
 void crete_tci_mark_block_symbolic(void);
 void crete_tci_next_iteration(void);
+bool crete_tci_analyze_block(bool makes_concolic); // Whether the next TB needs the instrumented interpreter.
 
 void crete_tci_reg_monitor_begin(void); // Must place at the entry of each instruction.
 void crete_tci_read_reg(uint64_t index);
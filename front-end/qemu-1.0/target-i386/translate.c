@@ -4290,6 +4290,10 @@ static target_ulong disas_insn(DisasContext *s, target_ulong pc_start, CPUState*
             switch(arg)
             {
             default:
+#if defined(CRETE_DEP_ANALYSIS)
+                if(arg == CRETE_INSTR_MAKE_CONCOLIC_VALUE)
+                    s->tb->crete_makes_concolic = 1;
+#endif
                 bct_tcg_emit_custom_instruction(arg);
                 break;
             case CRETE_INSTR_MAKE_SYMBOLIC_VALUE:
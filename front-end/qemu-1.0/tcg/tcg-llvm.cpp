@@ -288,7 +288,7 @@ public:
     void generateCode(TCGContext *s, TranslationBlock *tb);
 
 #if defined(CRETE_CONFIG)
-    void tcg_llvm_offline_dump(const TCGContext *s, const TranslationBlock *tb);
+    uint64_t tcg_llvm_offline_dump(const TCGContext *s, const TranslationBlock *tb);
 #endif
 };
 
@@ -1331,35 +1331,20 @@ int TCGLLVMContextPrivate::generateOperation(int opc, const TCGArg *args)
 }
 
 #if defined(CRETE_CONFIG)
-void TCGLLVMContextPrivate::tcg_llvm_offline_dump(const TCGContext *s, const TranslationBlock *tb)
+// Returns the ID of the TB's IR in the offline context
+uint64_t TCGLLVMContextPrivate::tcg_llvm_offline_dump(const TCGContext *s, const TranslationBlock *tb)
 {
-    // tb->pc
-    runtime_env->dump_tlo_tb_pc((uint64_t)tb->pc);
-
-    // tcg_ctx
-    runtime_env->dump_tcg_ctx(*s);
-
-    //tcg_temp
-    vector<TCGTemp> temp_tcg_temp;
-    for(uint32_t i = 0; i <s->nb_temps; ++i)
-    	temp_tcg_temp.push_back(s->temps[i]);
-    runtime_env->dump_tcg_temp(temp_tcg_temp);
-
     //helper_names
-    if(m_tbCount == 1)
+    if(m_tbCount == 0)
     	runtime_env->dump_tcg_helper_name(*s);
 
-    // gen_opc_buf
-    uint64_t temp_gen_opc_buf[OPC_BUF_SIZE];
-    for(uint32_t i = 0; i < OPC_BUF_SIZE; ++i)
-    	temp_gen_opc_buf[i] = (uint64_t)gen_opc_buf[i];
-    runtime_env->dump_tlo_opc_buf(temp_gen_opc_buf);
-
-    // gen_opparam_buf
-    uint64_t temp_gen_opparam_buf[OPPARAM_BUF_SIZE];
-    for(uint32_t i = 0; i < OPPARAM_BUF_SIZE; ++i)
-    	temp_gen_opparam_buf[i] = (uint64_t)gen_opparam_buf[i];
-    runtime_env->dump_tlo_opparam_buf(temp_gen_opparam_buf);
+    // gen_opc_buf, up to and including INDEX_op_end, and the gen_opparam_buf its ops use
+    assert(*gen_opc_ptr == INDEX_op_end);
+    vector<uint16_t> temp_gen_opc_buf(gen_opc_buf, gen_opc_ptr + 1);
+    vector<uint64_t> temp_gen_opparam_buf(gen_opparam_buf, gen_opparam_ptr);
+
+    return runtime_env->dump_tb_ir((uint64_t)tb->pc, *s,
+    		temp_gen_opc_buf, temp_gen_opparam_buf);
 }
 
 #endif //#if defined(CRETE_CONFIG)
@@ -1369,7 +1354,16 @@ void TCGLLVMContextPrivate::generateCode(TCGContext *s, TranslationBlock *tb)
     /* Create new function for current translation block */
     /* TODO: compute the checksum of the tb to see if we can reuse some code */
     std::ostringstream fName;
+#if defined(CRETE_CONFIG)
+    // The translation is moved to offline
+    // At qemu runtime, only collecting information (no translation to llvm).
+    // The function is named after the ID of the TB's IR, so a TB retranslated
+    // to the same IR, e.g. after a flush, is called through the same function.
+    fName << "tcg-llvm-tb-" << tcg_llvm_offline_dump(s, tb) << "-" << std::hex << tb->pc;
+    ++m_tbCount;
+#else
     fName << "tcg-llvm-tb-" << (m_tbCount++) << "-" << std::hex << tb->pc;
+#endif
 
     /*
     if(m_tbFunction)
@@ -1383,12 +1377,11 @@ void TCGLLVMContextPrivate::generateCode(TCGContext *s, TranslationBlock *tb)
 #if defined(CRETE_CONFIG)
     // change the function's linkage as not "private", so that it could be
     // called by the function of other modules, the harness module
-    m_tbFunction = Function::Create(tbFunctionType,
-            Function::ExternalLinkage, fName.str(), m_module);
+    m_tbFunction = m_module->getFunction(fName.str());
 
-    // The translation is moved to offline
-    // At qemu runtime, only collecting information (no translation to llvm)
-    tcg_llvm_offline_dump(s, tb);
+    if(!m_tbFunction)
+        m_tbFunction = Function::Create(tbFunctionType,
+                Function::ExternalLinkage, fName.str(), m_module);
 
 #if !defined(DBG_TCG_LLVM_OFFLINE)
     tb->llvm_function = m_tbFunction;
@@ -1610,9 +1603,14 @@ void tcg_llvm_tb_alloc(TranslationBlock *tb)
 
 void tcg_llvm_tb_free(TranslationBlock *tb)
 {
+#if defined(CRETE_CONFIG)
+    // Only a declaration, which TBs retranslated to the same IR share
+    tb->llvm_function = NULL;
+#else
     if(tb->llvm_function) {
         tb->llvm_function->eraseFromParent();
     }
+#endif
 }
 
 #ifndef CONFIG_S2E
@@ -1,4 +1,5 @@
 #include <crete/cluster/common.h>
+#include <crete/cluster/trace_archive.h>
 #include <crete/exception.h>
 
 #include <boost/filesystem.hpp>
@@ -20,7 +21,8 @@ namespace crete
 namespace cluster
 {
 
-auto from_trace_file(const fs::path& p) -> Trace
+auto from_trace_file(const fs::path& p,
+                     TraceCompression compression) -> Trace
 {
     if(!fs::exists(p))
     {
@@ -30,47 +32,9 @@ auto from_trace_file(const fs::path& p) -> Trace
     auto trace = Trace{};
 
     trace.uuid_ = bui::random_generator{}();
+    trace.data_ = archive_directory(p, compression);
 
-    auto newp = p.parent_path() / bui::to_string(trace.uuid_);
-
-    fs::rename(p,
-               newp);
-
-    auto tared_path = fs::path{newp}.replace_extension("tar.gz");
-
-    bp::context ctx;
-    ctx.work_directory = newp.parent_path().string();
-    ctx.environment = bp::self::get_environment();
-    auto exe = std::string{"/bin/tar"};
-    auto args = std::vector<std::string>{fs::path{exe}.filename().string(),
-                                         "-zcf",
-                                         tared_path.filename().string(),
-                                         newp.filename().string()
-                                         };
-
-    auto proc = bp::launch(exe, args, ctx);
-    auto status = proc.wait();
-
-    if(status.exit_status() != 0)
-    {
-        BOOST_THROW_EXCEPTION(Exception{} << err::process_exit_status{exe});
-    }
-
-    {
-        fs::ifstream ifs{tared_path};
-
-        if(!ifs.good())
-        {
-            BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{tared_path.string()});
-        }
-
-        std::copy(std::istreambuf_iterator<char>{ifs},
-                  std::istreambuf_iterator<char>{},
-                  std::back_inserter(trace.data_));
-    }
-
-    fs::remove_all(newp);
-    fs::remove(tared_path);
+    fs::remove_all(p);
 
     return trace;
 }
@@ -78,44 +42,13 @@ auto from_trace_file(const fs::path& p) -> Trace
 auto to_file(const Trace& trace,
              const boost::filesystem::path& p) -> void
 {
-    auto tared_path = fs::path{p}.replace_extension("tar");
-
     if(fs::exists(p))
     {
         BOOST_THROW_EXCEPTION(Exception{} << err::file_exists{p.string()});
     }
 
-    {
-        fs::ofstream ofs{tared_path};
-
-        if(!ofs.good())
-        {
-            BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{tared_path.string()});
-        }
-
-        std::copy(trace.data_.begin(),
-                  trace.data_.end(),
-                  std::ostreambuf_iterator<char>{ofs});
-    }
-
-    bp::context ctx;
-    ctx.work_directory = p.parent_path().string();
-    ctx.environment = bp::self::get_environment();
-    auto exe = std::string{"/bin/tar"}; // TODO: get from fs::find_in_path("tar"); ...
-    auto args = std::vector<std::string>{fs::path{exe}.filename().string(),
-                                         "-xf",
-                                         tared_path.filename().string()
-                                         };
-
-    auto proc = bp::launch(exe, args, ctx);
-    auto status = proc.wait();
-
-    if(status.exit_status() != 0)
-    {
-        BOOST_THROW_EXCEPTION(Exception{} << err::process_exit_status{exe});
-    }
-
-    fs::remove(tared_path);
+    extract_archive(trace.data_,
+                    p);
 }
 
 ImageInfo::ImageInfo(const boost::filesystem::path& image) :
@@ -1,5 +1,7 @@
 #include <crete/cluster/dispatch.h>
+#include <crete/cluster/dispatch_journal.h>
 #include <crete/exception.h>
+#include <crete/trace_container.h>
 #include <crete/logger.h>
 
 #include <boost/property_tree/ptree.hpp>
@@ -11,9 +13,21 @@
 #include <boost/msm/front/functor_row.hpp>
 #include <boost/msm/front/euml/operator.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
-
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/optional.hpp>
+
+#include <atomic>
 #include <chrono>
 #include <deque>
+#include <exception>
+#include <map>
+#include <sstream>
 
 namespace bpt = boost::property_tree;
 namespace bui = boost::uuids;
@@ -68,6 +82,7 @@ public:
     VMNodeFSM_();
 
     auto node_status() -> const NodeStatus&;
+    auto status_seq() const -> uint64_t;
     auto traces() -> const std::vector<Trace>&;
     auto errors() -> const std::deque<log::NodeError>&;
     auto pop_error() -> const log::NodeError;
@@ -197,6 +212,7 @@ public:
 
 private:
     NodeRegistrar::Node node_;
+    uint64_t status_seq_{0}; // Bumped each time the node's status is received.
     bool first_{false};
     std::vector<Trace> traces_;
     std::deque<log::NodeError> errors_;
@@ -261,6 +277,11 @@ auto VMNodeFSM_::node_status() -> const NodeStatus&
     return node_->acquire()->status;
 }
 
+auto VMNodeFSM_::status_seq() const -> uint64_t
+{
+    return status_seq_;
+}
+
 auto VMNodeFSM_::traces() -> const std::vector<Trace>&
 {
     return traces_;
@@ -502,12 +523,18 @@ struct VMNodeFSM_::update_image
         auto tared_path = fs::path{ev.image_path_}.replace_extension(".tar.gz");
         auto pkinfo = PacketInfo{0,0,0};
 
-        if(fs::exists(tared_path))
         {
-            fs::remove(tared_path);
-        }
+            // Nodes are serviced concurrently, and they all pack the image through the same tarball.
+            static boost::mutex image_mutex;
+            boost::lock_guard<boost::mutex> image_lock{image_mutex};
 
-        image = from_image_file(ev.image_path_);
+            if(fs::exists(tared_path))
+            {
+                fs::remove(tared_path);
+            }
+
+            image = from_image_file(ev.image_path_);
+        }
 
         auto lock = fsm.node_->acquire();
 
@@ -544,6 +571,8 @@ struct VMNodeFSM_::rx_status
     auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState&) -> void
     {
         cluster::poll(fsm.node_);
+
+        ++fsm.status_seq_;
     }
 };
 
@@ -702,6 +731,7 @@ class SVMNodeFSM_ : public boost::msm::front::state_machine_def<SVMNodeFSM_>
 {
 private:
     NodeRegistrar::Node node_;
+    uint64_t status_seq_{0}; // Bumped each time the node's status is received.
     std::vector<TestCase> tests_;
     std::deque<log::NodeError> errors_;
 
@@ -712,7 +742,9 @@ public:
 
 //    auto node() -> const NodeRegistrar::Node&;
     auto node_status() -> const NodeStatus&;
+    auto status_seq() const -> uint64_t;
     auto tests() -> const std::vector<TestCase>&;
+    auto take_tests() -> std::vector<TestCase>;
     auto errors() -> const std::deque<log::NodeError>&;
     auto pop_error() -> const log::NodeError;
 
@@ -833,11 +865,25 @@ auto SVMNodeFSM_::node_status() -> const NodeStatus&
     return node_->acquire()->status;
 }
 
+auto SVMNodeFSM_::status_seq() const -> uint64_t
+{
+    return status_seq_;
+}
+
 auto SVMNodeFSM_::tests() -> const std::vector<TestCase>&
 {
     return tests_;
 }
 
+auto SVMNodeFSM_::take_tests() -> std::vector<TestCase>
+{
+    auto tests = std::vector<TestCase>{};
+
+    tests.swap(tests_);
+
+    return tests;
+}
+
 auto SVMNodeFSM_::errors() -> const std::deque<log::NodeError>&
 {
     return errors_;
@@ -1021,6 +1067,77 @@ struct terminated {};
 struct start;
 struct poll {};
 
+// +--------------------------------------------------+
+// + Node Servicing                                   +
+// +--------------------------------------------------+
+
+/**
+ * Servicing context of a single node FSM. Exchanges with the node run on its strand in the
+ * dispatch's worker pool, so a slow node holds up only itself. While 'busy' is set, the exchange
+ * owns the node FSM and the dispatch loop leaves it alone.
+ */
+struct NodeWorker
+{
+    NodeWorker(boost::asio::io_service& io_service,
+               const NodeStatus& node_status,
+               uint64_t status_seq,
+               uint32_t NodeStatus::* node_queue,
+               uint32_t max_queued_per_instance)
+        : strand{io_service}
+        , status{node_status}
+        , queue{node_queue}
+        , flow{max_queued_per_instance}
+    {
+        flow.observe(status_seq,
+                     node_status.*queue,
+                     node_status.instance_count);
+    }
+
+    // Most exchanges don't receive the node's status; flow ignores the repeats of a stale one.
+    auto observe(const NodeStatus& node_status,
+                 uint64_t status_seq) -> void
+    {
+        flow.observe(status_seq,
+                     node_status.*queue,
+                     node_status.instance_count);
+
+        status.acquire() = node_status;
+    }
+
+    boost::asio::io_service::strand strand;
+    std::atomic<bool> busy{false};
+    std::exception_ptr error; // Raised by the last exchange; rethrown on the dispatch thread.
+    AtomicGuard<NodeStatus> status; // As of the last completed exchange; readable while busy.
+    uint32_t NodeStatus::* queue; // The node's queue that dispatch fills.
+    FlowControl flow; // Owned like the node FSM: by the exchange while busy, else by dispatch.
+};
+
+// What dispatch queues on each type of node, and the most it queues per instance.
+inline auto node_queue(const std::shared_ptr<vm::NodeFSM>&) -> std::pair<uint32_t NodeStatus::*, uint32_t>
+{
+    return {&NodeStatus::test_case_count, vm_test_multiplier};
+}
+
+inline auto node_queue(const std::shared_ptr<svm::NodeFSM>&) -> std::pair<uint32_t NodeStatus::*, uint32_t>
+{
+    return {&NodeStatus::trace_count, vm_trace_multiplier};
+}
+
+/**
+ * Snapshot of the dispatch state, published each dispatch pass and rendered by the status thread.
+ */
+struct DispatchStatus
+{
+    bool published = false;
+    uint64_t time = 0;
+    size_t tests_left = 0;
+    size_t tests_total = 0;
+    size_t traces_left = 0;
+    size_t traces_total = 0;
+    fs::path profile_dir;
+    std::vector<std::pair<std::string, NodeStatus>> nodes; // Label (e.g., "1-[vm]") and last known status.
+};
+
 // +--------------------------------------------------+
 // + State Machine Front End                          +
 // +--------------------------------------------------+
@@ -1036,18 +1153,40 @@ public:
     DispatchFSM_();
     ~DispatchFSM_();
 
-    auto to_trace_pool(const Trace& trace) -> void;
     auto to_trace_pool(const std::vector<Trace>& trace) -> void;
+    auto to_test_pool(std::vector<TestCase>&& tests) -> void;
+    auto spill_trace(const fs::path& p,
+                     const Trace& trace) -> void;
     auto next_trace() -> boost::optional<Trace>;
     auto next_test() -> boost::optional<TestCase>;
     auto node_registrar() -> AtomicGuard<NodeRegistrar>&;
-    auto display_status(std::ostream& os) -> void;
-    auto write_statistics() -> void;
+    auto display_status(std::ostream& os,
+                        const DispatchStatus& status) -> void;
+    auto write_statistics(const DispatchStatus& status) -> void;
+    auto publish_status() -> void;
+    auto launch_status_display() -> void;
+    template <typename NodeFSMPtr>
+    auto ready_node_worker(const NodeFSMPtr& nfsm) -> std::shared_ptr<NodeWorker>;
+    template <typename NodeFSMPtr, typename Event>
+    auto post_event(const std::shared_ptr<NodeWorker>& worker,
+                    const NodeFSMPtr& nfsm,
+                    Event ev) -> void;
+    auto node_completions() -> uint64_t;
+    auto wait_for_node_activity(uint64_t seen) -> void;
+    auto drain_nodes() -> void;
     auto test_pool() -> TestPool&;
     auto trace_pool() -> TracePool&;
     auto set_up_root_dir() -> void;
     auto launch_node_registrar(Port master) -> void;
     auto elapsed_time() -> uint64_t;
+    auto open_journal() -> void;
+    auto journal(DispatchJournal::Record type,
+                 const std::string& payload) -> void;
+    auto replay(DispatchJournal::Record type,
+                const std::string& payload,
+                uint64_t& elapsed) -> void;
+    auto checkpoint() -> void;
+    auto snapshot() -> void;
     auto are_node_queues_empty() -> bool;
     auto are_all_queues_empty() -> bool;
     auto are_nodes_inactive() -> bool;
@@ -1151,13 +1290,28 @@ private:
     TestPool test_pool_{root_};
 //    TracePool trace_pool_{option::Dispatch{}, "weighted"};
     TracePool trace_pool_{option::Dispatch{}, "fifo"};
+    TraceCache trace_cache_{option::Trace{}.cache_size};
     AtomicGuard<VMNodeFSMs> vm_node_fsms_;
     AtomicGuard<SVMNodeFSMs> svm_node_fsms_;
     Port master_port_;
     crete::log::Logger exception_log_;
     crete::log::Logger node_error_log_;
 
+    boost::asio::io_service node_io_service_;
+    boost::asio::io_service::work node_io_work_{node_io_service_};
+    boost::thread_group node_threads_;
+    size_t node_thread_count_ = 0;
+    std::map<const void*, std::shared_ptr<NodeWorker>> node_workers_; // Keyed by node FSM. Dispatch thread only.
+    boost::mutex node_activity_mutex_;
+    boost::condition_variable node_activity_;
+    size_t nodes_in_flight_ = 0;
+    uint64_t node_completions_ = 0;
+    AtomicGuard<DispatchStatus> status_;
+    boost::thread status_thread_;
+
     std::chrono::time_point<std::chrono::system_clock> start_time_ = std::chrono::system_clock::now();
+    std::shared_ptr<DispatchJournal> journal_; // Of the pools under root_. Dispatch thread only.
+    uint64_t journaled_time_ = 0; // Last elapsed time journaled.
     bool first_{true};
     std::deque<std::string> next_target_queue_;
     std::string target_;
@@ -1303,6 +1457,14 @@ struct DispatchFSM_::init
     template <class EVT,class FSM,class SourceState,class TargetState>
     auto operator()(EVT const& ev, FSM& fsm, SourceState&, TargetState&) -> void
     {
+        auto last_root = fs::path{dispatch_root_dir_name} / dispatch_last_root_symlink;
+
+        if(ev.options_.journal.resume && fs::is_symlink(last_root))
+        {
+            fsm.root_ = fs::path{dispatch_root_dir_name} / fs::read_symlink(last_root);
+            fsm.test_pool_ = TestPool{fsm.root_};
+        }
+
         fsm.exception_log_.add_sink(fsm.root_ / log_dir_name / exception_log_file_name);
         fsm.exception_log_.auto_flush(true);
         fsm.node_error_log_.add_sink(fsm.root_ / log_dir_name / dispatch_node_error_log_file_name);
@@ -1315,13 +1477,17 @@ struct DispatchFSM_::init
 
 //        fsm.trace_pool_ = TracePool{fsm.options_, "weighted"}; // TODO: get strategy from guest config.
         fsm.trace_pool_ = TracePool{fsm.options_, "fifo"}; // TODO: get strategy from guest config.
+        fsm.trace_cache_ = TraceCache{fsm.options_.trace.cache_size};
 
         fsm.launch_node_registrar(fsm.master_port_);
 
         if(!fsm.options_.mode.distributed) // TODO: should be encoded into FSM.
         {
             fsm.set_up_root_dir();
+            fsm.open_journal();
         }
+
+        fsm.launch_status_display();
     }
 };
 
@@ -1335,11 +1501,15 @@ struct DispatchFSM_::reset
         fsm.test_pool_ = TestPool{fsm.root_};
 //        fsm.trace_pool_ = TracePool{fsm.options_, "weighted"}; // TODO: get strategy from guest config.
         fsm.trace_pool_ = TracePool{fsm.options_, "fifo"}; // TODO: get strategy from guest config.
+        fsm.trace_cache_.clear();
 
+        fsm.drain_nodes();
+        fsm.node_workers_.clear();
         fsm.vm_node_fsms_.acquire()->clear();
         fsm.svm_node_fsms_.acquire()->clear();
 
         fsm.start_time_ = std::chrono::system_clock::now();
+        fsm.open_journal(); // Picks up the target where it was left, if resuming.
 
         {
             auto lock = fsm.node_registrar_.acquire();
@@ -1405,6 +1575,11 @@ struct DispatchFSM_::dispatch
     template <class EVT,class FSM,class SourceState,class TargetState>
     auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState&) -> void
     {
+        // Nodes are serviced asynchronously: a node with an exchange still in flight is skipped,
+        // rather than waited on, and picked up on a later pass once it completes.
+        auto seen = fsm.node_completions();
+        auto serviced = 0u;
+
         {
             auto vmns_lock = fsm.vm_node_fsms_.acquire();
 
@@ -1412,20 +1587,25 @@ struct DispatchFSM_::dispatch
                           vmns_lock->end(),
                           [&] (VMNodeFSM& nfsm)
             {
+                auto worker = fsm.ready_node_worker(nfsm);
 
+                if(!worker)
+                    return;
+
+                ++serviced;
 
                 if(nfsm->is_flag_active<vm::flag::trace_rxed>())
                 {
                     fsm.to_trace_pool(nfsm->traces());
 
-                    nfsm->process_event(vm::trace{});
+                    fsm.post_event(worker, nfsm, vm::trace{});
                 }
                 else if(nfsm->is_flag_active<vm::flag::tx_test>())
                 {
                     auto tests = std::vector<TestCase>{};
-                    auto tc_count = nfsm->node_status().test_case_count;
+                    auto credits = worker->flow.credits();
 
-                    while(tc_count < (1*vm_test_multiplier)) // TODO: should be num_vm_insts*vm_test_multiplier. Also, should verify bandwidth, though I doubt this would be a problem.
+                    while(tests.size() < credits)
                     {
                         auto next = fsm.next_test();
 
@@ -1433,11 +1613,11 @@ struct DispatchFSM_::dispatch
                             break;
 
                         tests.emplace_back(*next);
-
-                        ++tc_count;
                     }
 
-                    nfsm->process_event(vm::test{tests});
+                    worker->flow.sent(tests.size());
+
+                    fsm.post_event(worker, nfsm, vm::test{std::move(tests)});
                 }
                 else if(nfsm->is_flag_active<vm::flag::error_rxed>())
                 {
@@ -1450,19 +1630,19 @@ struct DispatchFSM_::dispatch
                                             <<  err.log << "\n";
                     }
 
-                    nfsm->process_event(vm::poll{});
+                    fsm.post_event(worker, nfsm, vm::poll{});
                 }
                 else if(nfsm->is_flag_active<vm::flag::tx_config>())
                 {
-                    nfsm->process_event(vm::config{fsm.options_});
+                    fsm.post_event(worker, nfsm, vm::config{fsm.options_});
                 }
                 else if(nfsm->is_flag_active<vm::flag::image>())
                 {
-                    nfsm->process_event(vm::image{fsm.options_.vm.image.path});
+                    fsm.post_event(worker, nfsm, vm::image{fsm.options_.vm.image.path});
                 }
                 else
                 {
-                    nfsm->process_event(vm::poll{});
+                    fsm.post_event(worker, nfsm, vm::poll{});
                 }
             });
         }
@@ -1474,19 +1654,32 @@ struct DispatchFSM_::dispatch
                           svmns_lock->end(),
                           [&] (SVMNodeFSM& nfsm)
             {
+                auto worker = fsm.ready_node_worker(nfsm);
+
+                if(!worker)
+                    return;
+
+                ++serviced;
 
                 if(nfsm->is_flag_active<svm::flag::test_rxed>())
                 {
-                    fsm.test_pool_.insert(nfsm->tests());
+                    fsm.to_test_pool(nfsm->take_tests());
 
-                    nfsm->process_event(svm::test{});
+                    fsm.post_event(worker, nfsm, svm::test{});
                 }
                 else if(nfsm->is_flag_active<svm::flag::tx_trace>())
                 {
                     auto traces = std::vector<Trace>{};
-                    auto trace_count = nfsm->node_status().trace_count;
-
-                    while(trace_count < (1*vm_trace_multiplier)) // TODO: should be num_vm_insts*vm_trace_multiplier. Also, should verify bandwidth, though I doubt this would be a problem.
+                    auto credits = worker->flow.credits();
+                    // The node's share of the link over the horizon. Traces are large; never send
+                    // more than can be transferred before the node would need refilling anyway.
+                    auto byte_budget = static_cast<uint64_t>(bandwidth_in_bytes
+                                                             * worker->flow.horizon()
+                                                             / svmns_lock->size());
+                    auto bytes = uint64_t{0};
+
+                    while(traces.size() < credits
+                          && (traces.empty() || bytes < byte_budget))
                     {
                         try // TODO: I don't like it, but the trace could fail somehow (bug) and we need to continue testing. Have a better way?
                         {   // Cont: what seems to be causing the bug is that a supergraph is found which in turn causes a callback to call and remove it from the trace pool.
@@ -1496,9 +1689,9 @@ struct DispatchFSM_::dispatch
                             if(!next)
                                 break;
 
-                            traces.emplace_back(*next);
+                            bytes += next->data_.size();
 
-                            ++trace_count;
+                            traces.emplace_back(std::move(*next));
                         }
                         catch(std::exception& e)
                         {
@@ -1512,7 +1705,9 @@ struct DispatchFSM_::dispatch
                         }
                     }
 
-                    nfsm->process_event(svm::trace{traces});
+                    worker->flow.sent(traces.size());
+
+                    fsm.post_event(worker, nfsm, svm::trace{std::move(traces)});
                 }
                 else if(nfsm->is_flag_active<vm::flag::error_rxed>())
                 {
@@ -1525,23 +1720,28 @@ struct DispatchFSM_::dispatch
                                             <<  err.log << "\n";
                     }
 
-                    nfsm->process_event(svm::poll{});
+                    fsm.post_event(worker, nfsm, svm::poll{});
                 }
                 else if(nfsm->is_flag_active<vm::flag::tx_config>())
                 {
-                    nfsm->process_event(vm::config{fsm.options_});
+                    fsm.post_event(worker, nfsm, vm::config{fsm.options_});
                 }
                 else
                 {
-                    nfsm->process_event(svm::poll{});
+                    fsm.post_event(worker, nfsm, svm::poll{});
                 }
             });
         }
 
         fsm.first_ = false;
 
-        fsm.display_status(std::cout);
-        fsm.write_statistics();
+        fsm.checkpoint();
+        fsm.publish_status();
+
+        if(serviced == 0)
+        {
+            fsm.wait_for_node_activity(seen);
+        }
     }
 };
 
@@ -1569,6 +1769,9 @@ struct DispatchFSM_::finish
     template <class EVT,class FSM,class SourceState,class TargetState>
     auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState&) -> void
     {
+        fsm.drain_nodes();
+        fsm.checkpoint();
+
         auto p = fsm.root_ / log_dir_name;
 
         if(!fs::exists(p)) // TODO: encode as part of transition table. We only want to write the 'finish' file for existing tests, not the first time NextTest entered.
@@ -1585,7 +1788,9 @@ struct DispatchFSM_::finish
             BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{p.string()});
         }
 
-        fsm.display_status(ofs);
+        fsm.publish_status();
+        fsm.display_status(ofs,
+                           static_cast<DispatchStatus>(fsm.status_.acquire()));
     }
 };
 
@@ -1595,35 +1800,188 @@ DispatchFSM_::DispatchFSM_()
 
 DispatchFSM_::~DispatchFSM_()
 {
+    if(status_thread_.joinable())
+    {
+        status_thread_.interrupt();
+        status_thread_.join();
+    }
+
+    node_io_service_.stop();
+    node_threads_.join_all();
+
     if(node_registrar_driver_thread_.joinable())
     {
         node_registrar_driver_thread_.join();
     }
 }
 
-auto DispatchFSM_::to_trace_pool(const Trace& trace) -> void
+template <typename NodeFSMPtr>
+auto DispatchFSM_::ready_node_worker(const NodeFSMPtr& nfsm) -> std::shared_ptr<NodeWorker>
 {
-    auto p = root_ / dispatch_trace_dir_name / bui::to_string(trace.uuid_);
+    auto& worker = node_workers_[nfsm.get()];
+
+    if(!worker)
+    {
+        auto queue = node_queue(nfsm);
+
+        worker = std::make_shared<NodeWorker>(node_io_service_,
+                                              nfsm->node_status(),
+                                              nfsm->status_seq(),
+                                              queue.first,
+                                              queue.second);
+
+        // One thread per node, so that a node blocked mid-exchange never holds up another.
+        while(node_thread_count_ < node_workers_.size())
+        {
+            node_threads_.create_thread([this] { node_io_service_.run(); });
+
+            ++node_thread_count_;
+        }
+    }
+
+    if(worker->busy)
+    {
+        return std::shared_ptr<NodeWorker>{};
+    }
+
+    if(worker->error)
+    {
+        auto error = worker->error;
+
+        worker->error = std::exception_ptr{};
 
-    to_file(trace,
-            p);
+        std::rethrow_exception(error);
+    }
+
+    return worker;
+}
+
+template <typename NodeFSMPtr, typename Event>
+auto DispatchFSM_::post_event(const std::shared_ptr<NodeWorker>& worker,
+                              const NodeFSMPtr& nfsm,
+                              Event ev) -> void
+{
+    auto event = std::make_shared<Event>(std::move(ev)); // Shared, so traces and tests aren't copied into the handler.
 
-    if(!fs::exists(p))
     {
-        BOOST_THROW_EXCEPTION(Exception{} << err::file_missing{p.string()});
+        boost::lock_guard<boost::mutex> lock{node_activity_mutex_};
+
+        ++nodes_in_flight_;
     }
 
-    trace_pool_.insert(p);
+    worker->busy = true;
+
+    worker->strand.post([this, worker, nfsm, event]
+    {
+        try
+        {
+            nfsm->process_event(*event);
+
+            worker->observe(nfsm->node_status(),
+                            nfsm->status_seq());
+        }
+        catch(...)
+        {
+            worker->error = std::current_exception();
+        }
+
+        worker->busy = false;
+
+        {
+            boost::lock_guard<boost::mutex> lock{node_activity_mutex_};
+
+            --nodes_in_flight_;
+            ++node_completions_;
+        }
+
+        node_activity_.notify_all();
+    });
+}
+
+auto DispatchFSM_::node_completions() -> uint64_t
+{
+    boost::lock_guard<boost::mutex> lock{node_activity_mutex_};
+
+    return node_completions_;
+}
+
+auto DispatchFSM_::wait_for_node_activity(uint64_t seen) -> void
+{
+    boost::unique_lock<boost::mutex> lock{node_activity_mutex_};
+
+    node_activity_.wait_for(lock,
+                            boost::chrono::milliseconds{dispatch_idle_wait_ms},
+                            [this, seen] { return node_completions_ != seen; });
+}
+
+auto DispatchFSM_::drain_nodes() -> void
+{
+    boost::unique_lock<boost::mutex> lock{node_activity_mutex_};
+
+    node_activity_.wait(lock,
+                        [this] { return nodes_in_flight_ == 0; });
 }
 
 auto DispatchFSM_::to_trace_pool(const std::vector<Trace>& traces) -> void
 {
+    auto paths = TracePool::TracePaths{};
+    auto views = TracePool::TraceViews{};
+
+    // Analyzed from memory: a trace is only written out when it leaves the cache.
     for(const auto& trace : traces)
     {
-        to_trace_pool(trace);
+        auto p = root_ / dispatch_trace_dir_name / bui::to_string(trace.uuid_);
+
+        auto seq = boost::make_shared<const std::vector<uint8_t>>(read_trace_sequence(trace));
+
+        paths.emplace_back(p);
+        views.emplace_back(boost::make_shared<const TraceView>(p, seq));
+    }
+
+    auto inserted = trace_pool_.insert(paths, views); // The whole batch is analyzed at once, across cores.
+
+    for(auto i = 0u; i < traces.size(); ++i)
+    {
+        if(!inserted[i])
+        {
+            spill_trace(paths[i], traces[i]); // Never selected, but kept on disk as before.
+
+            continue;
+        }
+
+        for(const auto& evicted : trace_cache_.insert(paths[i], traces[i]))
+        {
+            spill_trace(evicted.first, evicted.second);
+        }
     }
 }
 
+auto DispatchFSM_::to_test_pool(std::vector<TestCase>&& tests) -> void
+{
+    if(journal_)
+    {
+        std::ostringstream os{std::ios::out | std::ios::binary};
+
+        {
+            boost::archive::binary_oarchive oa{os, boost::archive::no_header};
+
+            oa << tests;
+        }
+
+        journal(DispatchJournal::Record::tests_inserted, os.str());
+    }
+
+    test_pool_.insert(std::move(tests));
+}
+
+// Writes out a trace that was only held in memory.
+auto DispatchFSM_::spill_trace(const fs::path& p,
+                               const Trace& trace) -> void
+{
+    extract_archive(trace.data_,
+                    p);
+}
+
 auto DispatchFSM_::next_trace() -> boost::optional<Trace>
 {
     auto p = trace_pool_.next();
@@ -1633,14 +1991,31 @@ auto DispatchFSM_::next_trace() -> boost::optional<Trace>
         return boost::optional<Trace>{};
     }
 
-    auto trace = from_trace_file(*p);
+    journal(DispatchJournal::Record::trace_selected, p->generic_string());
 
-    return boost::optional<Trace>{trace};
+    auto trace = trace_cache_.take(*p);
+
+    if(trace)
+    {
+        // Same as from_trace_file: the forwarded trace gets a fresh ID. It was never on disk.
+        trace->uuid_ = bui::random_generator{}();
+
+        return trace;
+    }
+
+    return boost::optional<Trace>{from_trace_file(*p)};
 }
 
 auto DispatchFSM_::next_test() -> boost::optional<TestCase>
 {
-    return test_pool_.next();
+    auto tc = test_pool_.next();
+
+    if(tc)
+    {
+        journal(DispatchJournal::Record::tests_taken, std::string{});
+    }
+
+    return tc;
 }
 
 auto DispatchFSM_::launch_node_registrar(Port master) -> void
@@ -1665,18 +2040,197 @@ auto DispatchFSM_::elapsed_time() -> uint64_t
     return duration_cast<seconds>(current_time - start_time_).count();
 }
 
-auto DispatchFSM_::are_node_queues_empty() -> bool
+// Resumes from the journal under root_, if there is one, and journals from here on.
+auto DispatchFSM_::open_journal() -> void
 {
-    auto lock = node_registrar_.acquire();
-    auto& nodes = lock->nodes();
+    using namespace std::chrono;
 
-    auto nonempty = true;
+    journal_.reset(); // Syncs the last target's.
+    journal_ = std::make_shared<DispatchJournal>(root_);
 
-    for(const auto& n : nodes)
+    auto elapsed = uint64_t{0};
+    auto recovered = journal_->recover([this, &elapsed](const std::string& state)
     {
-        auto nl = n->acquire();
+        std::istringstream is{state, std::ios::in | std::ios::binary};
+        boost::archive::binary_iarchive ia{is};
 
-        const auto& st = nl->status;
+        ia >> elapsed;
+        ia >> test_pool_;
+        ia >> trace_pool_;
+    },
+    [this, &elapsed](DispatchJournal::Record type, const std::string& payload)
+    {
+        replay(type, payload, elapsed);
+    });
+
+    trace_pool_.commit_callback([this](const fs::path& p, const TraceAnalyzer::Prepared& prepared)
+    {
+        std::ostringstream os{std::ios::out | std::ios::binary};
+
+        {
+            boost::archive::binary_oarchive oa{os, boost::archive::no_header};
+            auto id = p.generic_string();
+
+            oa << id;
+            oa << prepared.trace.get_blocks();
+            oa << prepared.score;
+        }
+
+        journal(DispatchJournal::Record::trace_inserted, os.str());
+    });
+
+    if(!recovered)
+    {
+        return;
+    }
+
+    start_time_ = system_clock::now() - seconds{elapsed};
+    journaled_time_ = elapsed;
+
+    // Traces that were only held in memory (see TraceCache) went with the last run. A trace is
+    // written out only when it leaves the cache.
+    auto pending = TracePool::TracePaths{trace_pool_.pending().begin(),
+                                         trace_pool_.pending().end()};
+
+    for(const auto& p : pending)
+    {
+        if(!trace_artifact_exists(p, dispatch_trace_seq_file_name))
+        {
+            trace_pool_.withdraw(p);
+        }
+    }
+
+    snapshot(); // Withdrawals aren't journaled; and the next restart has less to replay.
+}
+
+auto DispatchFSM_::journal(DispatchJournal::Record type,
+                           const std::string& payload) -> void
+{
+    if(journal_)
+    {
+        journal_->append(type, payload);
+    }
+}
+
+auto DispatchFSM_::replay(DispatchJournal::Record type,
+                          const std::string& payload,
+                          uint64_t& elapsed) -> void
+{
+    using Record = DispatchJournal::Record;
+
+    std::istringstream is{payload, std::ios::in | std::ios::binary};
+
+    switch(type)
+    {
+    case Record::trace_inserted:
+    {
+        boost::archive::binary_iarchive ia{is, boost::archive::no_header};
+        auto id = std::string{};
+        auto prepared = TraceAnalyzer::Prepared{};
+
+        ia >> id;
+        ia >> prepared.trace.get_blocks();
+        ia >> prepared.score;
+
+        prepared.trace.set_id(id);
+
+        trace_pool_.replay_insert(fs::path{id}, prepared);
+        break;
+    }
+    case Record::trace_selected:
+    {
+        trace_pool_.replay_next(fs::path{payload});
+        break;
+    }
+    case Record::tests_inserted:
+    {
+        boost::archive::binary_iarchive ia{is, boost::archive::no_header};
+        auto tests = std::vector<TestCase>{};
+
+        ia >> tests;
+
+        test_pool_.replay_insert(std::move(tests));
+        break;
+    }
+    case Record::tests_taken:
+    {
+        test_pool_.next();
+        break;
+    }
+    case Record::elapsed_time:
+    {
+        boost::archive::binary_iarchive ia{is, boost::archive::no_header};
+
+        ia >> elapsed;
+        break;
+    }
+    default:
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::msg{"unknown dispatch journal record"}
+                                          << err::arg_invalid_uint{static_cast<size_t>(type)});
+    }
+    }
+}
+
+// Makes what's been journaled durable, compacting it once there's enough. Once per dispatch pass.
+auto DispatchFSM_::checkpoint() -> void
+{
+    if(!journal_)
+    {
+        return;
+    }
+
+    auto elapsed = elapsed_time();
+
+    if(elapsed != journaled_time_)
+    {
+        std::ostringstream os{std::ios::out | std::ios::binary};
+
+        {
+            boost::archive::binary_oarchive oa{os, boost::archive::no_header};
+
+            oa << elapsed;
+        }
+
+        journal(DispatchJournal::Record::elapsed_time, os.str());
+
+        journaled_time_ = elapsed;
+    }
+
+    journal_->sync();
+
+    if(journal_->size() >= dispatch_journal_snapshot_size)
+    {
+        snapshot();
+    }
+}
+
+auto DispatchFSM_::snapshot() -> void
+{
+    std::ostringstream os{std::ios::out | std::ios::binary};
+    auto elapsed = elapsed_time();
+
+    {
+        boost::archive::binary_oarchive oa{os};
+
+        oa << elapsed;
+        oa << test_pool_;
+        oa << trace_pool_;
+    }
+
+    journal_->snapshot(os.str());
+
+    journaled_time_ = elapsed;
+}
+
+auto DispatchFSM_::are_node_queues_empty() -> bool
+{
+    auto nonempty = true;
+
+    // Statuses as of each node's last exchange, so that a node mid-exchange isn't waited on.
+    for(const auto& w : node_workers_)
+    {
+        auto st = static_cast<NodeStatus>(w.second->status.acquire());
 
         if(st.test_case_count != 0 || st.trace_count != 0)
         {
@@ -1699,18 +2253,13 @@ auto DispatchFSM_::are_all_queues_empty() -> bool
 
 auto DispatchFSM_::are_nodes_inactive() -> bool
 {
-    auto lock = node_registrar_.acquire();
-    auto& nodes = lock->nodes();
-
     auto inactive = true;
 
-    for(const auto& n : nodes)
+    for(const auto& w : node_workers_)
     {
-        auto nl = n->acquire();
-
-        const auto& st = nl->status;
+        auto st = static_cast<NodeStatus>(w.second->status.acquire());
 
-        if(st.active)
+        if(w.second->busy || st.active)
         {
             inactive = false;
 
@@ -1819,12 +2368,11 @@ auto DispatchFSM_::set_up_root_dir() -> void
                        last_symlink);
 }
 
-auto DispatchFSM_::display_status(std::ostream& os) -> void
+auto DispatchFSM_::display_status(std::ostream& os,
+                                  const DispatchStatus& status) -> void
 {
     using namespace std;
 
-    system("clear");
-
     os << setw(12) << "time (s)"
          << "|"
          << setw(12) << "tests left"
@@ -1832,68 +2380,46 @@ auto DispatchFSM_::display_status(std::ostream& os) -> void
          << setw(12) << "traces left"
          << "|";
 
+    for(const auto& node : status.nodes)
     {
-        auto count = 1u;
-        auto lock = node_registrar_.acquire();
-        for(const auto& node : lock->nodes())
-        {
-            auto tt = std::string{};
-
-            tt += to_string(count++);
-
-            if(node->acquire()->type == packet_type::cluster_request_vm_node)
-                tt += "-[vm]";
-            else
-                tt += "-[svm]";
-
-            tt += " tc/tr";
-
-            os << setw(14) << tt
-                 << "|";
-        }
+        os << setw(14) << node.first + " tc/tr"
+             << "|";
     }
 
     os << endl;
 
-    auto etime = elapsed_time();
-    auto test = to_string(test_pool_.count_next()) +
+    auto test = to_string(status.tests_left) +
                  "/" +
-                 to_string(test_pool_.count_all());
-    auto trace = to_string(trace_pool_.count_next()) +
+                 to_string(status.tests_total);
+    auto trace = to_string(status.traces_left) +
                  "/" +
-                 to_string(trace_pool_.count_all_unique());
+                 to_string(status.traces_total);
 
-    os << setw(12) << etime
+    os << setw(12) << status.time
          << "|"
          << setw(12) << test
          << "|"
          << setw(12) << trace
          << "|";
 
+    for(const auto& node : status.nodes)
     {
-        auto lock = node_registrar_.acquire();
-        for(const auto& node : lock->nodes())
-        {
-            auto tt = std::string{};
-            auto lock = node->acquire();
-
-            tt += to_string(lock->status.test_case_count) +
+        auto tt = to_string(node.second.test_case_count) +
                   "/" +
-                  to_string(lock->status.trace_count);
-            os << setw(14) << tt
-                 << "|";
-        }
+                  to_string(node.second.trace_count);
+        os << setw(14) << tt
+             << "|";
     }
 
     os << endl;
 }
 
-auto DispatchFSM_::write_statistics() -> void
+auto DispatchFSM_::write_statistics(const DispatchStatus& status) -> void
 {
     static auto prev_time = decltype(elapsed_time()){0};
     static auto print_pg = true;
-    auto time = elapsed_time();
-    auto dir = root_ / dispatch_profile_dir_name;
+    auto time = status.time;
+    auto dir = status.profile_dir;
 
     if(time - prev_time >= options_.profile.interval)
     {
@@ -1933,10 +2459,10 @@ auto DispatchFSM_::write_statistics() -> void
     fs::ofstream ofs{dir / "stat.dat"
                     ,std::ios_base::app};
 
-    auto tc_left = test_pool_.count_next();
-    auto tc_total = test_pool_.count_all();
-    auto trace_left = trace_pool_.count_next();
-    auto trace_total = trace_pool_.count_all_unique();
+    auto tc_left = status.tests_left;
+    auto tc_total = status.tests_total;
+    auto trace_left = status.traces_left;
+    auto trace_total = status.traces_total;
 
     ofs << time
         << " "
@@ -1950,6 +2476,71 @@ auto DispatchFSM_::write_statistics() -> void
         << "\n";
 }
 
+auto DispatchFSM_::publish_status() -> void
+{
+    auto status = DispatchStatus{};
+
+    status.published = true;
+    status.time = elapsed_time();
+    status.tests_left = test_pool_.count_next();
+    status.tests_total = test_pool_.count_all();
+    status.traces_left = trace_pool_.count_next();
+    status.traces_total = trace_pool_.count_all_unique();
+    status.profile_dir = root_ / dispatch_profile_dir_name;
+
+    auto add_node = [&] (const void* nfsm, const std::string& type)
+    {
+        auto it = node_workers_.find(nfsm);
+
+        if(it == node_workers_.end())
+            return;
+
+        status.nodes.emplace_back(std::to_string(status.nodes.size() + 1) + "-[" + type + "]",
+                                  static_cast<NodeStatus>(it->second->status.acquire()));
+    };
+
+    {
+        auto vmns_lock = vm_node_fsms_.acquire();
+
+        for(auto it = vmns_lock->begin(); it != vmns_lock->end(); ++it)
+        {
+            add_node(it->get(), "vm");
+        }
+    }
+
+    {
+        auto svmns_lock = svm_node_fsms_.acquire();
+
+        for(auto it = svmns_lock->begin(); it != svmns_lock->end(); ++it)
+        {
+            add_node(it->get(), "svm");
+        }
+    }
+
+    status_.acquire() = status;
+}
+
+auto DispatchFSM_::launch_status_display() -> void
+{
+    // Clearing the terminal and writing statistics is slow; keep it out of the dispatch loop.
+    status_thread_ = boost::thread{[this] {
+        while(true)
+        {
+            boost::this_thread::sleep_for(boost::chrono::milliseconds{dispatch_status_interval_ms}); // Interruption point.
+
+            auto status = static_cast<DispatchStatus>(status_.acquire());
+
+            if(!status.published)
+                continue;
+
+            system("clear");
+
+            display_status(std::cout, status);
+            write_statistics(status);
+        }
+    }};
+}
+
 auto DispatchFSM_::node_registrar() -> AtomicGuard<NodeRegistrar>&
 {
     return node_registrar_;
@@ -2248,5 +2839,30 @@ auto make_dispatch_root() -> boost::filesystem::path
     return p / s;
 }
 
+auto read_trace_sequence(const Trace& trace) -> std::vector<uint8_t>
+{
+    auto name = bui::to_string(trace.uuid_);
+    auto container = read_archive_file(trace.data_, trace_container_file_name);
+
+    if(container)
+    {
+        TraceContainer tc{name,
+                          reinterpret_cast<const char*>(container->data()),
+                          container->size()};
+        auto s = tc.section(dispatch_trace_seq_file_name);
+
+        return std::vector<uint8_t>(s.data, s.data + s.size);
+    }
+
+    auto seq = read_archive_file(trace.data_, dispatch_trace_seq_file_name);
+
+    if(!seq)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::file_missing{name + "/" + dispatch_trace_seq_file_name});
+    }
+
+    return *seq;
+}
+
 } // namespace cluster
 } // namespace crete
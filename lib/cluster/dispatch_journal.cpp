@@ -0,0 +1,458 @@
+#include <crete/cluster/dispatch_journal.h>
+#include <crete/exception.h>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+namespace crete
+{
+namespace cluster
+{
+
+namespace
+{
+
+const char journal_magic[4] = {'C', 'R', 'D', 'J'};
+const char snapshot_magic[4] = {'C', 'R', 'D', 'S'};
+const auto journal_version = uint32_t{1};
+const auto journal_header_size = sizeof(journal_magic) + sizeof(uint32_t) + sizeof(uint64_t);
+
+template <typename T>
+auto put(std::string& buf, T v) -> void
+{
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Reads a T at pos, advancing it. False if the buffer ends first.
+template <typename T>
+auto get(const std::string& buf, size_t& pos, T& v) -> bool
+{
+    if(buf.size() - pos < sizeof(v))
+    {
+        return false;
+    }
+
+    std::memcpy(&v, buf.data() + pos, sizeof(v));
+    pos += sizeof(v);
+
+    return true;
+}
+
+auto crc(const char* data, size_t size) -> uint32_t
+{
+    auto c = boost::crc_32_type{};
+
+    c.process_bytes(data, size);
+
+    return c.checksum();
+}
+
+auto read_file(const fs::path& p) -> std::string
+{
+    fs::ifstream ifs{p, std::ios::in | std::ios::binary};
+
+    if(!ifs.good())
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{p.string()});
+    }
+
+    return std::string{std::istreambuf_iterator<char>{ifs},
+                       std::istreambuf_iterator<char>{}};
+}
+
+auto write_all(int fd, const std::string& buf, const fs::path& p) -> void
+{
+    auto written = size_t{0};
+
+    while(written < buf.size())
+    {
+        auto n = ::write(fd, buf.data() + written, buf.size() - written);
+
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                              << err::file{p.string()});
+        }
+
+        written += static_cast<size_t>(n);
+    }
+}
+
+auto sync_fd(int fd, const fs::path& p) -> void
+{
+    if(fdatasync(fd) != 0)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                          << err::file{p.string()});
+    }
+}
+
+// Makes a rename in dir durable.
+auto sync_dir(const fs::path& dir) -> void
+{
+    auto fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+
+    if(fd == -1)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                          << err::file_open_failed{dir.string()});
+    }
+
+    auto rc = fsync(fd);
+    auto e = errno;
+
+    ::close(fd);
+
+    if(rc != 0)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{e}
+                                          << err::file{dir.string()});
+    }
+}
+
+// Writes buf to p by way of a temporary beside it, so p is only ever whole.
+auto replace_file(const fs::path& p, const std::string& buf) -> void
+{
+    auto tmp = fs::path{p.string() + ".tmp"};
+    auto fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if(fd == -1)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                          << err::file_create{tmp.string()});
+    }
+
+    try
+    {
+        write_all(fd, buf, tmp);
+        sync_fd(fd, tmp);
+    }
+    catch(...)
+    {
+        ::close(fd);
+
+        throw;
+    }
+
+    ::close(fd);
+
+    fs::rename(tmp, p);
+
+    sync_dir(p.parent_path());
+}
+
+} // namespace
+
+DispatchJournal::DispatchJournal(const fs::path& dir)
+    : dir_{dir}
+{
+    if(!fs::exists(dir_))
+    {
+        fs::create_directories(dir_);
+    }
+}
+
+DispatchJournal::~DispatchJournal()
+{
+    try
+    {
+        sync();
+    }
+    catch(...)
+    {
+    }
+
+    if(fd_ != -1)
+    {
+        ::close(fd_);
+    }
+}
+
+auto DispatchJournal::recover(const Restore& restore,
+                              const Replay& replay) -> bool
+{
+    assert(fd_ == -1 && "recover() must come before anything is appended");
+
+    auto state = std::string{};
+    auto found = read_snapshot(state); // Sets next_ to the first record the snapshot doesn't hold.
+
+    if(found)
+    {
+        restore(state);
+    }
+
+    auto snapshot_next = next_;
+    auto p = dir_ / dispatch_journal_file_name;
+
+    if(!fs::exists(p))
+    {
+        restart(snapshot_next);
+
+        return found;
+    }
+
+    auto buf = read_file(p);
+    auto pos = size_t{0};
+    auto version = uint32_t{0};
+    auto first = uint64_t{0};
+
+    if(buf.size() < journal_header_size
+       || buf.compare(0, sizeof(journal_magic), journal_magic, sizeof(journal_magic)) != 0)
+    {
+        restart(snapshot_next); // Torn while being created: it never held a record.
+
+        return found;
+    }
+
+    pos += sizeof(journal_magic);
+    get(buf, pos, version);
+    get(buf, pos, first);
+
+    if(version != journal_version)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::msg{"unsupported dispatch journal version"}
+                                          << err::file{p.string()});
+    }
+
+    auto seq = first;
+    auto replayed = false;
+
+    for(;;)
+    {
+        auto start = pos;
+        auto size = uint32_t{0};
+        auto type = uint8_t{0};
+        auto checksum = uint32_t{0};
+
+        if(!get(buf, pos, size)
+           || buf.size() - pos < sizeof(type) + size + sizeof(checksum))
+        {
+            pos = start;
+
+            break;
+        }
+
+        auto body = pos; // Type and payload.
+
+        get(buf, pos, type);
+        pos += size;
+        get(buf, pos, checksum);
+
+        if(checksum != crc(buf.data() + body, sizeof(type) + size))
+        {
+            pos = start;
+
+            break;
+        }
+
+        if(seq >= snapshot_next)
+        {
+            replay(static_cast<Record>(type),
+                   buf.substr(body + sizeof(type), size));
+
+            replayed = true;
+        }
+
+        ++seq;
+    }
+
+    if(seq <= snapshot_next) // Every record is in the snapshot: the journal wasn't restarted after it.
+    {
+        next_ = snapshot_next;
+
+        restart(next_);
+
+        return found;
+    }
+
+    fd_ = ::open(p.c_str(), O_WRONLY);
+
+    if(fd_ == -1)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                          << err::file_open_failed{p.string()});
+    }
+
+    if(pos < buf.size()) // A torn record: drop it, so appends follow the last whole one.
+    {
+        if(ftruncate(fd_, static_cast<off_t>(pos)) != 0)
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                              << err::file{p.string()});
+        }
+
+        sync_fd(fd_, p);
+    }
+
+    if(lseek(fd_, static_cast<off_t>(pos), SEEK_SET) == -1)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                          << err::file{p.string()});
+    }
+
+    next_ = seq;
+    size_ = pos;
+
+    return found || replayed;
+}
+
+auto DispatchJournal::append(Record type,
+                             const std::string& payload) -> void
+{
+    if(fd_ == -1)
+    {
+        open();
+    }
+
+    auto body = buffer_.size() + sizeof(uint32_t);
+
+    put(buffer_, static_cast<uint32_t>(payload.size()));
+    put(buffer_, static_cast<uint8_t>(type));
+    buffer_.append(payload);
+    put(buffer_, crc(buffer_.data() + body, buffer_.size() - body));
+
+    ++next_;
+}
+
+auto DispatchJournal::sync() -> void
+{
+    if(buffer_.empty())
+    {
+        return;
+    }
+
+    auto p = dir_ / dispatch_journal_file_name;
+
+    write_all(fd_, buffer_, p);
+    sync_fd(fd_, p);
+
+    size_ += buffer_.size();
+    buffer_.clear();
+}
+
+auto DispatchJournal::snapshot(const std::string& state) -> void
+{
+    sync();
+
+    auto buf = std::string{snapshot_magic, sizeof(snapshot_magic)};
+
+    put(buf, journal_version);
+    put(buf, next_);
+    put(buf, static_cast<uint64_t>(state.size()));
+    buf.append(state);
+    put(buf, crc(state.data(), state.size()));
+
+    replace_file(dir_ / dispatch_snapshot_file_name, buf);
+
+    restart(next_);
+}
+
+auto DispatchJournal::size() const -> uint64_t
+{
+    return size_ + buffer_.size() - std::min<uint64_t>(size_, journal_header_size);
+}
+
+auto DispatchJournal::open() -> void
+{
+    fs::remove(dir_ / dispatch_snapshot_file_name); // Not recovered, so not to be mixed with what's appended.
+
+    next_ = 0;
+
+    restart(next_);
+}
+
+auto DispatchJournal::restart(uint64_t first) -> void
+{
+    auto p = dir_ / dispatch_journal_file_name;
+    auto header = std::string{journal_magic, sizeof(journal_magic)};
+
+    put(header, journal_version);
+    put(header, first);
+
+    if(fd_ != -1)
+    {
+        ::close(fd_);
+
+        fd_ = -1;
+    }
+
+    replace_file(p, header);
+
+    fd_ = ::open(p.c_str(), O_WRONLY | O_APPEND);
+
+    if(fd_ == -1)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::c_errno{errno}
+                                          << err::file_open_failed{p.string()});
+    }
+
+    next_ = first;
+    size_ = header.size();
+}
+
+auto DispatchJournal::read_snapshot(std::string& state) -> bool
+{
+    auto p = dir_ / dispatch_snapshot_file_name;
+
+    if(!fs::exists(p))
+    {
+        return false;
+    }
+
+    auto buf = read_file(p);
+    auto pos = sizeof(snapshot_magic);
+    auto version = uint32_t{0};
+    auto next = uint64_t{0};
+    auto size = uint64_t{0};
+    auto checksum = uint32_t{0};
+
+    // Only ever replaced whole, so any damage is not from a crash of ours.
+    if(buf.compare(0, sizeof(snapshot_magic), snapshot_magic, sizeof(snapshot_magic)) != 0
+       || !get(buf, pos, version)
+       || !get(buf, pos, next)
+       || !get(buf, pos, size)
+       || buf.size() - pos < size + sizeof(checksum))
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::msg{"malformed dispatch snapshot"}
+                                          << err::file{p.string()});
+    }
+
+    if(version != journal_version)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::msg{"unsupported dispatch snapshot version"}
+                                          << err::file{p.string()});
+    }
+
+    state = buf.substr(pos, size);
+    pos += size;
+    get(buf, pos, checksum);
+
+    if(checksum != crc(state.data(), state.size()))
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::msg{"dispatch snapshot failed its checksum"}
+                                          << err::file{p.string()});
+    }
+
+    next_ = next;
+
+    return true;
+}
+
+} // namespace cluster
+} // namespace crete
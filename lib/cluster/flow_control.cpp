@@ -0,0 +1,120 @@
+#include <crete/cluster/flow_control.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace crete
+{
+namespace cluster
+{
+
+namespace
+{
+
+auto smooth(double average,
+            double sample) -> double
+{
+    if(average == 0.0)
+    {
+        return sample;
+    }
+
+    return average + flow_control_smoothing * (sample - average);
+}
+
+} // namespace
+
+FlowControl::FlowControl(uint32_t max_per_instance)
+    : max_per_instance_{std::max(max_per_instance, 1u)}
+{
+}
+
+auto FlowControl::observe(uint64_t status_seq,
+                          uint32_t queued,
+                          uint32_t instances,
+                          Clock::time_point now) -> void
+{
+    if(observed_ && status_seq == status_seq_)
+    {
+        return; // Stale: the items sent since the last observation remain outstanding.
+    }
+
+    if(observed_)
+    {
+        auto dt = std::chrono::duration<double>{now - last_}.count();
+
+        if(dt > 0.0)
+        {
+            auto expected = queued_ + sent_;
+
+            if(expected > 0) // Otherwise the node sat idle, telling us nothing about its rate.
+            {
+                auto consumed = expected > queued ? expected - queued : 0u;
+                auto sample = consumed / dt;
+
+                if(queued == 0)
+                {
+                    // The node ran dry at some point in the interval, so it could have consumed more.
+                    rate_ = std::max(rate_, sample);
+                }
+                else
+                {
+                    rate_ = smooth(rate_, sample);
+                }
+            }
+
+            interval_ = smooth(interval_, dt);
+        }
+    }
+
+    queued_ = queued;
+    instances_ = std::max(instances, 1u);
+    sent_ = 0;
+    last_ = now;
+    observed_ = true;
+    status_seq_ = status_seq;
+}
+
+auto FlowControl::sent(uint32_t count) -> void
+{
+    sent_ += count;
+}
+
+auto FlowControl::credits() const -> uint32_t
+{
+    auto depth = std::max(static_cast<double>(instances_), // No instance should idle.
+                          rate_ * horizon());
+
+    depth = std::min(depth,
+                     static_cast<double>(instances_) * max_per_instance_);
+
+    auto target = static_cast<uint32_t>(std::ceil(depth));
+    auto outstanding = queued_ + sent_;
+
+    return target > outstanding ? target - outstanding : 0u;
+}
+
+auto FlowControl::horizon() const -> double
+{
+    // Double-buffer: cover the next refill as well as the current one.
+    return std::max(std::chrono::duration<double>{flow_control_min_horizon}.count(),
+                    2.0 * interval_);
+}
+
+auto FlowControl::rate() const -> double
+{
+    return rate_;
+}
+
+auto FlowControl::service_time() const -> double
+{
+    return rate_ > 0.0 ? instances_ / rate_ : 0.0;
+}
+
+auto FlowControl::instances() const -> uint32_t
+{
+    return instances_;
+}
+
+} // namespace cluster
+} // namespace crete
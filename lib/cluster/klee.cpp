@@ -1,5 +1,6 @@
 #include <crete/cluster/klee.h>
 #include <crete/exception.h>
+#include <crete/trace_container.h>
 #include <crete/process.h>
 
 #include <boost/filesystem.hpp>
@@ -134,11 +135,25 @@ auto Klee::prepare() -> void
         fs::create_directory(kdir);
     }
 
+    auto is_container = fs::exists(dir / trace_container_file_name);
+
+    if(is_container) // KLEE reads the rest in place. Only llvm-as needs a file.
+    {
+        copy_files = std::vector<std::string>{trace_container_file_name,
+                                              "dump_llvm.bc"};
+    }
+
     for(const auto f : copy_files)
     {
         fs::copy_file(dir/f, kdir/f);
     }
 
+    if(is_container)
+    {
+        TraceContainer{kdir / trace_container_file_name}.extract("main_function.ll",
+                                                                 kdir / "main_function.ll");
+    }
+
     ctx.work_directory = kdir.string();
 
     {
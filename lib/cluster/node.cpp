@@ -39,6 +39,7 @@ auto Node::status() const -> NodeStatus
     status.trace_count = traces_.size();
     status.error_count = errors_.size();
     status.active = active_;
+    status.instance_count = instance_count_;
 
     return status;
 }
@@ -141,6 +142,11 @@ auto Node::is_active() -> bool
     return active_;
 }
 
+auto Node::instance_count(uint32_t count) -> void
+{
+    instance_count_ = count;
+}
+
 auto Node::master_options() const -> const option::Dispatch&
 {
     return master_options_;
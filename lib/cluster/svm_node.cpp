@@ -113,6 +113,8 @@ auto SVMNode::have_trace() const -> bool
 auto SVMNode::add_instance() -> void
 {
     svms_.emplace_back(std::make_shared<node::svm::fsm::KleeFSM>());
+
+    instance_count(svms_.size());
 }
 
 auto SVMNode::add_instances(size_t count) -> void
@@ -3,6 +3,7 @@
 #include <crete/cluster/dispatch_options.h>
 #include <crete/cluster/svm_node_options.h>
 #include <crete/exception.h>
+#include <crete/trace_container.h>
 #include <crete/process.h>
 #include <crete/asio/server.h>
 #include <crete/run_config.h>
@@ -528,7 +529,9 @@ struct KleeFSM_::prepare
                                                       << err::arg_invalid_str{"vm.arch"});
                 }
 
-                auto args = std::vector<std::string>{fs::absolute(exe).string()}; // It appears our modified QEMU requires full path in argv[0]...
+                auto args = std::vector<std::string>{fs::absolute(exe).string(), // It appears our modified QEMU requires full path in argv[0]...
+                                                     "-j",
+                                                     std::to_string(node_options.translator.jobs)};
 
                 auto proc = bp::launch(exe, args, ctx);
 
@@ -557,11 +560,25 @@ struct KleeFSM_::prepare
                 fs::create_directory(kdir);
             }
 
+            auto is_container = fs::exists(dir / trace_container_file_name);
+
+            if(is_container) // KLEE reads the rest in place. Only llvm-as needs a file.
+            {
+                copy_files = std::vector<std::string>{trace_container_file_name,
+                                                      "dump_llvm.bc"};
+            }
+
             for(const auto f : copy_files)
             {
                 fs::copy_file(dir/f, kdir/f);
             }
 
+            if(is_container)
+            {
+                TraceContainer{kdir / trace_container_file_name}.extract("main_function.ll",
+                                                                         kdir / "main_function.ll");
+            }
+
             ctx.work_directory = kdir.string();
 
             {
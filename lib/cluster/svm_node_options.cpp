@@ -57,9 +57,15 @@ Translator::Translator(const pt::ptree& tree)
 
         path.x86 = trans.get<std::string>("path.x86", path.x86);
         path.x64 = trans.get<std::string>("path.x64", path.x64);
+        jobs = trans.get<uint32_t>("jobs", jobs);
 
         if(!path.x86.empty()) exception::file_exists(path.x86);
         if(!path.x64.empty()) exception::file_exists(path.x64);
+
+        if(jobs == 0)
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::arg_invalid_str{"crete.translator.jobs"});
+        }
     }
 }
 
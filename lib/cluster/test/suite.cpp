@@ -10,6 +10,23 @@
 #include <crete/cluster/svm_node.h>
 #include <crete/cluster/vm_node.h>
 #include <crete/cluster/dispatch.h>
+#include <crete/cluster/test_pool.h>
+#include <crete/cluster/trace_archive.h>
+#include <crete/cluster/trace_cache.h>
+#include <crete/cluster/flow_control.h>
+#include <crete/cluster/dispatch_journal.h>
+#include <crete/trace_container.h>
+#include <crete/trace_channel.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <sstream>
 
 namespace fs = boost::filesystem;
 namespace bui = boost::uuids;
@@ -437,3 +454,832 @@ BOOST_AUTO_TEST_CASE(vm_registrar_svm_interaction)
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_pool)
+
+auto make_test_case(uint64_t n) -> crete::TestCase
+{
+    auto elem = crete::TestCaseElement{};
+    auto name = std::string{"input"};
+
+    elem.name = std::vector<uint8_t>{name.begin(), name.end()};
+    elem.name_size = elem.name.size();
+    elem.data = std::vector<uint8_t>(32, 0);
+    elem.data_size = elem.data.size();
+
+    std::copy(reinterpret_cast<const uint8_t*>(&n),
+              reinterpret_cast<const uint8_t*>(&n) + sizeof(n),
+              elem.data.begin());
+
+    auto tc = crete::TestCase{};
+
+    tc.add_element(elem);
+
+    return tc;
+}
+
+BOOST_AUTO_TEST_CASE(digest_index_insert)
+{
+    using namespace crete;
+    using namespace crete::cluster;
+
+    const auto count = 10000u;
+
+    auto index = TestDigestSet{};
+
+    for(auto i = 0u; i < count; ++i)
+    {
+        BOOST_CHECK(index.insert(digest(make_test_case(i))));
+    }
+
+    BOOST_CHECK_EQUAL(index.size(), count);
+
+    for(auto i = 0u; i < count; i += 10)
+    {
+        BOOST_CHECK(!index.insert(digest(make_test_case(i))));
+    }
+
+    BOOST_CHECK_EQUAL(index.size(), count);
+}
+
+// Against the former approach, over 1M cases; the std::set alone takes half a minute.
+#if defined(benchmark)
+BOOST_AUTO_TEST_CASE(digest_index_insert_1m)
+{
+    using namespace crete;
+    using namespace crete::cluster;
+
+    const auto count = 1000000u;
+
+    auto tcs = std::vector<TestCase>{};
+    tcs.reserve(count);
+
+    for(auto i = 0u; i < count; ++i)
+    {
+        tcs.emplace_back(make_test_case(i));
+    }
+
+    auto st = std::chrono::high_resolution_clock::now();
+
+    auto index = TestDigestSet{};
+
+    for(const auto& tc : tcs)
+    {
+        index.insert(digest(tc));
+    }
+
+    auto et = std::chrono::high_resolution_clock::now();
+
+    BOOST_CHECK_EQUAL(index.size(), count);
+
+    std::cout << "digest index, 1M inserts: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(et - st).count()
+              << " ms" << std::endl;
+
+    // Former approach: std::set with a comparator serializing both operands on every comparison.
+    auto compare = [](const TestCase& lhs, const TestCase& rhs)
+    {
+        std::stringstream ssl, ssr;
+        lhs.write(ssl);
+        rhs.write(ssr);
+
+        return ssl.str() < ssr.str();
+    };
+
+    st = std::chrono::high_resolution_clock::now();
+
+    auto serialized_set = std::set<TestCase, decltype(compare)>{compare};
+
+    for(const auto& tc : tcs)
+    {
+        serialized_set.insert(tc);
+    }
+
+    et = std::chrono::high_resolution_clock::now();
+
+    BOOST_CHECK_EQUAL(serialized_set.size(), count);
+
+    std::cout << "serialized std::set, 1M inserts: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(et - st).count()
+              << " ms" << std::endl;
+}
+#endif // benchmark
+
+BOOST_AUTO_TEST_CASE(test_pool_bulk_insert_1m)
+{
+    using namespace crete;
+    using namespace crete::cluster;
+
+    const auto count = 1000000u;
+    const auto unique = 10000u;
+
+    auto root = fs::temp_directory_path() / fs::unique_path();
+    auto pool = TestPool{root};
+
+    auto tcs = std::vector<TestCase>{};
+    tcs.reserve(count);
+
+    for(auto i = 0u; i < count; ++i)
+    {
+        tcs.emplace_back(make_test_case(i % unique));
+    }
+
+    auto st = std::chrono::high_resolution_clock::now();
+
+    pool.insert(std::move(tcs));
+
+    auto et = std::chrono::high_resolution_clock::now();
+
+    BOOST_CHECK_EQUAL(pool.count_all(), unique);
+    BOOST_CHECK_EQUAL(pool.count_next(), unique);
+    BOOST_CHECK(!pool.insert(make_test_case(0)));
+
+    std::cout << "TestPool bulk insert, 1M tests (" << unique << " unique): "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(et - st).count()
+              << " ms" << std::endl;
+
+    pool.flush();
+
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_CASE(test_pool_pack_round_trip)
+{
+    using namespace crete;
+    using namespace crete::cluster;
+
+    const auto count = 50000u;
+
+    auto root = fs::temp_directory_path() / fs::unique_path();
+
+    {
+        auto pool = TestPool{root};
+
+        for(auto i = 0u; i < count; ++i)
+        {
+            pool.insert(make_test_case(i));
+        }
+
+        pool.flush();
+    }
+
+    TestCasePackReader reader{root / "test-case"};
+
+    BOOST_REQUIRE_EQUAL(reader.count(), count);
+
+    auto tc = TestCase{};
+    auto i = 0u;
+
+    while(reader.next(tc))
+    {
+        BOOST_CHECK(digest(tc) == digest(make_test_case(i)));
+        ++i;
+    }
+
+    BOOST_CHECK_EQUAL(i, count);
+
+    // Small segments: the reader must stitch segments back together in order.
+    {
+        TestCasePackWriter writer{root / "small", 1024};
+
+        for(auto j = 0u; j < 1000u; ++j)
+        {
+            writer.append(make_test_case(j));
+
+            if(j % 100 == 0)
+                writer.sync();
+        }
+    }
+
+    TestCasePackReader small{root / "small"};
+
+    BOOST_REQUIRE_EQUAL(small.count(), 1000u);
+
+    for(auto j = 0u; small.next(tc); ++j)
+    {
+        BOOST_CHECK(digest(tc) == digest(make_test_case(j)));
+    }
+
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_CASE(state_round_trip)
+{
+    using namespace crete;
+    using namespace crete::cluster;
+
+    auto root = fs::temp_directory_path() / fs::unique_path();
+    auto state = std::stringstream{};
+
+    {
+        auto pool = TestPool{root};
+
+        for(auto i = 0u; i < 5000u; ++i)
+        {
+            pool.insert(make_test_case(i));
+        }
+
+        pool.next();
+
+        boost::archive::binary_oarchive oa{state};
+
+        oa << pool;
+
+        pool.flush();
+    }
+
+    auto restored = TestPool{root / "restored"};
+
+    {
+        boost::archive::binary_iarchive ia{state};
+
+        ia >> restored;
+    }
+
+    BOOST_CHECK_EQUAL(restored.count_all(), 5000u);
+    BOOST_CHECK_EQUAL(restored.count_next(), 4999u);
+    BOOST_CHECK(!restored.insert(make_test_case(0)));
+
+    restored.replay_insert(std::vector<TestCase>{make_test_case(1), make_test_case(5000)});
+
+    BOOST_CHECK_EQUAL(restored.count_all(), 5001u);
+
+    auto next = restored.next();
+
+    BOOST_REQUIRE(next);
+    BOOST_CHECK(digest(*next) == digest(make_test_case(1))); // Taken in the same order.
+
+    restored.flush();
+
+    BOOST_CHECK(!fs::exists(root / "restored")); // Replayed test cases were written the first time.
+
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_archive)
+
+auto write_file(const fs::path& p, const std::vector<uint8_t>& data) -> void
+{
+    fs::ofstream ofs{p, std::ios_base::out | std::ios_base::binary};
+
+    ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+auto read_file(const fs::path& p) -> std::vector<uint8_t>
+{
+    fs::ifstream ifs{p, std::ios_base::in | std::ios_base::binary};
+
+    return std::vector<uint8_t>{std::istreambuf_iterator<char>{ifs},
+                                std::istreambuf_iterator<char>{}};
+}
+
+// Roughly shaped like a runtime-dump: a long, repetitive TB sequence, some noisy memory and a few small files.
+auto make_trace_dir(const fs::path& dir, size_t size) -> void
+{
+    auto engine = std::mt19937_64{42};
+
+    fs::create_directories(dir / "sub");
+
+    auto seq = std::vector<uint8_t>{};
+    auto pcs = std::vector<uint64_t>(512);
+
+    for(auto& pc : pcs)
+    {
+        pc = 0xc0100000u + (engine() & 0xfffff);
+    }
+
+    while(seq.size() < size * 8 / 10)
+    {
+        auto run = engine() % 64;
+        auto start = engine() % (pcs.size() - 64);
+
+        for(auto i = 0u; i < run; ++i)
+        {
+            auto pc = pcs[start + i];
+            seq.insert(seq.end(),
+                       reinterpret_cast<const uint8_t*>(&pc),
+                       reinterpret_cast<const uint8_t*>(&pc) + sizeof(pc));
+        }
+    }
+
+    auto noise = std::vector<uint8_t>(size - seq.size());
+
+    for(auto& b : noise)
+    {
+        b = static_cast<uint8_t>(engine());
+    }
+
+    write_file(dir / "tb-seq.bin", seq);
+    write_file(dir / "memory.bin", noise);
+    write_file(dir / "sub" / "small.txt", std::vector<uint8_t>(100, 'x'));
+    write_file(dir / "empty.bin", std::vector<uint8_t>{});
+}
+
+auto check_same_tree(const fs::path& lhs, const fs::path& rhs) -> void
+{
+    for(const auto& name : {"tb-seq.bin", "memory.bin", "sub/small.txt", "empty.bin"})
+    {
+        BOOST_CHECK(read_file(lhs / name) == read_file(rhs / name));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lz_round_trip)
+{
+    using namespace crete::cluster;
+
+    auto engine = std::mt19937{7};
+
+    for(auto size : {0u, 1u, 11u, 12u, 13u, 100u, 65536u, 1000000u})
+    {
+        auto src = std::vector<uint8_t>(size);
+
+        for(auto i = 0u; i < size; ++i)
+        {
+            src[i] = (i % 3 == 0) ? static_cast<uint8_t>(engine() % 4) : static_cast<uint8_t>(i / 1000);
+        }
+
+        auto packed = std::vector<uint8_t>{};
+
+        lz_compress(src.data(), src.size(), packed);
+
+        auto dst = std::vector<uint8_t>(size);
+
+        BOOST_REQUIRE(lz_decompress(packed.data(), packed.size(), dst.data(), dst.size()));
+        BOOST_CHECK(src == dst);
+
+        if(!packed.empty() && size > 0)
+        {
+            BOOST_CHECK(!lz_decompress(packed.data(), packed.size(), dst.data(), dst.size() - 1));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(archive_round_trip)
+{
+    using namespace crete::cluster;
+
+    auto root = fs::temp_directory_path() / fs::unique_path();
+    auto src = root / "src";
+
+    make_trace_dir(src, 1000000);
+
+    for(auto compression : {TraceCompression::none, TraceCompression::lz})
+    {
+        auto dst = root / ("dst-" + std::to_string(static_cast<int>(compression)));
+
+        extract_archive(archive_directory(src, compression), dst);
+
+        check_same_tree(src, dst);
+    }
+
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_CASE(archive_filtered_extract)
+{
+    using namespace crete::cluster;
+
+    auto root = fs::temp_directory_path() / fs::unique_path();
+    auto src = root / "src";
+    auto dst = root / "dst";
+
+    make_trace_dir(src, 100000);
+
+    auto data = archive_directory(src, TraceCompression::lz);
+
+    extract_archive(data, dst, [](const std::string& e) { return e == "tb-seq.bin"; });
+
+    BOOST_CHECK(fs::exists(dst / "tb-seq.bin"));
+    BOOST_CHECK(!fs::exists(dst / "memory.bin"));
+    BOOST_CHECK(!fs::exists(dst / "sub"));
+
+    extract_archive(data, dst, [](const std::string& e) { return e != "tb-seq.bin"; });
+
+    check_same_tree(src, dst);
+
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_CASE(archive_read_file)
+{
+    using namespace crete::cluster;
+
+    auto root = fs::temp_directory_path() / fs::unique_path();
+    auto src = root / "src";
+
+    make_trace_dir(src, 100000);
+
+    auto data = archive_directory(src, TraceCompression::lz);
+    auto seq = read_archive_file(data, "tb-seq.bin");
+
+    BOOST_REQUIRE(seq);
+    BOOST_CHECK(*seq == read_file(src / "tb-seq.bin"));
+    BOOST_CHECK(!read_archive_file(data, "sub")); // Not a file.
+    BOOST_CHECK(!read_archive_file(data, "missing.bin"));
+
+    // Within a trace container.
+    {
+        TraceContainerWriter writer{src / trace_container_file_name};
+
+        writer.add("tb-seq.bin", seq->data(), seq->size(), true);
+        writer.close();
+    }
+
+    fs::remove(src / "tb-seq.bin");
+
+    auto trace = Trace{};
+
+    trace.data_ = archive_directory(src, TraceCompression::none);
+
+    BOOST_CHECK(read_trace_sequence(trace) == *seq);
+
+    fs::remove(src / trace_container_file_name);
+
+    trace.data_ = archive_directory(src, TraceCompression::none);
+
+    BOOST_CHECK_THROW(read_trace_sequence(trace), crete::Exception);
+
+    fs::remove_all(root);
+}
+
+// Former transfer path: tar -z into a temporary file, read back; write out, tar -x.
+BOOST_AUTO_TEST_CASE(archive_vs_tar_50mb)
+{
+    using namespace crete::cluster;
+
+    const auto size = size_t{50u * 1024u * 1024u};
+
+    auto root = fs::temp_directory_path() / fs::unique_path();
+    auto src = root / "trace";
+
+    make_trace_dir(src, size);
+
+    auto mb_per_s = [size](std::chrono::high_resolution_clock::duration d)
+    {
+        return (size / (1024.0 * 1024.0)) / std::chrono::duration<double>(d).count();
+    };
+
+    // tar
+    {
+        auto st = std::chrono::high_resolution_clock::now();
+
+        auto cmd = "cd " + root.string() + " && tar -zcf trace.tar.gz trace";
+        BOOST_REQUIRE_EQUAL(std::system(cmd.c_str()), 0);
+        auto data = read_file(root / "trace.tar.gz");
+        fs::remove(root / "trace.tar.gz");
+
+        auto mt = std::chrono::high_resolution_clock::now();
+
+        fs::create_directories(root / "tar-out");
+        write_file(root / "tar-out" / "trace.tar.gz", data);
+        cmd = "cd " + (root / "tar-out").string() + " && tar -xf trace.tar.gz";
+        BOOST_REQUIRE_EQUAL(std::system(cmd.c_str()), 0);
+        fs::remove(root / "tar-out" / "trace.tar.gz");
+
+        auto et = std::chrono::high_resolution_clock::now();
+
+        check_same_tree(src, root / "tar-out" / "trace");
+
+        std::cout << "tar -z: " << data.size() << " bytes, pack "
+                  << mb_per_s(mt - st) << " MB/s, unpack "
+                  << mb_per_s(et - mt) << " MB/s" << std::endl;
+    }
+
+    for(auto compression : {TraceCompression::none, TraceCompression::lz})
+    {
+        auto dst = root / ("out-" + std::to_string(static_cast<int>(compression)));
+
+        auto st = std::chrono::high_resolution_clock::now();
+
+        auto data = archive_directory(src, compression);
+
+        auto mt = std::chrono::high_resolution_clock::now();
+
+        extract_archive(data, dst);
+
+        auto et = std::chrono::high_resolution_clock::now();
+
+        check_same_tree(src, dst);
+
+        std::cout << "archive (" << (compression == TraceCompression::lz ? "lz" : "none") << "): "
+                  << data.size() << " bytes, pack "
+                  << mb_per_s(mt - st) << " MB/s, unpack "
+                  << mb_per_s(et - mt) << " MB/s" << std::endl;
+    }
+
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_cache)
+
+BOOST_AUTO_TEST_CASE(lru_eviction)
+{
+    using namespace crete::cluster;
+
+    auto make_trace = [](size_t size)
+    {
+        auto t = Trace{};
+        t.data_.resize(size);
+
+        return t;
+    };
+
+    auto cache = TraceCache{300};
+
+    BOOST_CHECK(cache.insert("a", make_trace(100)).empty());
+    BOOST_CHECK(cache.insert("b", make_trace(100)).empty());
+    BOOST_CHECK(cache.insert("c", make_trace(100)).empty());
+    BOOST_CHECK_EQUAL(cache.size(), 300u);
+
+    auto evicted = cache.insert("d", make_trace(150));
+
+    BOOST_REQUIRE_EQUAL(evicted.size(), 2u);
+    BOOST_CHECK_EQUAL(evicted[0].first, fs::path{"a"});
+    BOOST_CHECK_EQUAL(evicted[1].first, fs::path{"b"});
+    BOOST_CHECK_EQUAL(cache.size(), 250u);
+
+    auto c = cache.take("c");
+
+    BOOST_REQUIRE(c);
+    BOOST_CHECK_EQUAL(c->data_.size(), 100u);
+    BOOST_CHECK(!cache.take("c"));
+    BOOST_CHECK(!cache.contains("a"));
+    BOOST_CHECK(cache.contains("d"));
+    BOOST_CHECK_EQUAL(cache.count(), 1u);
+
+    // Larger than the whole cache: handed straight back.
+    evicted = cache.insert("e", make_trace(1000));
+
+    BOOST_REQUIRE_EQUAL(evicted.size(), 2u);
+    BOOST_CHECK_EQUAL(evicted[1].first, fs::path{"e"});
+    BOOST_CHECK_EQUAL(cache.size(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(flow_control)
+
+BOOST_AUTO_TEST_CASE(credits_track_service_rate)
+{
+    using namespace crete::cluster;
+    using std::chrono::milliseconds;
+
+    auto t = FlowControl::Clock::time_point{};
+    auto flow = FlowControl{20};
+
+    // Unmeasured: one item per instance.
+    flow.observe(1, 0, 32, t);
+
+    BOOST_CHECK_EQUAL(flow.credits(), 32u);
+
+    flow.sent(32);
+
+    BOOST_CHECK_EQUAL(flow.credits(), 0u);
+
+    // Fast node: drained all 32 in 100ms. Enough to last the minimum horizon (500ms) is queued.
+    t += milliseconds{100};
+    flow.observe(2, 0, 32, t);
+
+    BOOST_CHECK_CLOSE(flow.rate(), 320.0, 0.001);
+    BOOST_CHECK_EQUAL(flow.credits(), 160u);
+
+    // Faster still: bounded by the per-instance cap.
+    flow.sent(160);
+    t += milliseconds{10};
+    flow.observe(3, 0, 32, t);
+
+    BOOST_CHECK_EQUAL(flow.credits(), 32u * 20u);
+
+    // Slow node: consumes 1 item per second with a single instance.
+    auto slow = FlowControl{20};
+
+    slow.observe(1, 0, 1, t);
+    slow.sent(1);
+    slow.observe(2, 1, 1, t + milliseconds{1000});
+    slow.observe(3, 0, 1, t + milliseconds{2000});
+
+    BOOST_CHECK_CLOSE(slow.service_time(), 1.0, 0.001);
+    BOOST_CHECK_EQUAL(slow.credits(), 2u); // Rate (1/s) over the horizon (2 * 1s).
+}
+
+BOOST_AUTO_TEST_CASE(stale_observations_ignored)
+{
+    using namespace crete::cluster;
+    using std::chrono::milliseconds;
+
+    auto t = FlowControl::Clock::time_point{};
+    auto fresh = FlowControl{20};
+    auto mixed = FlowControl{20};
+
+    // The same node, observed only on fresh statuses, and also between them on repeats of the last.
+    fresh.observe(1, 0, 1, t);
+    mixed.observe(1, 0, 1, t);
+
+    for(auto seq = uint64_t{2}; seq < 10; ++seq)
+    {
+        auto credits = fresh.credits();
+
+        BOOST_CHECK_EQUAL(mixed.credits(), credits);
+
+        fresh.sent(credits);
+        mixed.sent(credits);
+
+        for(auto i = 1; i < 10; ++i)
+        {
+            mixed.observe(seq - 1, 0, 1, t + milliseconds{i * 10});
+
+            BOOST_CHECK_EQUAL(mixed.credits(), 0u); // Those sent remain outstanding.
+        }
+
+        t += milliseconds{100};
+        fresh.observe(seq, 0, 1, t);
+        mixed.observe(seq, 0, 1, t);
+
+        BOOST_CHECK_CLOSE(mixed.rate(), fresh.rate(), 0.001);
+        BOOST_CHECK_CLOSE(mixed.horizon(), fresh.horizon(), 0.001);
+    }
+
+    BOOST_CHECK_GT(mixed.rate(), 1.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(dispatch_journal)
+
+BOOST_AUTO_TEST_CASE(recovers_snapshot_then_records)
+{
+    using namespace crete::cluster;
+    using Record = DispatchJournal::Record;
+    using Replayed = std::vector<std::pair<Record, std::string>>;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+    auto journal_path = dir / dispatch_journal_file_name;
+
+    auto recover = [&dir](std::string& state, Replayed& replayed)
+    {
+        auto journal = std::make_shared<DispatchJournal>(dir);
+
+        state.clear();
+        replayed.clear();
+
+        auto found = journal->recover([&state](const std::string& s) { state = s; },
+                                      [&replayed](Record type, const std::string& payload)
+        {
+            replayed.emplace_back(type, payload);
+        });
+
+        return std::make_pair(found, journal);
+    };
+
+    auto state = std::string{};
+    auto replayed = Replayed{};
+
+    {
+        auto r = recover(state, replayed);
+
+        BOOST_CHECK(!r.first);
+
+        auto& journal = *r.second;
+
+        journal.append(Record::tests_taken, "");
+        journal.append(Record::trace_selected, "a");
+        journal.sync();
+        journal.snapshot("state-1");
+
+        BOOST_CHECK_EQUAL(journal.size(), 0u);
+
+        journal.append(Record::trace_selected, "b");
+        journal.append(Record::elapsed_time, std::string(1000, 'x'));
+        journal.sync();
+        journal.append(Record::trace_selected, "c"); // Synced on destruction.
+    }
+
+    // A crash mid-append: a record's worth of bytes, but not a whole one.
+    {
+        fs::ofstream ofs{journal_path, std::ios::out | std::ios::binary | std::ios::app};
+        auto size = uint32_t{100};
+
+        ofs.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        ofs << "torn";
+    }
+
+    {
+        auto r = recover(state, replayed);
+
+        BOOST_CHECK(r.first);
+        BOOST_CHECK_EQUAL(state, "state-1");
+        BOOST_REQUIRE_EQUAL(replayed.size(), 3u);
+        BOOST_CHECK(replayed[0] == std::make_pair(Record::trace_selected, std::string{"b"}));
+        BOOST_CHECK(replayed[1] == std::make_pair(Record::elapsed_time, std::string(1000, 'x')));
+        BOOST_CHECK(replayed[2] == std::make_pair(Record::trace_selected, std::string{"c"}));
+
+        r.second->append(Record::trace_selected, "d"); // Follows "c", not the torn bytes.
+    }
+
+    BOOST_CHECK_EQUAL(recover(state, replayed).first, true);
+    BOOST_REQUIRE_EQUAL(replayed.size(), 4u);
+    BOOST_CHECK_EQUAL(replayed[3].second, "d");
+
+    // A crash after a snapshot is in place, but before the journal restarts: the records it holds
+    // are skipped.
+    {
+        auto r = recover(state, replayed);
+
+        r.second->append(Record::trace_selected, "e");
+        r.second->sync();
+
+        fs::copy_file(journal_path, dir / "journal.old");
+
+        r.second->snapshot("state-2");
+        r.second->append(Record::trace_selected, "f");
+    }
+
+    fs::remove(journal_path);
+    fs::rename(dir / "journal.old", journal_path);
+
+    BOOST_CHECK_EQUAL(recover(state, replayed).first, true);
+    BOOST_CHECK_EQUAL(state, "state-2");
+    BOOST_CHECK(replayed.empty());
+
+    {
+        auto r = recover(state, replayed);
+
+        r.second->append(Record::trace_selected, "g");
+    }
+
+    recover(state, replayed);
+
+    BOOST_REQUIRE_EQUAL(replayed.size(), 1u);
+    BOOST_CHECK_EQUAL(replayed[0].second, "g");
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_channel)
+
+BOOST_AUTO_TEST_CASE(trace_channel_round_trip)
+{
+    using namespace crete;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+
+    fs::create_directories(dir);
+
+    TraceChannel qemu;
+    TraceChannel node;
+
+    qemu.listen(dir / trace_channel_file_name);
+
+    BOOST_CHECK(!qemu.accept(0)); // No peer yet.
+
+    node.connect(dir / trace_channel_file_name);
+
+    BOOST_REQUIRE(qemu.accept(1000));
+
+    auto type = uint32_t{0};
+    auto payload = std::string{};
+
+    BOOST_CHECK(!qemu.receive(type, payload, 0)); // Nothing sent yet.
+
+    // Far larger than the socket buffer: the send only completes as the other end reads.
+    auto input = std::string(16u * 1024u * 1024u, '\0');
+    auto engine = std::mt19937{42};
+
+    for(auto& c : input)
+    {
+        c = static_cast<char>(engine());
+    }
+
+    boost::thread sender{[&node, &input] { node.send(trace_channel_test_input, input); }};
+
+    BOOST_REQUIRE(qemu.receive(type, payload, -1));
+
+    sender.join();
+
+    BOOST_CHECK_EQUAL(type, trace_channel_test_input);
+    BOOST_CHECK(payload == input);
+
+    qemu.send(trace_channel_trace_ready, std::string{});
+
+    BOOST_REQUIRE(node.receive(type, payload, 1000));
+    BOOST_CHECK_EQUAL(type, trace_channel_trace_ready);
+    BOOST_CHECK(payload.empty());
+
+    node.close();
+
+    BOOST_CHECK_THROW(qemu.receive(type, payload, -1), std::runtime_error); // Peer disconnected.
+
+    qemu.close();
+
+    BOOST_CHECK(!fs::exists(dir / trace_channel_file_name));
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,8 +1,11 @@
 #include <crete/cluster/test_pool.h>
 
 #include <iostream>
+#include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <stdexcept>
+#include <algorithm>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -16,6 +19,360 @@ namespace crete
 namespace cluster
 {
 
+namespace
+{
+
+inline auto rotl64(uint64_t x, int r) -> uint64_t
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline auto fmix64(uint64_t k) -> uint64_t
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+
+    return k;
+}
+
+/**
+ * Incremental MurmurHash3 (x64, 128-bit variant).
+ * Lets a test case be digested field by field, without serializing it into a temporary stream.
+ */
+class Murmur3Hasher
+{
+public:
+    auto update(const void* data, size_t len) -> void
+    {
+        auto p = static_cast<const uint8_t*>(data);
+
+        length_ += len;
+
+        while(len > 0)
+        {
+            auto n = std::min(len, sizeof(block_) - filled_);
+
+            std::memcpy(block_ + filled_, p, n);
+
+            filled_ += n;
+            p += n;
+            len -= n;
+
+            if(filled_ == sizeof(block_))
+            {
+                mix_block();
+                filled_ = 0;
+            }
+        }
+    }
+
+    auto finalize() -> TestCaseDigest
+    {
+        uint8_t tail[16] = {0};
+        uint64_t k1 = 0;
+        uint64_t k2 = 0;
+
+        std::memcpy(tail, block_, filled_);
+        std::memcpy(&k1, tail, sizeof(k1));
+        std::memcpy(&k2, tail + 8, sizeof(k2));
+
+        if(filled_ > 8)
+        {
+            k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2_ ^= k2;
+        }
+        if(filled_ > 0)
+        {
+            k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1_ ^= k1;
+        }
+
+        h1_ ^= length_;
+        h2_ ^= length_;
+
+        h1_ += h2_;
+        h2_ += h1_;
+
+        h1_ = fmix64(h1_);
+        h2_ = fmix64(h2_);
+
+        h1_ += h2_;
+        h2_ += h1_;
+
+        auto d = TestCaseDigest{};
+        d.lo = h1_;
+        d.hi = h2_;
+
+        return d;
+    }
+
+private:
+    auto mix_block() -> void
+    {
+        uint64_t k1 = 0;
+        uint64_t k2 = 0;
+
+        std::memcpy(&k1, block_, sizeof(k1));
+        std::memcpy(&k2, block_ + 8, sizeof(k2));
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1_ ^= k1;
+        h1_ = rotl64(h1_, 27); h1_ += h2_; h1_ = h1_ * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2_ ^= k2;
+        h2_ = rotl64(h2_, 31); h2_ += h1_; h2_ = h2_ * 5 + 0x38495ab5;
+    }
+
+private:
+    static const uint64_t c1 = 0x87c37b91114253d5ULL;
+    static const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+    uint64_t h1_ = 0;
+    uint64_t h2_ = 0;
+    uint64_t length_ = 0;
+    uint8_t block_[16];
+    size_t filled_ = 0;
+};
+
+const auto digest_set_initial_capacity = size_t{1024};
+
+} // namespace
+
+auto digest(const TestCase& tc) -> TestCaseDigest
+{
+    auto hasher = Murmur3Hasher{};
+    const auto& elems = tc.get_elements();
+
+    // Mirrors crete::write(os, elems) so equal digests <=> equal serialized test cases.
+    uint32_t elem_count = elems.size();
+    hasher.update(&elem_count, sizeof(elem_count));
+
+    for(const auto& elem : elems)
+    {
+        hasher.update(&elem.name_size, sizeof(elem.name_size));
+        hasher.update(elem.name.data(), elem.name.size());
+        hasher.update(&elem.data_size, sizeof(elem.data_size));
+        hasher.update(elem.data.data(), elem.data.size());
+    }
+
+    auto d = hasher.finalize();
+
+    if(d.lo == 0 && d.hi == 0) // Reserved as TestDigestSet's empty marker.
+    {
+        d.hi = 1;
+    }
+
+    return d;
+}
+
+TestDigestSet::TestDigestSet()
+    : slots_(digest_set_initial_capacity)
+{
+}
+
+auto TestDigestSet::insert(const TestCaseDigest& d) -> bool
+{
+    assert(d != TestCaseDigest{});
+
+    if((size_ + 1) * 2 > slots_.size()) // Keep load factor <= 0.5.
+    {
+        rehash(slots_.size() * 2);
+    }
+
+    auto& slot = slots_[find_slot(d)];
+
+    if(slot == d)
+    {
+        return false;
+    }
+
+    slot = d;
+    ++size_;
+
+    return true;
+}
+
+auto TestDigestSet::contains(const TestCaseDigest& d) const -> bool
+{
+    return slots_[find_slot(d)] == d;
+}
+
+auto TestDigestSet::reserve(size_t count) -> void
+{
+    auto capacity = slots_.size();
+
+    while(count * 2 > capacity)
+    {
+        capacity *= 2;
+    }
+
+    if(capacity != slots_.size())
+    {
+        rehash(capacity);
+    }
+}
+
+auto TestDigestSet::size() const -> size_t
+{
+    return size_;
+}
+
+auto TestDigestSet::clear() -> void
+{
+    slots_.assign(digest_set_initial_capacity, TestCaseDigest{});
+    size_ = 0;
+}
+
+// Returns the slot holding 'd', or the empty slot where 'd' belongs.
+auto TestDigestSet::find_slot(const TestCaseDigest& d) const -> size_t
+{
+    const auto mask = slots_.size() - 1; // Capacity is always a power of 2.
+    const auto empty = TestCaseDigest{};
+
+    auto i = static_cast<size_t>(d.lo) & mask;
+
+    while(slots_[i] != empty && slots_[i] != d)
+    {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+auto TestDigestSet::rehash(size_t capacity) -> void
+{
+    auto old = std::vector<TestCaseDigest>(capacity);
+    const auto empty = TestCaseDigest{};
+
+    old.swap(slots_);
+
+    for(const auto& d : old)
+    {
+        if(d != empty)
+        {
+            slots_[find_slot(d)] = d;
+        }
+    }
+}
+
+AsyncTestWriter::AsyncTestWriter(const fs::path& dir,
+                                 size_t capacity)
+    : pack_{dir}
+    , capacity_{capacity}
+{
+    thread_ = boost::thread{[this] { run(); }};
+}
+
+AsyncTestWriter::~AsyncTestWriter()
+{
+    {
+        boost::lock_guard<boost::mutex> lock{mutex_};
+        stop_ = true;
+    }
+
+    not_empty_.notify_one();
+
+    thread_.join();
+}
+
+auto AsyncTestWriter::push(const TestCase& tc) -> void
+{
+    boost::unique_lock<boost::mutex> lock{mutex_};
+
+    rethrow_if_failed();
+
+    while(queue_.size() >= capacity_ && !eptr_)
+    {
+        not_full_.wait(lock);
+    }
+
+    rethrow_if_failed();
+
+    queue_.push_back(tc);
+
+    not_empty_.notify_one();
+}
+
+auto AsyncTestWriter::flush() -> void
+{
+    boost::unique_lock<boost::mutex> lock{mutex_};
+
+    while((!queue_.empty() || in_flight_ != 0) && !eptr_)
+    {
+        drained_.wait(lock);
+    }
+
+    rethrow_if_failed();
+}
+
+auto AsyncTestWriter::run() -> void
+{
+    auto batch = std::deque<TestCase>{};
+
+    while(true)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock{mutex_};
+
+            while(queue_.empty() && !stop_)
+            {
+                not_empty_.wait(lock);
+            }
+
+            if(queue_.empty()) // Stopped and drained.
+            {
+                return;
+            }
+
+            batch.swap(queue_);
+            in_flight_ = batch.size();
+        }
+
+        not_full_.notify_all();
+
+        try
+        {
+            for(const auto& tc : batch)
+            {
+                pack_.append(tc);
+            }
+
+            pack_.sync();
+        }
+        catch(...)
+        {
+            boost::lock_guard<boost::mutex> lock{mutex_};
+
+            eptr_ = std::current_exception();
+            in_flight_ = 0;
+            queue_.clear();
+
+            not_full_.notify_all();
+            drained_.notify_all();
+
+            return;
+        }
+
+        batch.clear();
+
+        {
+            boost::lock_guard<boost::mutex> lock{mutex_};
+            in_flight_ = 0;
+        }
+
+        drained_.notify_all();
+    }
+}
+
+// Must be called with mutex_ held.
+auto AsyncTestWriter::rethrow_if_failed() -> void
+{
+    if(eptr_)
+    {
+        std::rethrow_exception(eptr_);
+    }
+}
+
 TestPool::TestPool(const fs::path& root)
     : random_engine_{std::time(0)}
     , root_{root}
@@ -51,9 +408,8 @@ auto TestPool::next() -> boost::optional<TestCase>
 
 auto TestPool::insert(const TestCase& tc) -> bool
 {
-    if(all_.find(tc) == all_.end()) // TODO: inefficient. Rather, if(all_.insert(*it).second) { next_.insert(*it); ... }
+    if(all_.insert(digest(tc)))
     {
-        all_.insert(tc);
         next_.push_front(tc);
 
         write_test_case(tc);
@@ -66,39 +422,68 @@ auto TestPool::insert(const TestCase& tc) -> bool
 
 auto TestPool::insert(const std::vector<TestCase>& tcs) -> void
 {
+    all_.reserve(all_.size() + tcs.size());
+
     for(const auto& tc : tcs)
     {
         insert(tc);
     }
 }
 
-auto TestPool::clear() -> void
+auto TestPool::insert(std::vector<TestCase>&& tcs) -> void
 {
-    next_.clear();
-    all_.clear();
+    admit(std::move(tcs), true);
 }
 
-auto TestPool::write_test_case(const TestCase& tc) -> void
+auto TestPool::replay_insert(std::vector<TestCase>&& tcs) -> void
 {
-    namespace fs = boost::filesystem;
+    admit(std::move(tcs), false);
+}
+
+auto TestPool::admit(std::vector<TestCase>&& tcs,
+                     bool write) -> void
+{
+    all_.reserve(all_.size() + tcs.size());
 
-    auto tc_root = root_ / "test-case";
+    for(auto& tc : tcs)
+    {
+        if(all_.insert(digest(tc)))
+        {
+            if(write)
+            {
+                write_test_case(tc);
+            }
 
-    if(!fs::exists(tc_root))
-        fs::create_directories(tc_root);
+            next_.push_front(std::move(tc));
+        }
+    }
 
-    auto name = std::to_string(all_.size());
-    auto path = tc_root / name;
+    tcs.clear();
+}
 
-    fs::ofstream ofs(path,
-                     std::ios_base::out | std::ios_base::binary);
+auto TestPool::clear() -> void
+{
+    next_.clear();
+    all_.clear();
+}
 
-    if(!ofs.good())
+auto TestPool::write_test_case(const TestCase& tc) -> void
+{
+    if(!writer_)
     {
-        BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{path.string()});
+        writer_ = std::make_shared<AsyncTestWriter>(root_ / "test-case",
+                                                    test_writer_queue_capacity);
     }
 
-    tc.write(ofs);
+    writer_->push(tc);
+}
+
+auto TestPool::flush() -> void
+{
+    if(writer_)
+    {
+        writer_->flush();
+    }
 }
 
 auto TestPool::count_all() const -> size_t
@@ -111,14 +496,5 @@ auto TestPool::count_next() const -> size_t
     return next_.size();
 }
 
-bool TestCaseSetCompare::operator()(const crete::TestCase &rhs, const crete::TestCase &lhs)
-{
-    std::stringstream ssr, ssl;
-    rhs.write(ssr);
-    lhs.write(ssl);
-
-    return ssr.str() < ssl.str();
-}
-
 } // namespace cluster
 } // namespace crete
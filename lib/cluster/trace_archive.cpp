@@ -0,0 +1,474 @@
+#include <crete/cluster/trace_archive.h>
+#include <crete/exception.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace fs = boost::filesystem;
+
+namespace crete
+{
+namespace cluster
+{
+
+namespace
+{
+
+const char trace_archive_magic[4] = {'C', 'R', 'T', 'A'};
+const auto trace_archive_version = uint8_t{1};
+
+enum class EntryType : uint8_t
+{
+    end = 0,
+    directory = 1,
+    file = 2,
+    symlink = 3
+};
+
+template <typename T>
+auto put(std::vector<uint8_t>& out, const T& v) -> void
+{
+    auto p = reinterpret_cast<const uint8_t*>(&v);
+
+    out.insert(out.end(), p, p + sizeof(v));
+}
+
+auto put(std::vector<uint8_t>& out, const std::string& s) -> void
+{
+    put(out, static_cast<uint32_t>(s.size()));
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+class ArchiveReader
+{
+public:
+    ArchiveReader(const std::vector<uint8_t>& data) : data_(data) {}
+
+    template <typename T>
+    auto get() -> T
+    {
+        auto v = T{};
+
+        std::memcpy(&v, bytes(sizeof(v)), sizeof(v));
+
+        return v;
+    }
+
+    auto get_string() -> std::string
+    {
+        auto size = get<uint32_t>();
+        auto p = bytes(size);
+
+        return std::string(p, p + size);
+    }
+
+    auto bytes(size_t size) -> const uint8_t*
+    {
+        if(size > data_.size() - pos_)
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::parse{"trace archive truncated"});
+        }
+
+        auto p = data_.data() + pos_;
+        pos_ += size;
+
+        return p;
+    }
+
+    auto data() const -> const std::vector<uint8_t>& { return data_; }
+
+private:
+    const std::vector<uint8_t>& data_;
+    size_t pos_ = 0;
+};
+
+auto relative_to(const fs::path& base, const fs::path& p) -> fs::path
+{
+    auto it = p.begin();
+
+    for(auto b = base.begin(); b != base.end() && it != p.end(); ++b, ++it);
+
+    auto rel = fs::path{};
+
+    for(; it != p.end(); ++it)
+    {
+        rel /= *it;
+    }
+
+    return rel;
+}
+
+// Rejects entries that would land outside the extraction directory.
+auto checked_entry_path(const fs::path& dir, const std::string& s) -> fs::path
+{
+    auto rel = fs::path{s};
+
+    if(s.empty() || rel.is_absolute())
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::parse{"invalid trace archive entry: " + s});
+    }
+
+    for(const auto& c : rel)
+    {
+        if(c == "..")
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::parse{"invalid trace archive entry: " + s});
+        }
+    }
+
+    return dir / rel;
+}
+
+auto archive_file(const fs::path& p,
+                  TraceCompression compression,
+                  std::vector<uint8_t>& out) -> void
+{
+    fs::ifstream ifs{p, std::ios_base::in | std::ios_base::binary};
+
+    if(!ifs.good())
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{p.string()});
+    }
+
+    auto remaining = static_cast<uint64_t>(fs::file_size(p));
+    auto block = std::vector<uint8_t>{};
+
+    put(out, remaining);
+
+    while(remaining > 0)
+    {
+        auto raw_size = static_cast<uint32_t>(std::min<uint64_t>(remaining, trace_archive_block_size));
+
+        put(out, raw_size);
+        auto stored_pos = out.size();
+        put(out, raw_size);
+
+        if(compression == TraceCompression::none)
+        {
+            // Read straight into the archive.
+            out.resize(out.size() + raw_size);
+            ifs.read(reinterpret_cast<char*>(out.data() + out.size() - raw_size), raw_size);
+        }
+        else
+        {
+            block.resize(raw_size);
+            ifs.read(reinterpret_cast<char*>(block.data()), raw_size);
+        }
+
+        if(static_cast<uint32_t>(ifs.gcount()) != raw_size)
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::file{"short read: " + p.string()});
+        }
+
+        if(compression == TraceCompression::lz)
+        {
+            auto data_pos = out.size();
+
+            lz_compress(block.data(), raw_size, out);
+
+            auto stored_size = out.size() - data_pos;
+
+            if(stored_size >= raw_size) // Incompressible: keep raw.
+            {
+                out.resize(data_pos);
+                out.insert(out.end(), block.begin(), block.end());
+            }
+            else
+            {
+                auto s = static_cast<uint32_t>(stored_size);
+                std::memcpy(out.data() + stored_pos, &s, sizeof(s));
+            }
+        }
+
+        remaining -= raw_size;
+    }
+}
+
+// Calls 'sink' with each block of the file, decompressed.
+auto read_file(ArchiveReader& reader,
+               const std::string& name,
+               const std::function<void(const uint8_t*, uint32_t)>& sink) -> void
+{
+    auto remaining = reader.get<uint64_t>();
+    auto block = std::vector<uint8_t>{};
+
+    while(remaining > 0)
+    {
+        auto raw_size = reader.get<uint32_t>();
+        auto stored_size = reader.get<uint32_t>();
+        auto stored = reader.bytes(stored_size);
+
+        if(raw_size == 0 || raw_size > remaining)
+        {
+            BOOST_THROW_EXCEPTION(Exception{} << err::parse{"corrupt trace archive block: " + name});
+        }
+
+        if(stored_size == raw_size)
+        {
+            sink(stored, raw_size);
+        }
+        else
+        {
+            block.resize(raw_size);
+
+            if(!lz_decompress(stored, stored_size, block.data(), raw_size))
+            {
+                BOOST_THROW_EXCEPTION(Exception{} << err::parse{"corrupt trace archive block: " + name});
+            }
+
+            sink(block.data(), raw_size);
+        }
+
+        remaining -= raw_size;
+    }
+}
+
+auto extract_file(ArchiveReader& reader,
+                  const fs::path& p) -> void
+{
+    fs::ofstream ofs{p, std::ios_base::out | std::ios_base::binary};
+
+    if(!ofs.good())
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::file_open_failed{p.string()});
+    }
+
+    read_file(reader,
+              p.string(),
+              [&ofs](const uint8_t* data, uint32_t size) { ofs.write(reinterpret_cast<const char*>(data), size); });
+
+    if(!ofs.good())
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::file{"write failed: " + p.string()});
+    }
+}
+
+auto skip_entry(EntryType type,
+                ArchiveReader& reader) -> void
+{
+    switch(type)
+    {
+    case EntryType::directory:
+        reader.get<uint32_t>();
+        break;
+    case EntryType::file:
+    {
+        reader.get<uint32_t>();
+
+        auto remaining = reader.get<uint64_t>();
+
+        while(remaining > 0)
+        {
+            auto raw_size = reader.get<uint32_t>();
+            auto stored_size = reader.get<uint32_t>();
+
+            if(raw_size == 0 || raw_size > remaining)
+            {
+                BOOST_THROW_EXCEPTION(Exception{} << err::parse{"corrupt trace archive block"});
+            }
+
+            reader.bytes(stored_size);
+            remaining -= raw_size;
+        }
+        break;
+    }
+    case EntryType::symlink:
+        reader.get_string();
+        break;
+    default:
+        BOOST_THROW_EXCEPTION(Exception{} << err::parse{"unknown trace archive entry type"});
+    }
+}
+
+auto read_header(ArchiveReader& reader) -> void
+{
+    if(!is_trace_archive(reader.data()))
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::parse{"not a trace archive"});
+    }
+
+    reader.bytes(sizeof(trace_archive_magic));
+
+    if(reader.get<uint8_t>() != trace_archive_version)
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::parse{"unsupported trace archive version"});
+    }
+
+    reader.get<uint8_t>(); // Compression; informational, as every block records whether it is compressed.
+}
+
+} // namespace
+
+auto archive_directory(const fs::path& dir,
+                       TraceCompression compression) -> std::vector<uint8_t>
+{
+    if(!fs::is_directory(dir))
+    {
+        BOOST_THROW_EXCEPTION(Exception{} << err::file_missing{dir.string()});
+    }
+
+    auto base = dir;
+
+    if(base.filename() == ".") // Trailing separator.
+    {
+        base = base.parent_path();
+    }
+
+    auto out = std::vector<uint8_t>{};
+
+    out.insert(out.end(), trace_archive_magic, trace_archive_magic + sizeof(trace_archive_magic));
+    put(out, trace_archive_version);
+    put(out, static_cast<uint8_t>(compression));
+
+    for(fs::recursive_directory_iterator it{base}, end; it != end; ++it)
+    {
+        const auto& p = it->path();
+        auto status = fs::symlink_status(p);
+        auto rel = relative_to(base, p).generic_string();
+
+        if(fs::is_symlink(status))
+        {
+            put(out, EntryType::symlink);
+            put(out, rel);
+            put(out, fs::read_symlink(p).string());
+        }
+        else if(fs::is_directory(status))
+        {
+            put(out, EntryType::directory);
+            put(out, rel);
+            put(out, static_cast<uint32_t>(status.permissions()));
+        }
+        else if(fs::is_regular_file(status))
+        {
+            put(out, EntryType::file);
+            put(out, rel);
+            put(out, static_cast<uint32_t>(status.permissions()));
+
+            archive_file(p, compression, out);
+        }
+    }
+
+    put(out, EntryType::end);
+
+    return out;
+}
+
+auto extract_archive(const std::vector<uint8_t>& archive,
+                     const fs::path& dir) -> void
+{
+    extract_archive(archive,
+                    dir,
+                    [](const std::string&) { return true; });
+}
+
+auto extract_archive(const std::vector<uint8_t>& archive,
+                     const fs::path& dir,
+                     const std::function<bool(const std::string&)>& filter) -> void
+{
+    auto reader = ArchiveReader{archive};
+
+    read_header(reader);
+
+    fs::create_directories(dir);
+
+    // Applied last, so a read-only directory can still be populated.
+    auto dir_perms = std::vector<std::pair<fs::path, fs::perms>>{};
+
+    while(true)
+    {
+        auto type = reader.get<EntryType>();
+
+        if(type == EntryType::end)
+        {
+            break;
+        }
+
+        auto rel = reader.get_string();
+        auto p = checked_entry_path(dir, rel);
+
+        if(!filter(rel))
+        {
+            skip_entry(type, reader);
+            continue;
+        }
+
+        switch(type)
+        {
+        case EntryType::directory:
+            fs::create_directories(p);
+            dir_perms.emplace_back(p, static_cast<fs::perms>(reader.get<uint32_t>()));
+            break;
+        case EntryType::file:
+        {
+            auto perms = static_cast<fs::perms>(reader.get<uint32_t>());
+
+            fs::create_directories(p.parent_path()); // In case its directory entry was filtered out.
+            extract_file(reader, p);
+            fs::permissions(p, perms);
+            break;
+        }
+        case EntryType::symlink:
+            fs::create_symlink(reader.get_string(), p);
+            break;
+        default:
+            BOOST_THROW_EXCEPTION(Exception{} << err::parse{"unknown trace archive entry type"});
+        }
+    }
+
+    for(auto it = dir_perms.rbegin(); it != dir_perms.rend(); ++it)
+    {
+        fs::permissions(it->first, it->second);
+    }
+}
+
+auto read_archive_file(const std::vector<uint8_t>& archive,
+                       const std::string& entry) -> boost::optional<std::vector<uint8_t>>
+{
+    auto reader = ArchiveReader{archive};
+
+    read_header(reader);
+
+    while(true)
+    {
+        auto type = reader.get<EntryType>();
+
+        if(type == EntryType::end)
+        {
+            return boost::optional<std::vector<uint8_t>>{};
+        }
+
+        auto rel = reader.get_string();
+
+        if(type != EntryType::file || rel != entry)
+        {
+            skip_entry(type, reader);
+            continue;
+        }
+
+        reader.get<uint32_t>(); // Permissions.
+
+        auto content = std::vector<uint8_t>{};
+
+        read_file(reader,
+                  entry,
+                  [&content](const uint8_t* data, uint32_t size) { content.insert(content.end(), data, data + size); });
+
+        return content;
+    }
+}
+
+auto is_trace_archive(const std::vector<uint8_t>& data) -> bool
+{
+    return data.size() >= sizeof(trace_archive_magic)
+           && std::equal(trace_archive_magic,
+                         trace_archive_magic + sizeof(trace_archive_magic),
+                         data.begin());
+}
+
+} // namespace cluster
+} // namespace crete
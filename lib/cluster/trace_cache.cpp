@@ -0,0 +1,86 @@
+#include <crete/cluster/trace_cache.h>
+
+namespace fs = boost::filesystem;
+
+namespace crete
+{
+namespace cluster
+{
+
+TraceCache::TraceCache(uint64_t capacity)
+    : capacity_{capacity}
+{
+}
+
+auto TraceCache::insert(const fs::path& p,
+                        Trace trace) -> Entries
+{
+    auto evicted = Entries{};
+
+    take(p); // Replace, rather than duplicate, an existing entry.
+
+    size_ += trace.data_.size();
+    lru_.emplace_front(p, std::move(trace));
+    index_[p.string()] = lru_.begin();
+
+    while(size_ > capacity_ && !lru_.empty())
+    {
+        auto& victim = lru_.back();
+
+        size_ -= victim.second.data_.size();
+        index_.erase(victim.first.string());
+        evicted.emplace_back(std::move(victim));
+
+        lru_.pop_back();
+    }
+
+    return evicted;
+}
+
+auto TraceCache::take(const fs::path& p) -> boost::optional<Trace>
+{
+    auto it = index_.find(p.string());
+
+    if(it == index_.end())
+    {
+        return boost::optional<Trace>{};
+    }
+
+    auto trace = boost::optional<Trace>{std::move(it->second->second)};
+
+    size_ -= trace->data_.size();
+    lru_.erase(it->second);
+    index_.erase(it);
+
+    return trace;
+}
+
+auto TraceCache::contains(const fs::path& p) const -> bool
+{
+    return index_.count(p.string()) != 0;
+}
+
+auto TraceCache::clear() -> void
+{
+    lru_.clear();
+    index_.clear();
+    size_ = 0;
+}
+
+auto TraceCache::count() const -> size_t
+{
+    return lru_.size();
+}
+
+auto TraceCache::size() const -> uint64_t
+{
+    return size_;
+}
+
+auto TraceCache::capacity() const -> uint64_t
+{
+    return capacity_;
+}
+
+} // namespace cluster
+} // namespace crete
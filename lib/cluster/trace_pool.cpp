@@ -13,6 +13,10 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
 #include <boost/random/variate_generator.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <exception>
 
 using namespace std;
 using namespace boost;
@@ -64,7 +68,12 @@ void TracePool::print_elf_info(const std::set<fs::path>& traces)
 
 void TracePool::print_elf_info(const filesystem::path& trace_path)
 {
-    fs::path bin_seq = trace_path / "tb-seq.bin";
+    print_elf_info(trace_path, trace_analyzer_.view(trace_path));
+}
+
+void TracePool::print_elf_info(const filesystem::path& trace_path,
+                               const TraceViewCache::View& trace)
+{
     fs::path elf_seq = trace_path / "tb-seq-elf.txt";
 
     fs::path pm_path = "guest-data/proc_maps.log";
@@ -77,7 +86,7 @@ void TracePool::print_elf_info(const filesystem::path& trace_path)
     ProcReader pr(pm_path);
     ProcMaps pms = condense(pr.find_all());
 
-    Trace trace = parse_trace(bin_seq);
+    fs::create_directories(trace_path); // The trace itself may only be in memory so far.
 
     fs::ofstream ofs(elf_seq);
 
@@ -87,11 +96,9 @@ void TracePool::print_elf_info(const filesystem::path& trace_path)
     if(!ofs.good())
         throw std::runtime_error("failed to open file: " + elf_seq.string());
 
-    const Trace::Blocks& blocks = trace.get_blocks();
-
     size_t block_counter = 0;
-    for(Trace::Blocks::const_iterator it = blocks.begin();
-        it != blocks.end();
+    for(TraceView::const_iterator it = trace->begin();
+        it != trace->end();
         ++it)
     {
         const Trace::Block& block = *it;
@@ -166,16 +173,55 @@ void TracePool::print_elf_info(const filesystem::path& trace_path)
 
 auto TracePool::insert(const TracePath& trace) -> bool
 {
-    all_.insert(trace);
+    return insert(TracePaths{trace}).front();
+}
+
+auto TracePool::insert(const TracePaths& traces) -> std::vector<bool>
+{
+    return insert(traces, TraceViews{});
+}
+
+auto TracePool::insert(const TracePaths& traces,
+                       const TraceViews& views) -> std::vector<bool>
+{
+    assert(views.empty() || views.size() == traces.size());
 
-    if(options_.trace.print_elf_info)
+    auto inserted = std::vector<bool>(traces.size(), false);
+    auto prepared = std::vector<TraceAnalyzer::Prepared>(traces.size());
+
+    if(options_.trace.filter_traces)
     {
-        print_elf_info(trace);
+        prepared = prepare(traces, views);
+    }
+
+    // Merging is serial, and in arrival order, so selection doesn't depend on which worker finished first.
+    for(auto i = 0u; i < traces.size(); ++i)
+    {
+        if(options_.trace.print_elf_info)
+        {
+            print_elf_info(traces[i],
+                           views.empty() ? TraceViewCache::open(traces[i]) : views[i]);
+        }
+
+        inserted[i] = commit(traces[i], prepared[i]);
+
+        for(auto& cb : commit_cbs_)
+        {
+            cb(traces[i], prepared[i]);
+        }
     }
 
+    return inserted;
+}
+
+auto TracePool::commit(const TracePath& trace,
+                       const TraceAnalyzer::Prepared& prepared) -> bool
+{
+    all_.insert(trace);
+
     if(options_.trace.filter_traces)
     {
-        if(trace_analyzer_.insert_trace(trace))
+        if(trace_analyzer_.commit_trace(trace, prepared))
         {
             all_unique_.insert(trace);
             next_.insert(trace);
@@ -187,6 +233,60 @@ auto TracePool::insert(const TracePath& trace) -> bool
     return false;
 }
 
+auto TracePool::prepare(const TracePaths& traces,
+                        const TraceViews& views) const -> std::vector<TraceAnalyzer::Prepared>
+{
+    auto prepared = std::vector<TraceAnalyzer::Prepared>(traces.size());
+    auto errors = std::vector<std::exception_ptr>(traces.size());
+    std::atomic<size_t> next{0};
+
+    auto work = [&]
+    {
+        for(auto i = next++; i < traces.size(); i = next++)
+        {
+            try
+            {
+                prepared[i] = views.empty()
+                        ? trace_analyzer_.prepare_trace(traces[i])
+                        : trace_analyzer_.prepare_trace(traces[i], views[i]);
+            }
+            catch(...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    auto worker_count = std::min<size_t>(std::max(boost::thread::hardware_concurrency(), 1u),
+                                         traces.size());
+
+    if(worker_count <= 1)
+    {
+        work();
+    }
+    else
+    {
+        boost::thread_group workers;
+
+        for(auto i = 0u; i < worker_count; ++i)
+        {
+            workers.create_thread(work);
+        }
+
+        workers.join_all();
+    }
+
+    for(const auto& e : errors)
+    {
+        if(e)
+        {
+            std::rethrow_exception(e);
+        }
+    }
+
+    return prepared;
+}
+
 auto TracePool::next() -> optional<TracePool::TracePath>
 {
     optional<TracePath> trace;
@@ -219,7 +319,7 @@ auto TracePool::next() -> optional<TracePool::TracePath>
 
     if(trace)
     {
-        trace_analyzer_.submit_executed(parse_trace((*trace)/"tb-seq.bin"));
+        trace_analyzer_.submit_executed(*trace);
     }
 
     if(options_.trace.print_trace_selection)
@@ -276,5 +376,35 @@ void TracePool::set_selection_strategy(const string& strat)
     trace_analyzer_.set_selection_strategy(strat);
 }
 
+auto TracePool::commit_callback(CommitCallback cb) -> void
+{
+    commit_cbs_.push_back(cb);
+}
+
+auto TracePool::replay_insert(const TracePath& trace,
+                              const TraceAnalyzer::Prepared& prepared) -> bool
+{
+    return commit(trace, prepared);
+}
+
+auto TracePool::replay_next(const TracePath& trace) -> void
+{
+    next_.erase(trace);
+
+    trace_analyzer_.resubmit_executed(trace);
+}
+
+auto TracePool::withdraw(const TracePath& trace) -> void
+{
+    next_.erase(trace);
+
+    trace_analyzer_.withdraw(trace);
+}
+
+auto TracePool::pending() const -> const TracePathSet&
+{
+    return next_;
+}
+
 } // namespace cluster
 } // namespace crete
@@ -415,6 +415,8 @@ auto receive_target(AtomicGuard<VMNode>& node,
 auto VMNode::add_instance() -> void
 {
     vms_.emplace_back(std::make_shared<node::vm::fsm::QemuFSM>());
+
+    instance_count(vms_.size());
 }
 
 auto VMNode::add_instances(size_t count) -> void
@@ -3,6 +3,8 @@
 #include <crete/cluster/dispatch_options.h>
 #include <crete/cluster/vm_node_options.h>
 #include <crete/exception.h>
+#include <crete/trace_container.h>
+#include <crete/trace_channel.h>
 #include <crete/process.h>
 #include <crete/asio/server.h>
 #include <crete/run_config.h>
@@ -262,6 +264,7 @@ private:
     std::shared_ptr<Trace> trace_{std::make_shared<Trace>()}; // To be read when is_flag_active<trace_ready>() == true.
     std::shared_ptr<AtomicGuard<bp::child>> child_{std::make_shared<AtomicGuard<bp::child>>(-1, bp::detail::file_handle(), bp::detail::file_handle(), bp::detail::file_handle())};
     std::shared_ptr<Server> server_{std::make_shared<Server>()}; // Ctor acquires unique port.
+    std::shared_ptr<TraceChannel> trace_channel_{std::make_shared<TraceChannel>()}; // Unconnected: QEMU has none, so hostfile/ is used.
     bool first_vm_{false};
     config::RunConfiguration guest_config_;
     TestCase initial_test_;
@@ -538,6 +541,8 @@ struct QemuFSM_::Testing : public msm::front::state<>
     void on_entry(Event const& ,FSM&) {std::cout << "entering: Testing" << std::endl;}
     template <class Event,class FSM>
     void on_exit(Event const&,FSM& ) {std::cout << "leaving: Testing" << std::endl;}
+
+    std::unique_ptr<AsyncTask> async_task_{new AsyncTask{}};
 };
 struct QemuFSM_::StoreTrace : public msm::front::state<>
 {
@@ -777,8 +782,44 @@ struct QemuFSM_::start_vm
 struct QemuFSM_::start_test
 {
     template <class EVT,class FSM,class SourceState,class TargetState>
-    auto operator()(EVT const& ev, FSM& fsm, SourceState&, TargetState&) -> void
+    auto operator()(EVT const& ev, FSM& fsm, SourceState&, TargetState& ts) -> void
     {
+        if(fsm.trace_channel_->is_connected())
+        {
+            try
+            {
+                fsm.server_->write(0,
+                                   packet_type::cluster_next_test);
+            }
+            catch(std::exception& e)
+            {
+                BOOST_THROW_EXCEPTION(VMException{} << err::msg{boost::diagnostic_information(e)});
+            }
+
+            std::ostringstream os{std::ios_base::out | std::ios_base::binary};
+
+            ev.tc_.write(os);
+
+            // QEMU reads the input once the test asks for it, after the guest has been told to start,
+            // so an input larger than the socket's buffer mustn't hold up the node until then.
+            ts.async_task_.reset(new AsyncTask{[](std::shared_ptr<TraceChannel> trace_channel,
+                                                  const std::string input)
+            {
+                try
+                {
+                    trace_channel->send(trace_channel_test_input, input);
+                }
+                catch(std::exception& e)
+                {
+                    BOOST_THROW_EXCEPTION(VMException{} << err::msg{boost::diagnostic_information(e)});
+                }
+            },
+            fsm.trace_channel_,
+            os.str()});
+
+            return;
+        }
+
         auto hostfile = fsm.vm_dir_ / hostfile_dir_name;
 
         if(!fs::exists(hostfile))
@@ -820,12 +861,13 @@ struct QemuFSM_::store_trace
     auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState& ts) -> void
     {
         ts.async_task_.reset(new AsyncTask{[](const fs::path vm_dir,
-                                              std::shared_ptr<Trace> trace)
+                                              std::shared_ptr<Trace> trace,
+                                              const bool trace_channel_connected)
         {
             auto trace_ready = vm_dir / hostfile_dir_name / trace_ready_name;
             auto trace_dir = vm_dir / trace_dir_name;
 
-            if(!fs::exists(trace_ready))
+            if(!trace_channel_connected && !fs::exists(trace_ready))
             {
                 BOOST_THROW_EXCEPTION(Exception{} << err::file_missing{trace_ready.string()});
             }
@@ -853,8 +895,11 @@ struct QemuFSM_::store_trace
 
             auto original_trace = *begin;
 
-            fs::copy_file(vm_dir / hostfile_dir_name / input_args_name,
-                          original_trace / "concrete_inputs.bin");
+            if(!fs::exists(original_trace / trace_container_file_name)) // Otherwise the container holds them already, as it always does with the channel.
+            {
+                fs::copy_file(vm_dir / hostfile_dir_name / input_args_name,
+                              original_trace / "concrete_inputs.bin");
+            }
 
             if(fs::exists("tb-ir.txt"))
             {
@@ -868,7 +913,7 @@ struct QemuFSM_::store_trace
 
             fs::remove(trace_ready);
 
-        }, fsm.vm_dir_, fsm.trace_});
+        }, fsm.vm_dir_, fsm.trace_, fsm.trace_channel_->is_connected()});
     }
 };
 
@@ -894,6 +939,7 @@ struct QemuFSM_::connect_vm
         }
 
         ts.async_task_.reset(new AsyncTask{[](std::shared_ptr<Server> server,
+                                              std::shared_ptr<TraceChannel> trace_channel,
                                               const fs::path vm_dir,
                                               const bool distributed,
                                               const std::string target)
@@ -921,6 +967,17 @@ struct QemuFSM_::connect_vm
             // I.e., next time crete-run attempts to connect.
             fs::remove(port_file_path);
 
+            // QEMU has listened since it started, so, once the guest is up, the channel is there - unless
+            // this QEMU predates it.
+            try
+            {
+                trace_channel->connect(vm_dir / hostfile_dir_name / trace_channel_file_name);
+            }
+            catch(std::exception& e)
+            {
+                std::cerr << "no trace channel, using " << hostfile_dir_name << "/: " << e.what() << std::endl;
+            }
+
             try
             {
                 auto pkinfo = PacketInfo{0,0,0};
@@ -959,6 +1016,7 @@ struct QemuFSM_::connect_vm
             //                           sbuf);
         },
         fsm.server_,
+        fsm.trace_channel_,
         fsm.vm_dir_,
         fsm.dispatch_options_.mode.distributed,
         fsm.target_});
@@ -1062,7 +1120,7 @@ struct QemuFSM_::is_vm_terminated
 struct QemuFSM_::is_finished
 {
     template <class EVT,class FSM,class SourceState,class TargetState>
-    auto operator()(EVT const&, FSM& fsm, SourceState&, TargetState&) -> bool
+    auto operator()(EVT const&, FSM& fsm, SourceState& ss, TargetState&) -> bool
     {
         auto pid = fsm.child_->acquire()->get_id();
 
@@ -1071,6 +1129,36 @@ struct QemuFSM_::is_finished
             BOOST_THROW_EXCEPTION(VMException{} << err::process_exited{"pid_"});
         }
 
+        if(ss.async_task_->is_exception_thrown())
+        {
+            ss.async_task_->rethrow_exception();
+        }
+
+        if(fsm.trace_channel_->is_connected())
+        {
+            auto type = uint32_t{0};
+            auto payload = std::string{};
+
+            try
+            {
+                if(!fsm.trace_channel_->receive(type, payload, 0))
+                {
+                    return false;
+                }
+            }
+            catch(std::exception& e)
+            {
+                BOOST_THROW_EXCEPTION(VMException{} << err::msg{boost::diagnostic_information(e)});
+            }
+
+            if(type != trace_channel_trace_ready)
+            {
+                BOOST_THROW_EXCEPTION(VMException{} << err::msg{"unexpected message on the trace channel"});
+            }
+
+            return true;
+        }
+
         auto trace_ready_sig = fsm.vm_dir_ / hostfile_dir_name / trace_ready_name;
 
         return fs::exists(trace_ready_sig);
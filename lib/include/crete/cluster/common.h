@@ -15,6 +15,7 @@
 
 #include <crete/asio/common.h>
 #include <crete/asio/client.h>
+#include <crete/cluster/trace_archive.h>
 
 namespace crete
 {
@@ -42,6 +43,7 @@ struct NodeStatus
     uint32_t trace_count = 0;
     uint32_t error_count = 0; // Reported errors from node. To be retrieved, as tcs and traces.
     bool active = true; // Designates whether the node is currently doing things, or just waiting.
+    uint32_t instance_count = 1; // VM or SVM instances consuming the node's queue.
 
     template <typename Archive>
     void serialize(Archive& ar, const unsigned int version)
@@ -53,6 +55,7 @@ struct NodeStatus
         ar & trace_count;
         ar & error_count;
         ar & active;
+        ar & instance_count;
     }
 };
 
@@ -116,7 +119,7 @@ inline auto operator!=(const ImageInfo& lhs, const ImageInfo& rhs) -> bool
 struct Trace
 {
     boost::uuids::uuid uuid_{{0}}; // Double brace for 'brace elision.'
-    std::vector<uint8_t> data_; // Note: may be compressed.
+    std::vector<uint8_t> data_; // Trace directory, packed by archive_directory().
 
     template <typename Archive>
     void serialize(Archive& ar, const unsigned int version)
@@ -128,7 +131,8 @@ struct Trace
     }
 };
 
-auto from_trace_file(const boost::filesystem::path& p) -> Trace;
+auto from_trace_file(const boost::filesystem::path& p,
+                     TraceCompression compression = TraceCompression::lz) -> Trace; // Consumes 'p'.
 auto to_file(const Trace& trace,
              const boost::filesystem::path& p) -> void;
 
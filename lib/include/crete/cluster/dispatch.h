@@ -15,6 +15,8 @@
 #include <crete/test_case.h>
 #include <crete/cluster/test_pool.h>
 #include <crete/cluster/trace_pool.h>
+#include <crete/cluster/trace_cache.h>
+#include <crete/cluster/flow_control.h>
 #include <crete/cluster/dispatch_options.h>
 
 namespace crete
@@ -31,8 +33,11 @@ const auto dispatch_log_vm_dir_name = std::string{"vm"};
 const auto dispatch_log_svm_dir_name = std::string{"svm"};
 const auto dispatch_node_error_log_file_name = std::string{"node_error.log"};
 const auto dispatch_last_root_symlink = std::string{"last"};
-const auto vm_test_multiplier = 20u;
-const auto vm_trace_multiplier = 20u;
+const auto dispatch_trace_seq_file_name = std::string{"tb-seq.bin"}; // The only part of a trace the trace pool reads. A section, in a trace container.
+const auto vm_test_multiplier = 20u; // Most tests queued on a VM node, per instance.
+const auto vm_trace_multiplier = 20u; // Most traces queued on an SVM node, per instance.
+const auto dispatch_status_interval_ms = 1000u; // Period of the status display and statistics, which run off the dispatch loop.
+const auto dispatch_idle_wait_ms = 100u; // Longest the dispatch loop sleeps while every node has an exchange in flight.
 
 namespace vm
 {
@@ -97,6 +102,7 @@ auto register_node_fsm(NodeRegistrar::Node& node,
                        AtomicGuard<std::vector<std::shared_ptr<vm::NodeFSM>>>& vm_node_fsms,
                        AtomicGuard<std::vector<std::shared_ptr<svm::NodeFSM>>>& svm_node_fsms) -> void;
 auto make_dispatch_root() -> boost::filesystem::path;
+auto read_trace_sequence(const Trace& trace) -> std::vector<uint8_t>; // tb-seq.bin of a received trace, loose or a section of its trace container. Reads nothing from disk.
 
 } // namespace cluster
 } // namespace crete
@@ -0,0 +1,78 @@
+#ifndef CRETE_CLUSTER_DISPATCH_JOURNAL_H
+#define CRETE_CLUSTER_DISPATCH_JOURNAL_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+namespace crete
+{
+namespace cluster
+{
+
+const auto dispatch_journal_file_name = std::string{"journal.bin"};
+const auto dispatch_snapshot_file_name = std::string{"snapshot.bin"};
+const auto dispatch_journal_snapshot_size = uint64_t{64u * 1024u * 1024u}; // Bytes journaled before the state is compacted into a snapshot.
+
+/**
+ * @brief Append-only journal of changes to the dispatch state, compacted now and then into a snapshot.
+ *
+ * The journal is a header - magic, version, and the sequence number of its first record - then
+ * records back to back: u32 payload size, u8 type, payload, u32 CRC-32 of type and payload. A record
+ * torn by a crash fails its CRC and ends recovery; it's truncated away, so appending resumes cleanly.
+ *
+ * The snapshot is magic, version, the sequence number of the first record it doesn't include, the
+ * state's size, the state, and its CRC-32. It's written beside the last, synced and renamed over it,
+ * then the journal is restarted. Records from before a crash in between are skipped by sequence.
+ *
+ * Payloads are opaque: the dispatcher decides what state and records hold.
+ */
+class DispatchJournal
+{
+public:
+    enum class Record : uint8_t
+    {
+        trace_inserted = 1,
+        trace_selected = 2,
+        tests_inserted = 3,
+        tests_taken = 4,
+        elapsed_time = 5
+    };
+
+    using Restore = std::function<void(const std::string& state)>;
+    using Replay = std::function<void(Record type, const std::string& payload)>;
+
+public:
+    DispatchJournal(const boost::filesystem::path& dir); // Appending without recover() first starts afresh, discarding whatever dir held.
+    ~DispatchJournal();
+
+    DispatchJournal(const DispatchJournal&) = delete;
+    auto operator=(const DispatchJournal&) -> DispatchJournal& = delete;
+
+    auto recover(const Restore& restore,
+                 const Replay& replay) -> bool; // Restores the snapshot, then replays the records after it. False if neither was found.
+    auto append(Record type,
+                const std::string& payload) -> void; // Buffered until sync().
+    auto sync() -> void; // Makes the appended records durable.
+    auto snapshot(const std::string& state) -> void; // State as of the last append(). Syncs first.
+    auto size() const -> uint64_t; // Bytes journaled since the last snapshot, including those buffered.
+
+private:
+    auto open() -> void; // Afresh.
+    auto restart(uint64_t first) -> void; // Replaces the journal with an empty one, starting at sequence number first.
+    auto read_snapshot(std::string& state) -> bool;
+
+private:
+    boost::filesystem::path dir_;
+    int fd_ = -1;
+    uint64_t next_ = 0; // Of the next record appended.
+    uint64_t size_ = 0; // Of the journal, on disk.
+    std::string buffer_;
+};
+
+} // namespace cluster
+} // namespace crete
+
+#endif // CRETE_CLUSTER_DISPATCH_JOURNAL_H
@@ -132,6 +132,7 @@ struct Trace
     bool print_graph_only_branches{false}; // TODO: Now redundant. We only dump 'branches.'
     bool print_elf_info{false};
     bool compress{false};
+    uint64_t cache_size{512u * 1024u * 1024u}; // Bytes of received traces dispatch keeps in memory.
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int version)
@@ -144,6 +145,7 @@ struct Trace
         ar & print_graph_only_branches;
         ar & print_elf_info;
         ar & compress;
+        ar & cache_size;
     }
 };
 
@@ -160,6 +162,19 @@ struct Profile
     }
 };
 
+struct Journal
+{
+    bool resume{false}; // Picks up the campaign under dispatch/last from its journal, rather than starting afresh.
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        (void)version;
+
+        ar & resume;
+    }
+};
+
 struct Dispatch
 {
     Mode mode;
@@ -168,6 +183,7 @@ struct Dispatch
     Test test;
     Trace trace;
     Profile profile;
+    Journal journal;
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int version)
@@ -180,6 +196,7 @@ struct Dispatch
         ar & test;
         ar & trace;
         ar & profile;
+        ar & journal;
     }
 };
 
@@ -0,0 +1,62 @@
+#ifndef CRETE_CLUSTER_FLOW_CONTROL_H
+#define CRETE_CLUSTER_FLOW_CONTROL_H
+
+#include <stdint.h>
+#include <chrono>
+
+namespace crete
+{
+namespace cluster
+{
+
+const auto flow_control_min_horizon = std::chrono::milliseconds{500};
+const auto flow_control_smoothing = 0.25; // Weight of the newest sample in the moving averages.
+
+/**
+ * @brief Credit-based flow control for the work items (tests or traces) dispatch queues on a node.
+ *
+ * Each observation of the node's queue length yields how many items it consumed since the last
+ * one, and so its service rate. The node is granted enough credits to keep each of its instances
+ * busy over the horizon - the time until it is likely to be refilled - without queueing so much
+ * that other nodes go without.
+ *
+ * Before the rate is known, every instance is given a single item.
+ *
+ * Each observation carries the sequence number of the status it was read from. Repeats of the
+ * last one are stale: they say nothing of what the node consumed since, so they are ignored.
+ */
+class FlowControl
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+public:
+    FlowControl(uint32_t max_per_instance); // Upper bound on the queue depth, per instance.
+
+    auto observe(uint64_t status_seq,
+                 uint32_t queued,
+                 uint32_t instances,
+                 Clock::time_point now = Clock::now()) -> void;
+    auto sent(uint32_t count) -> void;
+    auto credits() const -> uint32_t; // Items to send now.
+    auto horizon() const -> double; // In seconds.
+    auto rate() const -> double; // Items consumed per second, by all instances. 0 until measured.
+    auto service_time() const -> double; // Seconds per item, per instance. 0 until measured.
+    auto instances() const -> uint32_t;
+
+private:
+    uint32_t max_per_instance_;
+    uint32_t queued_ = 0;
+    uint32_t instances_ = 1;
+    uint32_t sent_ = 0; // Since the last observation.
+    bool observed_ = false;
+    uint64_t status_seq_ = 0; // Of the last observation.
+    Clock::time_point last_;
+    double rate_ = 0.0;
+    double interval_ = 0.0; // Between observations, in seconds.
+};
+
+} // namespace cluster
+} // namespace crete
+
+#endif // CRETE_CLUSTER_FLOW_CONTROL_H
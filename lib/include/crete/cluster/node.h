@@ -61,6 +61,7 @@ public:
     auto reset() -> void;
     auto active(bool p) -> void;
     auto is_active() -> bool;
+    auto instance_count(uint32_t count) -> void;
     auto master_options() const -> const option::Dispatch&;
     auto update(const option::Dispatch& options) -> void;
 
@@ -82,6 +83,7 @@ private:
     Type type_;
     bool commenced_{false};
     bool active_{true};
+    uint32_t instance_count_{1};
     option::Dispatch master_options_;
 };
 
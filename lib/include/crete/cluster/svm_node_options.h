@@ -28,6 +28,7 @@ struct Translator
         std::string x86;
         std::string x64;
     } path;
+    uint32_t jobs{1}; // Processes each translation is sharded across.
 };
 
 struct SVM
@@ -1,36 +1,163 @@
 #ifndef CRETE_TEST_POOL_H_
 #define CRETE_TEST_POOL_H_
 
-#include <set>
 #include <string>
 #include <vector>
 #include <deque>
 #include <stdint.h>
 #include <random>
+#include <memory>
+#include <exception>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/serialization/deque.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/vector.hpp>
 
 #include <crete/test_case.h>
+#include <crete/test_case_pack.h>
 
 namespace crete
 {
 namespace cluster
 {
 
-// TODO: naive comparison function to ignore redundant test cases.
-// TODO: inefficient. Converts to string and compares the strings. It would be much faster to
-//       hash the test case once and store it in an unordered_set.
-struct TestCaseSetCompare
+/**
+ * @brief 128-bit content digest of a test case.
+ *
+ * Computed once per test case over its serialized form (the same bytes TestCase::write emits),
+ * so two test cases share a digest iff they would have serialized identically (modulo collisions,
+ * which are negligible at 128 bits).
+ *
+ * The all-zero digest is reserved as the empty slot marker of TestDigestSet; digest() never returns it.
+ */
+struct TestCaseDigest
 {
-    bool operator()(const crete::TestCase& rhs, const crete::TestCase& lhs);
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        (void)version;
+
+        ar & lo;
+        ar & hi;
+    }
+};
+
+inline auto operator==(const TestCaseDigest& lhs, const TestCaseDigest& rhs) -> bool
+{
+    return lhs.lo == rhs.lo && lhs.hi == rhs.hi;
+}
+
+inline auto operator!=(const TestCaseDigest& lhs, const TestCaseDigest& rhs) -> bool
+{
+    return !(lhs == rhs);
+}
+
+auto digest(const TestCase& tc) -> TestCaseDigest;
+
+/**
+ * @brief Open-addressing (linear probing) set of test case digests.
+ *
+ * Used to deduplicate test cases in O(1) expected time per insert. Digests are already
+ * uniformly distributed, so the low word is used directly as the probe start.
+ */
+class TestDigestSet
+{
+public:
+    TestDigestSet();
+
+    auto insert(const TestCaseDigest& d) -> bool; // Returns false if already present.
+    auto contains(const TestCaseDigest& d) const -> bool;
+    auto reserve(size_t count) -> void;
+    auto size() const -> size_t;
+    auto clear() -> void;
+
+    template <class Archive>
+    void save(Archive& ar, const unsigned int version) const;
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version);
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+private:
+    auto find_slot(const TestCaseDigest& d) const -> size_t;
+    auto rehash(size_t capacity) -> void;
+
+private:
+    std::vector<TestCaseDigest> slots_;
+    size_t size_ = 0;
+};
+
+template <class Archive>
+void TestDigestSet::save(Archive& ar, const unsigned int version) const
+{
+    (void)version;
+
+    auto size = uint64_t{size_};
+
+    ar & slots_; // As probed: no rehash on load.
+    ar & size;
+}
+
+template <class Archive>
+void TestDigestSet::load(Archive& ar, const unsigned int version)
+{
+    (void)version;
+
+    auto size = uint64_t{0};
+
+    ar & slots_;
+    ar & size;
+
+    size_ = size;
+}
+
+const auto test_writer_queue_capacity = size_t{4096};
+
+/**
+ * @brief Persists test cases to pack files (see TestCasePackWriter) on a background thread.
+ *
+ * push() only blocks while the queue is at capacity. The writer thread drains everything queued
+ * since its last pass as one batch, so the fdatasync() cost is shared by the whole batch.
+ * Errors raised by the writer thread are rethrown by the next push()/flush().
+ */
+class AsyncTestWriter
+{
+public:
+    AsyncTestWriter(const boost::filesystem::path& dir,
+                    size_t capacity);
+    ~AsyncTestWriter(); // Persists whatever is still queued.
+
+    auto push(const TestCase& tc) -> void;
+    auto flush() -> void; // Blocks until every pushed test case is durable.
+
+private:
+    auto run() -> void;
+    auto rethrow_if_failed() -> void;
+
+private:
+    TestCasePackWriter pack_;
+    size_t capacity_;
+    std::deque<TestCase> queue_;
+    size_t in_flight_ = 0; // Taken off the queue but not yet synced.
+    bool stop_ = false;
+    std::exception_ptr eptr_;
+    boost::mutex mutex_;
+    boost::condition_variable not_empty_;
+    boost::condition_variable not_full_;
+    boost::condition_variable drained_;
+    boost::thread thread_;
 };
 
 class TestPool
 {
 public:
     using TracePath = boost::filesystem::path;
-    using TestSet = std::set<crete::TestCase, TestCaseSetCompare>;
+    using TestSet = TestDigestSet;
     using TestQueue = std::deque<crete::TestCase>;
 
 public:
@@ -39,16 +166,33 @@ public:
     auto next() -> boost::optional<TestCase>;
     auto insert(const TestCase& tc) -> bool;
     auto insert(const std::vector<TestCase>& tcs) -> void;
+    auto insert(std::vector<TestCase>&& tcs) -> void; // Moves unique test cases into the queue.
+    auto replay_insert(std::vector<TestCase>&& tcs) -> void; // As above, for test cases written already.
     auto clear() -> void;
     auto count_all() const -> size_t;
     auto count_next() const -> size_t;
     auto write_test_case(const TestCase& tc) -> void;
+    auto flush() -> void; // Waits for written test cases to reach the disk.
+
+    // The dedup set and queue. Test cases are persisted on their own (see AsyncTestWriter).
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        (void)version;
+
+        ar & all_;
+        ar & next_;
+    }
 
 private:
+    auto admit(std::vector<TestCase>&& tcs,
+               bool write) -> void;
+
     TestSet all_;
     TestQueue next_;
     std::mt19937 random_engine_; // TODO: currently unused in favor of FIFO; however, should random be optional?
     boost::filesystem::path root_;
+    std::shared_ptr<AsyncTestWriter> writer_; // Created on first write.
 };
 
 } // namespace cluster
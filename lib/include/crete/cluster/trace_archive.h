@@ -0,0 +1,56 @@
+#ifndef CRETE_CLUSTER_TRACE_ARCHIVE_H
+#define CRETE_CLUSTER_TRACE_ARCHIVE_H
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <crete/lz.h>
+
+namespace crete
+{
+namespace cluster
+{
+
+/**
+ * In-process replacement for packing trace directories with tar.
+ *
+ * Layout (host byte order, like the rest of the trace files):
+ *   header: "CRTA", uint8 version, uint8 compression
+ *   entries, each: uint8 type, uint32 path size, path (relative to the archived directory), then
+ *     dir:     uint32 permissions
+ *     file:    uint32 permissions, uint64 size, blocks of {uint32 raw size, uint32 stored size, bytes}
+ *              (a block whose stored size equals its raw size is kept uncompressed)
+ *     symlink: uint32 target size, target
+ *   end: uint8 0
+ */
+enum class TraceCompression : uint8_t
+{
+    none = 0,
+    lz = 1 // See crete/lz.h.
+};
+
+const auto trace_archive_block_size = uint32_t{4u * 1024u * 1024u};
+
+auto archive_directory(const boost::filesystem::path& dir,
+                       TraceCompression compression) -> std::vector<uint8_t>;
+auto extract_archive(const std::vector<uint8_t>& archive,
+                     const boost::filesystem::path& dir) -> void; // Creates 'dir'.
+auto extract_archive(const std::vector<uint8_t>& archive,
+                     const boost::filesystem::path& dir,
+                     const std::function<bool(const std::string&)>& filter) -> void; // Only entries whose relative path passes 'filter'.
+auto read_archive_file(const std::vector<uint8_t>& archive,
+                       const std::string& entry) -> boost::optional<std::vector<uint8_t>>; // The file's content, without touching the disk. None if there's no such file.
+auto is_trace_archive(const std::vector<uint8_t>& data) -> bool;
+
+using crete::lz_compress;
+using crete::lz_decompress;
+
+} // namespace cluster
+} // namespace crete
+
+#endif // CRETE_CLUSTER_TRACE_ARCHIVE_H
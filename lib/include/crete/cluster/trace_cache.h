@@ -0,0 +1,56 @@
+#ifndef CRETE_CLUSTER_TRACE_CACHE_H
+#define CRETE_CLUSTER_TRACE_CACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <crete/cluster/common.h>
+
+namespace crete
+{
+namespace cluster
+{
+
+/**
+ * @brief Size-bounded, in-memory store of received traces, keyed by their trace pool path.
+ *
+ * Lets dispatch forward a trace to an SVM node straight from memory. When the cached archives
+ * exceed the capacity, the least recently inserted ones are handed back to the caller to be
+ * written to disk.
+ */
+class TraceCache
+{
+public:
+    using Entry = std::pair<boost::filesystem::path, Trace>;
+    using Entries = std::vector<Entry>;
+
+public:
+    TraceCache(uint64_t capacity); // In bytes of Trace::data_.
+
+    auto insert(const boost::filesystem::path& p,
+                Trace trace) -> Entries; // Returns what was evicted to make room, possibly 'trace' itself.
+    auto take(const boost::filesystem::path& p) -> boost::optional<Trace>;
+    auto contains(const boost::filesystem::path& p) const -> bool;
+    auto clear() -> void;
+    auto count() const -> size_t;
+    auto size() const -> uint64_t; // In bytes.
+    auto capacity() const -> uint64_t;
+
+private:
+    using LRU = std::list<Entry>; // Front is most recent.
+
+    LRU lru_;
+    std::unordered_map<std::string, LRU::iterator> index_;
+    uint64_t capacity_;
+    uint64_t size_ = 0;
+};
+
+} // namespace cluster
+} // namespace crete
+
+#endif // CRETE_CLUSTER_TRACE_CACHE_H
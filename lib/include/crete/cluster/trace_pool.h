@@ -2,6 +2,7 @@
 #define CRETE_TRACE_POOL_H
 
 #include <set>
+#include <functional>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/property_tree/ptree.hpp>
@@ -22,12 +23,18 @@ namespace cluster
     public:
         using TracePath = boost::filesystem::path;
         using TracePathSet = std::set<TracePath>;
+        using TracePaths = std::vector<TracePath>;
+        using TraceViews = std::vector<TraceViewCache::View>;
+        using CommitCallback = std::function<void(const TracePath&, const TraceAnalyzer::Prepared&)>;
 
     public:
         TracePool(const option::Dispatch& options,
                   const std::string& selection_strat);
 
         auto insert(const TracePath& tace) -> bool;
+        auto insert(const TracePaths& traces) -> std::vector<bool>; // Analyzes the traces concurrently, then merges them in order.
+        auto insert(const TracePaths& traces,
+                    const TraceViews& views) -> std::vector<bool>; // As above, from views already open, one per trace: the traces needn't be on disk.
         auto next() -> boost::optional<TracePath>;
         auto count_all() const -> size_t;
         auto count_all_unique() const -> size_t;
@@ -35,11 +42,30 @@ namespace cluster
         auto set(const std::map<AddressRange, Entry>& entries) -> void;
         auto blocks_discovered_count() const -> size_t;
         auto set_selection_strategy(const std::string& strat) -> void;
+        auto commit_callback(CommitCallback cb) -> void; // Called as insert() takes each trace in, in order, with what was analyzed of it (nothing, unless filtering).
+        auto replay_insert(const TracePath& trace,
+                           const TraceAnalyzer::Prepared& prepared) -> bool; // As insert(), from what the commit callback was given. The trace needn't be on disk anymore.
+        auto replay_next(const TracePath& trace) -> void; // As next(), had it returned trace.
+        auto withdraw(const TracePath& trace) -> void; // Drops a trace yet to be selected, without executing it.
+        auto pending() const -> const TracePathSet&;
+
+        // Traces and analysis. Options, ELF info and callbacks are the pool's own.
+        template <class Archive>
+        void save(Archive& ar, const unsigned int version) const;
+        template <class Archive>
+        void load(Archive& ar, const unsigned int version);
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
 
     protected:
         auto remove_trace(const crete::Trace::ID& id) -> bool;
         void print_elf_info(const std::set<boost::filesystem::path>& traces);
         void print_elf_info(const boost::filesystem::path& trace_path);
+        void print_elf_info(const boost::filesystem::path& trace_path,
+                            const TraceViewCache::View& trace);
+        auto prepare(const TracePaths& traces,
+                     const TraceViews& views) const -> std::vector<TraceAnalyzer::Prepared>;
+        auto commit(const TracePath& trace,
+                    const TraceAnalyzer::Prepared& prepared) -> bool;
 
     private:
         TraceAnalyzer trace_analyzer_;
@@ -50,7 +76,52 @@ namespace cluster
         std::map<AddressRange, Entry> elf_entries_;
         std::set<Entry> elf_entry_set_;
         option::Dispatch options_;
+        std::vector<CommitCallback> commit_cbs_;
     };
+
+    template <class Archive>
+    void TracePool::save(Archive& ar, const unsigned int version) const
+    {
+        (void)version;
+
+        auto to_strings = [](const TracePathSet& paths)
+        {
+            auto v = std::vector<std::string>{};
+
+            for(const auto& p : paths)
+                v.push_back(p.generic_string());
+
+            return v;
+        };
+
+        auto all = to_strings(all_);
+        auto all_unique = to_strings(all_unique_);
+        auto next = to_strings(next_);
+
+        ar & all;
+        ar & all_unique;
+        ar & next;
+        ar & trace_analyzer_;
+    }
+
+    template <class Archive>
+    void TracePool::load(Archive& ar, const unsigned int version)
+    {
+        (void)version;
+
+        auto all = std::vector<std::string>{};
+        auto all_unique = std::vector<std::string>{};
+        auto next = std::vector<std::string>{};
+
+        ar & all;
+        ar & all_unique;
+        ar & next;
+        ar & trace_analyzer_;
+
+        all_ = TracePathSet(all.begin(), all.end());
+        all_unique_ = TracePathSet(all_unique.begin(), all_unique.end());
+        next_ = TracePathSet(next.begin(), next.end());
+    }
 } // namespace cluster
 } // namespace crete
 
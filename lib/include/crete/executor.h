@@ -27,9 +27,11 @@ public:
     const boost::filesystem::path& binary() const { return bin_; }
     const boost::filesystem::path& test_case_directory() const { return test_case_dir_; }
     const boost::filesystem::path& working_directory() const { return working_dir_; }
-    const boost::filesystem::path& current_test_case() const { return current_tc_; }
+    const boost::filesystem::path& current_test_case() const { return current_tc_; } // Packed test cases get a virtual path.
+    const TestCase& current_test() const { return current_test_; }
 
 protected:
+    virtual void execute_one();
     virtual void clean();
     virtual void prepare();
     virtual void execute();
@@ -54,6 +56,7 @@ private:
     boost::filesystem::path test_case_dir_;
     boost::filesystem::path working_dir_;
     boost::filesystem::path current_tc_;
+    TestCase current_test_;
     std::size_t test_case_count_;
     std::size_t iteration_;
     std::size_t iteration_print_threshold_;
@@ -0,0 +1,30 @@
+#ifndef CRETE_LZ_H
+#define CRETE_LZ_H
+
+#include <crete/dll.h>
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace crete
+{
+
+/**
+ * Byte-oriented LZ77, in the spirit of LZ4: favors speed over ratio.
+ *
+ * A stream is a run of sequences, each a token (literal count << 4 | match length - 4), the literals,
+ * and a 16-bit match offset. Counts that don't fit a nibble continue in bytes of 255, ending with a
+ * byte < 255. The last sequence holds literals only. The raw size is not recorded: callers keep it.
+ */
+CRETE_DLL_EXPORT void lz_compress(const uint8_t* src,
+                                  size_t size,
+                                  std::vector<uint8_t>& dst); // Appends to dst.
+CRETE_DLL_EXPORT bool lz_decompress(const uint8_t* src,
+                                    size_t size,
+                                    uint8_t* dst,
+                                    size_t dst_size); // False if src is malformed or does not decode to exactly dst_size bytes.
+
+} // namespace crete
+
+#endif // CRETE_LZ_H
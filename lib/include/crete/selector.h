@@ -7,6 +7,8 @@
 
 #include <set>
 #include <map>
+#include <vector>
+#include <unordered_map>
 
 #include <crete/trace.h>
 #include <crete/trace_graph.h>
@@ -31,8 +33,52 @@ auto calculate_weight_group_score(const Trace::Blocks& blocks/*,
                                   const BlockPass& pass*/) -> Score;
 auto calculate_least_treaded_score(const Trace::Blocks& blocks/*,
                                   const BlockPass& pass*/) -> Score;
+auto calculate_least_treaded_score(const TraceGraph::SubtreeStats& stats) -> Score; // Estimated, from the subtree's sketch.
 
 //--------- Classes ---------
+/**
+ * @brief Indexed binary min-heap of trace IDs, by score.
+ *
+ * Equal scores are ordered by a key drawn at random on push, so the minimum is uniformly random among
+ * the traces tied for it. Push, pop and erase are O(log n); nothing but the ID is kept per trace.
+ */
+class ScoreHeap
+{
+public:
+    using Handle = uint32_t;
+    using Entry = std::pair<Trace::ID, Score>;
+
+public:
+    auto push(const Trace::ID& id,
+              Score score,
+              uint32_t tiebreak) -> bool; // False if the ID is held already.
+    auto pop() -> boost::optional<Entry>;
+    auto erase(const Trace::ID& id) -> bool;
+    auto size() const -> std::size_t;
+    auto empty() const -> bool;
+    auto entries() const -> std::vector<Entry>; // Unordered.
+
+private:
+    struct Node
+    {
+        Trace::ID id;
+        Score score;
+        uint32_t tiebreak;
+        std::size_t position; // In heap_.
+    };
+
+    auto less(Handle lhs, Handle rhs) const -> bool;
+    auto place(std::size_t position, Handle h) -> void;
+    auto sift_up(std::size_t position) -> void;
+    auto sift_down(std::size_t position) -> void;
+    auto remove_at(std::size_t position) -> void;
+
+    std::vector<Handle> heap_;
+    std::vector<Node> nodes_; // By handle.
+    std::vector<Handle> free_; // Handles of popped nodes, for reuse.
+    std::unordered_map<Trace::ID, Handle> handles_;
+};
+
 class Selector
 {
 public:
@@ -43,8 +89,10 @@ public:
     virtual ~Selector();
 
     virtual auto submit(const Trace& trace) -> void;
+    virtual auto submit(const Trace& trace, Score score) -> void; // With the score from prescore().
     virtual auto next() -> const boost::optional<Trace>;
     virtual auto remove(const Trace& trace) -> void;
+    virtual auto prescore(const Trace& trace) const -> boost::optional<Score>; // Only for scores that depend on the trace alone, so may be called concurrently, ahead of submit(). None otherwise.
 
 //    auto include(const BlockPass& pass) -> void;
 
@@ -58,13 +106,15 @@ protected:
                          std::size_t high) -> std::size_t;
 
 private:
-   TraceScoreMap trace_scores_;
+   ScoreHeap trace_scores_;
    boost::random::mt19937 random_engine_;
 };
 
 class WeightGroupSelector final : public Selector
 {
 public:
+    auto prescore(const Trace& trace) const -> boost::optional<Score> override;
+
 protected:
    auto calculate_score(const Trace& trace) -> Score override;
 
@@ -116,6 +166,7 @@ private:
 class LeastTreadedSelector final : public Selector
 {
 public:
+    auto prescore(const Trace& trace) const -> boost::optional<Score> override;
 
 protected:
     auto calculate_score(const Trace& trace) -> Score override;
@@ -0,0 +1,111 @@
+#ifndef CRETE_TEST_CASE_PACK_H
+#define CRETE_TEST_CASE_PACK_H
+
+#include <crete/dll.h>
+#include <crete/test_case.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace crete
+{
+
+/**
+ * Test case pack layout:
+ *
+ * A test case directory holds numbered segments, each a pair of files:
+ *   pack-<n>.bin - test cases back to back, each in the format of TestCase::write.
+ *   pack-<n>.idx - one TestCasePackIndexEntry per test case in pack-<n>.bin, in order.
+ *
+ * Data is always made durable before the index entries that point to it, so a reader only
+ * needs to trust whole index entries that fall within the data file.
+ */
+const char* const test_case_pack_prefix = "pack-";
+const char* const test_case_pack_data_ext = ".bin";
+const char* const test_case_pack_index_ext = ".idx";
+const uint64_t test_case_pack_default_segment_size = 64 * 1024 * 1024;
+
+struct TestCasePackIndexEntry
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+bool is_test_case_pack_file(const boost::filesystem::path& p);
+
+/**
+ * @brief Appends test cases to segmented pack files.
+ *
+ * append() only buffers; nothing reaches the disk until sync(), which writes the buffered batch
+ * with one write() per file and fdatasync()s data, then index. Not thread safe.
+ */
+class CRETE_DLL_EXPORT TestCasePackWriter
+{
+public:
+    TestCasePackWriter(const boost::filesystem::path& dir,
+                       uint64_t segment_size = test_case_pack_default_segment_size);
+    ~TestCasePackWriter();
+
+    void append(const TestCase& tc);
+    void sync();
+    std::size_t count() const { return count_; }
+
+private:
+    TestCasePackWriter(const TestCasePackWriter&);
+    TestCasePackWriter& operator=(const TestCasePackWriter&);
+
+    void open_segment();
+    void close_segment();
+    void write_all(int fd, const std::string& buf, const boost::filesystem::path& p);
+
+private:
+    boost::filesystem::path dir_;
+    uint64_t segment_size_;
+    std::size_t segment_;
+    int data_fd_;
+    int index_fd_;
+    uint64_t data_offset_; // Logical end of the current segment, including buffered data.
+    std::size_t count_;
+    std::string data_buf_;
+    std::string index_buf_;
+};
+
+/**
+ * @brief Enumerates the test cases of every segment in a directory, in insertion order.
+ */
+class CRETE_DLL_EXPORT TestCasePackReader
+{
+public:
+    explicit TestCasePackReader(const boost::filesystem::path& dir);
+
+    std::size_t count() const { return entries_.size(); }
+    bool next(TestCase& tc); // Returns false once all test cases are read.
+
+private:
+    struct Entry
+    {
+        std::size_t segment;
+        TestCasePackIndexEntry location;
+    };
+
+    void load_segment_index(std::size_t segment);
+
+private:
+    boost::filesystem::path dir_;
+    std::vector<boost::filesystem::path> segments_;
+    std::vector<Entry> entries_;
+    std::size_t current_;
+    std::size_t open_segment_;
+    boost::filesystem::ifstream ifs_;
+};
+
+boost::filesystem::path test_case_pack_data_path(const boost::filesystem::path& dir, std::size_t segment);
+boost::filesystem::path test_case_pack_index_path(const boost::filesystem::path& dir, std::size_t segment);
+
+} // namespace crete
+
+#endif // CRETE_TEST_CASE_PACK_H
@@ -69,6 +69,9 @@ namespace crete
      * graph assumes all traces share the first block in common, the first block cannot be replaced
      * by a hashed representation of the cycle it is involved in.
      *
+     * Cycles are those of find_cycles_custom, so hashes stay comparable with traces compressed
+     * before. find_cycles_runs is much faster, but on some traces picks different ranges.
+     *
      * 'trace' is not modified. Ordinarily, it would be const, but boost::hash_range doesn't
      * accept const iterators, so it was either take the trace as non-const, or use const_cast.
      * TODO: work around the const problem. Possibility: boost::iterator_adapter.
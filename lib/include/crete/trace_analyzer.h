@@ -8,12 +8,17 @@
 
 #include <set>
 #include <map>
+#include <cassert>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
 
 #include <crete/dll.h>
 #include <crete/trace.h>
@@ -21,11 +26,132 @@
 #include <crete/addr_range.h>
 #include <crete/factory.h>
 #include <crete/trace_graph.h>
+#include <crete/trace_view.h>
 #include <crete/selector.h>
 
 namespace crete
 {
 
+/**
+ * @brief Which traces still hold blocks that no executed trace has covered.
+ *
+ * Blocks are interned to dense handles, and coverage is a bitmap over them. Each registered trace
+ * counts its distinct uncovered blocks, and each uncovered block lists the traces counting it, so
+ * covering a block only touches the traces that hold it. A trace leaves when its count reaches 0.
+ */
+class CRETE_DLL_EXPORT UnexecutedBlockRegistry
+{
+public:
+    using BlockHandle = uint32_t;
+
+public:
+    template <typename Blocks>
+    bool insert(const Trace::ID& id, const Blocks& blocks); // Returns false, registering nothing, if every block is covered. A trace is only registered once.
+    template <typename Blocks>
+    void executed(const Blocks& blocks); // Costs a lookup per block, and work only for those newly covered.
+    boost::optional<Trace::ID> pop(); // Lowest ID first.
+    size_t size() const { return pending_.size(); }
+    size_t covered_count() const { return covered_count_; }
+
+    template <class Archive>
+    void save(Archive& ar, const unsigned int version) const;
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version);
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+private:
+    BlockHandle intern(Trace::Block b);
+    void count(TraceIdTable::Handle trace, BlockHandle b);
+    void cover(BlockHandle b);
+
+    boost::unordered_map<Trace::Block, BlockHandle> handles_;
+    std::vector<bool> covered_; // By block.
+    std::vector<std::vector<TraceIdTable::Handle>> holders_; // By uncovered block: traces counting it.
+    std::vector<TraceIdTable::Handle> last_counted_; // By block: dedupes a trace's repeats of it. Off by one: 0 is none.
+    size_t covered_count_ = 0;
+    TraceIdTable trace_ids_;
+    std::vector<uint32_t> remaining_; // By trace: uncovered blocks.
+    std::set<Trace::ID> pending_; // Registered, with remaining blocks, and not yet popped.
+};
+
+template <typename Blocks>
+bool UnexecutedBlockRegistry::insert(const Trace::ID& id, const Blocks& blocks)
+{
+    if(trace_ids_.find(id))
+        return pending_.count(id) != 0;
+
+    auto trace = trace_ids_.intern(id);
+
+    remaining_.push_back(0);
+
+    for(const auto& b : blocks)
+        count(trace, intern(b));
+
+    if(remaining_[trace] == 0)
+        return false;
+
+    pending_.insert(id);
+
+    return true;
+}
+
+template <typename Blocks>
+void UnexecutedBlockRegistry::executed(const Blocks& blocks)
+{
+    for(const auto& b : blocks)
+        cover(intern(b));
+}
+
+template <class Archive>
+void UnexecutedBlockRegistry::save(Archive& ar, const unsigned int version) const
+{
+    (void)version;
+
+    auto blocks = std::vector<Trace::Block>(covered_.size()); // By handle: handles_, inverted.
+    auto covered_count = uint64_t{covered_count_};
+
+    auto pending = std::vector<Trace::ID>(pending_.begin(), pending_.end());
+
+    for(const auto& h : handles_)
+        blocks[h.second] = h.first;
+
+    ar & blocks;
+    ar & covered_;
+    ar & holders_;
+    ar & last_counted_;
+    ar & covered_count;
+    ar & trace_ids_;
+    ar & remaining_;
+    ar & pending;
+}
+
+template <class Archive>
+void UnexecutedBlockRegistry::load(Archive& ar, const unsigned int version)
+{
+    (void)version;
+
+    auto blocks = std::vector<Trace::Block>{};
+    auto covered_count = uint64_t{0};
+    auto pending = std::vector<Trace::ID>{};
+
+    ar & blocks;
+    ar & covered_;
+    ar & holders_;
+    ar & last_counted_;
+    ar & covered_count;
+    ar & trace_ids_;
+    ar & remaining_;
+    ar & pending;
+
+    covered_count_ = covered_count;
+    pending_ = std::set<Trace::ID>(pending.begin(), pending.end());
+
+    handles_.clear();
+
+    for(BlockHandle h = 0; h < blocks.size(); ++h)
+        handles_.insert(std::make_pair(blocks[h], h));
+}
+
 class CRETE_DLL_EXPORT TraceAnalyzer
 {
 public:
@@ -37,6 +163,15 @@ public:
     typedef boost::unordered_map<Trace::Block, Weight> WeightMap;
     typedef std::map<Trace, Score> TraceScoreMap;
 
+    struct Prepared // The part of inserting a trace that doesn't touch the analyzer's state.
+    {
+        Prepared() : trace(Trace::ID(), Trace::Blocks()) {}
+
+        Trace trace;
+        TraceViewCache::View view;
+        boost::optional<Score> score; // From the selector's prescore().
+    };
+
 public:
     TraceAnalyzer(const std::string selection_strat);
     TraceAnalyzer(const TraceAnalyzer& other);
@@ -44,10 +179,17 @@ public:
     auto operator=(const TraceAnalyzer& other) -> TraceAnalyzer&;
 
     bool insert_trace(const boost::filesystem::path& path); // Returns true if trace was valid (successfully inserted).
+    Prepared prepare_trace(const boost::filesystem::path& path) const; // Reads, compresses and scores the trace. Safe to call concurrently with itself, but not with the rest.
+    Prepared prepare_trace(const boost::filesystem::path& path, const TraceViewCache::View& view) const; // As above, from a view already open: the trace needn't be on disk.
+    bool commit_trace(const boost::filesystem::path& path, const Prepared& prepared); // As insert_trace, for a prepared trace.
     void insert_callback(std::function<void(Trace::ID)> cb); // Calls cb with trace that has been made redundant by newly inserted trace (when the newly inserted trace supercedes cb).
     boost::optional<Trace> next();
-    boost::optional<Trace> next_with_unexecuted_blocks();
+    boost::optional<Trace> next_with_unexecuted_blocks(); // ID only.
     void submit_executed(const Trace& trace);
+    void submit_executed(const boost::filesystem::path& path); // As above, for an inserted trace, read through its view. Falls back on the graph's blocks for a trace neither viewed nor on disk.
+    void resubmit_executed(const boost::filesystem::path& path); // As above, for a trace selected before the analyzer was restored: withdraws it from the selector, too. Falls back on the graph's blocks once the trace is off the disk.
+    void withdraw(const boost::filesystem::path& path); // Takes an inserted trace out of selection, without executing it.
+    TraceViewCache::View view(const boost::filesystem::path& path); // Shared view of path/tb-seq.bin. Held until the trace is executed.
 
     void print_graph(bool only_branches, std::map<AddressRange, Entry>& elf_entries) const; // Debugging.
     size_t blocks_discovered_count() const;
@@ -56,25 +198,64 @@ public:
     void set(const trace::SelectionStrategy& strat);
     auto compress_traces(bool b) -> void;
 
+    // The graph, block registry and selector scores. The selection strategy is the analyzer's own.
+    template <class Archive>
+    void save(Archive& ar, const unsigned int version) const;
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version);
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
 protected:
     void initialize_log();
     void submit_to_unexecuted_block_registry(const Trace& trace);
-    void update_global_block_weights(const Trace& trace);
-    void update_traces_with_unexecuted_blocks();
-    bool contains_unexecuted(const Trace::Blocks& blocks);
     void initialize_selector_factory();
 
 private:
     TraceGraph trace_graph_;
-    TraceSet traces_with_unexecuted_blocks_;
-    WeightMap global_block_weights_; // Currently only used for traces_with_unexecuted_blocks_. May have a use in the future. We don't need a "weight" for traces_with_unexecuted_blocks_, we just need true/false whether a given block was executed or not.
+    UnexecutedBlockRegistry unexecuted_blocks_;
     Factory<trace::SelectionStrategy, boost::shared_ptr<trace::Selector>> selector_factory_;
     boost::shared_ptr<trace::Selector> trace_selector_;
     trace::SelectionStrategy strat_;
     bool compress_traces_ = false;
+    TraceViewCache views_;
 };
 
-Trace parse_trace(const boost::filesystem::path& path);
+template <class Archive>
+void TraceAnalyzer::save(Archive& ar, const unsigned int version) const
+{
+    (void)version;
+
+    assert(trace_selector_);
+
+    auto scores = std::vector<std::pair<Trace::ID, Score>>{};
+
+    for(const auto& s : trace_selector_->trace_scores())
+        scores.push_back(std::make_pair(s.first.get_id(), s.second));
+
+    ar & trace_graph_;
+    ar & unexecuted_blocks_;
+    ar & scores;
+}
+
+template <class Archive>
+void TraceAnalyzer::load(Archive& ar, const unsigned int version)
+{
+    (void)version;
+
+    auto scores = std::vector<std::pair<Trace::ID, Score>>{};
+
+    ar & trace_graph_;
+    ar & unexecuted_blocks_;
+    ar & scores;
+
+    views_.clear();
+    set(strat_); // A fresh selector, to take the scores.
+
+    for(const auto& s : scores)
+        trace_selector_->submit(Trace(s.first, Trace::Blocks()), s.second);
+}
+
+Trace parse_trace(const boost::filesystem::path& path); // Prefer TraceView: no copy.
 
 } // namespace crete
 
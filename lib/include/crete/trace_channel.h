@@ -0,0 +1,75 @@
+#ifndef CRETE_TRACE_CHANNEL_H
+#define CRETE_TRACE_CHANNEL_H
+
+#include <crete/dll.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <string>
+#include <stdint.h>
+
+namespace crete
+{
+
+/**
+ * Control channel between QEMU and the VM node: a Unix-domain stream socket in QEMU's hostfile/
+ * directory. QEMU listens; the VM node connects once the guest has.
+ *
+ * Each message is a TraceChannelHeader followed by its payload (host byte order):
+ *
+ *   trace_channel_test_input   node -> QEMU: the serialized TestCase of the next test, in place of
+ *                              hostfile/input_arguments.bin
+ *   trace_channel_trace_ready  QEMU -> node: the trace of the test has been dumped, in place of
+ *                              hostfile/trace_ready; no payload
+ *
+ * Without a connected peer, both sides fall back to those files.
+ */
+const char* const trace_channel_file_name = "trace_channel";
+
+enum TraceChannelMessageType
+{
+    trace_channel_test_input = 1,
+    trace_channel_trace_ready = 2
+};
+
+struct TraceChannelHeader
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+/**
+ * @brief One end of the control channel.
+ *
+ * Throws std::runtime_error on a socket error, or once the peer has gone. Not thread safe, except
+ * that one thread may send while another receives.
+ */
+class CRETE_DLL_EXPORT TraceChannel : private boost::noncopyable
+{
+public:
+    TraceChannel();
+    ~TraceChannel();
+
+    void listen(const boost::filesystem::path& path); // Replaces a stale socket file.
+    bool accept(int timeout_ms); // True once a peer is connected. -1 waits for one.
+    void connect(const boost::filesystem::path& path);
+    bool is_connected() const;
+
+    void send(uint32_t type, const std::string& payload);
+    bool receive(uint32_t& type, std::string& payload, int timeout_ms); // False if nothing arrived in time. -1 waits.
+    void close();
+
+private:
+    void read_all(void* data, size_t size);
+
+private:
+    int listen_fd_;
+    int fd_;
+    boost::filesystem::path listen_path_;
+};
+
+} // namespace crete
+
+#endif // CRETE_TRACE_CHANNEL_H
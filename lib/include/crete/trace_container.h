@@ -0,0 +1,145 @@
+#ifndef CRETE_TRACE_CONTAINER_H
+#define CRETE_TRACE_CONTAINER_H
+
+#include <crete/dll.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace crete
+{
+
+/**
+ * Trace container layout (host byte order, like the rest of the trace files):
+ *
+ *   header:   "CRTC", uint32 version, uint64 index offset, uint32 section count, uint32 CRC-32 of
+ *             the index, uint64 file size
+ *   sections: back to back, each starting on an 8-byte boundary so a uint64_t array can be used in place
+ *   index:    one TraceContainerIndexEntry per section
+ *
+ * A section is named after the file it replaces (tb-seq.bin, dump_sync_memos.bin, ...) and is either
+ * stored as is or LZ-compressed (crete/lz.h), whichever is smaller. Each carries the CRC-32 of its
+ * stored bytes, checked the first time the section is read.
+ *
+ * The container is written beside its final path and renamed into place once whole, so a reader
+ * never sees one half written.
+ */
+const char* const trace_container_file_name = "trace.crete";
+const uint32_t trace_container_version = 1;
+
+enum TraceSectionFlags
+{
+    trace_section_lz = 1u << 0
+};
+
+struct TraceContainerIndexEntry
+{
+    char name[32]; // NUL-padded.
+    uint64_t offset;
+    uint64_t stored_size;
+    uint64_t size;
+    uint32_t flags;
+    uint32_t crc;
+};
+
+/**
+ * @brief Writes a trace container, one section at a time.
+ *
+ * Sections are written as they're added; close() adds the index and header, syncs, and renames the
+ * container into place. A writer destroyed before close() leaves nothing behind. Not thread safe.
+ */
+class CRETE_DLL_EXPORT TraceContainerWriter : private boost::noncopyable
+{
+public:
+    explicit TraceContainerWriter(const boost::filesystem::path& path);
+    ~TraceContainerWriter();
+
+    void add(const std::string& name, const void* data, size_t size, bool compress);
+    void add(const std::string& name, const std::string& data, bool compress);
+    void close();
+
+private:
+    boost::filesystem::path path_;
+    boost::filesystem::path tmp_path_;
+    int fd_;
+    uint64_t offset_;
+    std::vector<TraceContainerIndexEntry> index_;
+};
+
+/**
+ * @brief Read-only, memory-mapped trace container.
+ *
+ * Stored sections are read in place. Compressed ones are decompressed on first use and kept for the
+ * life of the container. Throws std::runtime_error on a malformed container, a missing section, or
+ * a section that fails its checksum.
+ */
+class CRETE_DLL_EXPORT TraceContainer : private boost::noncopyable
+{
+public:
+    struct Section
+    {
+        const char* data;
+        size_t size;
+    };
+
+public:
+    explicit TraceContainer(const boost::filesystem::path& path);
+    TraceContainer(const boost::filesystem::path& path, const char* data, size_t size); // Already in memory, and kept there by the caller for the life of the container. 'path' only names it in errors.
+    ~TraceContainer();
+
+    bool contains(const std::string& name) const;
+    Section section(const std::string& name) const; // Valid for the life of the container.
+    std::vector<std::string> names() const;
+    void extract(const std::string& name, const boost::filesystem::path& p) const; // For tools that only read files.
+
+private:
+    void read_index();
+    const TraceContainerIndexEntry& find(const std::string& name) const;
+
+private:
+    boost::filesystem::path path_;
+    void* map_;
+    size_t map_size_;
+    const char* base_;
+    const TraceContainerIndexEntry* index_;
+    uint32_t count_;
+    mutable std::vector<bool> verified_;
+    mutable std::map<uint32_t, std::vector<uint64_t> > decompressed_; // uint64_t for alignment.
+};
+
+/**
+ * @brief Reads a trace artifact in dir: the section of that name in the trace container, in place,
+ * or, for a trace from before the container, the file of that name.
+ *
+ * Fails like an ifstream does - !good() - when there's neither.
+ */
+class CRETE_DLL_EXPORT TraceArtifactStream : public std::istream
+{
+public:
+    TraceArtifactStream(const boost::filesystem::path& dir, const std::string& name);
+
+private:
+    class SectionBuf : public std::streambuf
+    {
+    public:
+        void set(const TraceContainer::Section& s);
+    };
+
+private:
+    boost::shared_ptr<TraceContainer> container_;
+    SectionBuf section_buf_;
+    std::filebuf file_buf_;
+};
+
+bool trace_artifact_exists(const boost::filesystem::path& dir, const std::string& name); // Either way.
+
+} // namespace crete
+
+#endif // CRETE_TRACE_CONTAINER_H
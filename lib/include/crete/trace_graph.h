@@ -2,11 +2,21 @@
 #define CRETE_TRACE_GRAPH_H
 
 #include <boost/graph/adjacency_list.hpp>
+#include <boost/optional.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/serialization/array.hpp>
+#include <boost/serialization/deque.hpp> // Ahead of queue.hpp, which serializes through it.
+#include <boost/serialization/queue.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
 
+#include <array>
 #include <functional>
+#include <queue>
 
 #include <crete/trace.h>
 #include <crete/elf_reader.h>
@@ -15,86 +25,316 @@
 namespace crete
 {
 
-struct VertexProperty
+/**
+ * @brief Interns trace IDs, so that graph nodes refer to their trace by a 32-bit handle.
+ *
+ * Handles are never reused; an ID superseded in the graph keeps its handle.
+ */
+class TraceIdTable
 {
-    Trace::Block unique_hash;
-    std::string trace_id; // TODO: placing the trace ID for every vertex is expensive. Do the math. Say each ID is 32bytes. If a trace is 1 million blocks, that's 32MB per trace (minus merged portion). If necessary, use a UUID instead. It's only 16 bytes.
-    bool cache = false; // TODO: remove. Redundant now that only using brcond blocks.
+public:
+    using Handle = uint32_t;
+
+public:
+    Handle intern(const Trace::ID& id);
+    boost::optional<Handle> find(const Trace::ID& id) const;
+    const Trace::ID& id(Handle h) const { return ids_[h]; }
+    size_t size() const { return ids_.size(); }
+
+    template <class Archive>
+    void save(Archive& ar, const unsigned int version) const;
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version);
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+private:
+    std::vector<Trace::ID> ids_;
+    boost::unordered_map<Trace::ID, Handle> handles_;
+};
+
+template <class Archive>
+void TraceIdTable::save(Archive& ar, const unsigned int version) const
+{
+    (void)version;
+
+    ar & ids_;
+}
+
+template <class Archive>
+void TraceIdTable::load(Archive& ar, const unsigned int version)
+{
+    (void)version;
+
+    ar & ids_;
+
+    handles_.clear();
+
+    for(Handle h = 0; h < ids_.size(); ++h)
+        handles_.insert(std::make_pair(ids_[h], h));
+}
+
+/**
+ * @brief AMS ("tug-of-war") sketch of a multiset of blocks: estimates the sum of their squared frequencies.
+ *
+ * Each counter sums the blocks' counts, signed by one bit of the block's hash. Sketches are linear, so
+ * that of a subtree is the sum of those of its parts.
+ */
+class BlockSketch
+{
+public:
+    static const size_t width = 64; // Counters, one per bit of the hash. Relative error about sqrt(2 / width).
+
+public:
+    template <typename It>
+    void add(It first, It last) { update(first, last, 1); }
+    template <typename It>
+    void subtract(It first, It last) { update(first, last, -1); }
+    void add(const BlockSketch& other);
+    double second_moment() const;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version)
+    {
+        (void)version;
+
+        ar & counters_;
+    }
+
+private:
+    template <typename It>
+    void update(It first, It last, int64_t sign);
+    static uint64_t hash(Trace::Block b);
+
+    std::array<int64_t, width> counters_{};
 };
 
+template <typename It>
+void BlockSketch::update(It first, It last, int64_t sign)
+{
+    for(; first != last; ++first)
+    {
+        auto h = hash(*first);
+
+        for(size_t i = 0; i < width; ++i)
+            counters_[i] += ((h >> i) & 1) ? sign : -sign;
+    }
+}
+
+inline
+uint64_t BlockSketch::hash(Trace::Block b)
+{
+    // splitmix64 finalizer: block addresses share most of their bits, so they're mixed before use.
+    b = (b ^ (b >> 30)) * 0xbf58476d1ce4e5b9ull;
+    b = (b ^ (b >> 27)) * 0x94d049bb133111ebull;
+
+    return b ^ (b >> 31);
+}
+
 // For use by unordered_map.
 struct TraceHash
 {
     size_t operator()(const Trace& trace) const;
 };
 
-bool operator==(const VertexProperty& rhs, const VertexProperty& lhs);
-bool operator!=(const VertexProperty& rhs, const VertexProperty& lhs);
-
-class bfs_execution_visitor;
-
+/**
+ * @brief Radix tree of the traces' blocks, branching only where traces diverge.
+ *
+ * Each node holds a span - a straight-line run of blocks - and the trace that owns it. Spans are
+ * ranges of a single block arena, so inserting a trace allocates per branch point, not per block.
+ *
+ * A node has no children (a leaf: the end of a trace), several (a branch point), or, where a trace
+ * extended another whose span could not be grown in place, just the one.
+ */
 class TraceGraph
 {
 public:
-    using Graph = boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS, VertexProperty>;
+    using Node = uint32_t; // The root is node 0.
+    using Nodes = std::vector<Node>;
+    using Graph = boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS>; // Only for print_graph().
     using Vertex = boost::graph_traits<Graph>::vertex_descriptor;
-    using Edge = boost::graph_traits<Graph>::edge_descriptor;
-    using EdgeRange = std::pair<boost::graph_traits<Graph>::out_edge_iterator, boost::graph_traits<Graph>::out_edge_iterator>;
     using Traces = boost::unordered_set<Trace, TraceHash>;
     using ExecutedTraces = boost::unordered_map<Trace, bool, TraceHash>;
     using Weight = uint64_t;
     using Score = double;
     using TraceScoreMap = std::map<Trace, Score>;
     using Blocks = Trace::Blocks;
-    using BranchScoreMap = std::map<Score, Vertex>;
     using Weights = std::vector<Weight>;
 
-    friend class bfs_execution_visitor;
+    struct SubtreeStats // Of a node and its descendants. Kept up to date on insert and execution.
+    {
+        uint64_t blocks = 0;
+        uint32_t unexecuted_leaves = 0; // Traces yet to be executed.
+        BlockSketch sketch;
+
+        template <class Archive>
+        void serialize(Archive& ar, const unsigned int version)
+        {
+            (void)version;
+
+            ar & blocks;
+            ar & unexecuted_leaves;
+            ar & sketch;
+        }
+    };
+
+    static const Node no_node = ~Node{0};
 
 public:
     TraceGraph();
 
     bool insert(const Trace& trace);
     void insert_callback(std::function<void(Trace::ID)> cb);
-    boost::optional<Trace> next_bfs(); // TODO: don't mark as executed. Let sumbit_executed be called for that. Marking the trace as executed implies that we know the returned trace will be executed.
-    boost::optional<Trace> select_by_recursive_score(std::function<Score(const Blocks&)> calculate_score) const;
+    boost::optional<Trace> next_bfs(); // Resumes from where the last call left off. TODO: don't mark as executed. Let sumbit_executed be called for that. Marking the trace as executed implies that we know the returned trace will be executed.
+    boost::optional<Trace> select_by_subtree_score(std::function<Score(const SubtreeStats&)> calculate_score) const; // Descends to the lowest scoring child with a trace yet to be executed, down to its leaf.
     void submit_executed(const Trace& trace);
+    bool contains(const Trace::ID& trace_id) const { return executed_traces_.count(Trace(trace_id, Trace::Blocks())) != 0; }
     bool executed(const Trace& trace) const { return executed_traces_.at(trace); }
-    bool executed(const decltype(VertexProperty::trace_id)& trace_id) const { return executed_traces_.at(Trace(trace_id, Trace::Blocks())); }
-    void executed(const Trace& trace, bool exec) { executed_traces_.at(trace) = exec; }
+    bool executed(const Trace::ID& trace_id) const { return executed_traces_.at(Trace(trace_id, Trace::Blocks())); }
+    void executed(const Trace& trace, bool exec);
     std::string last_selected() const;
-    boost::optional<Trace> select_by_recursive_score(std::function<Score(const Blocks&)> calculate_score, const Vertex& root, const Graph& graph) const;
-    void collect_descendant_blocks(const Vertex& root, const Graph& graph, Blocks& blocks) const;
+    const SubtreeStats& subtree_stats(Node n) const { return subtree_stats_[n]; }
+    Trace::Block block(Node n, uint64_t offset) const { return blocks_[spans_[n].first + offset]; }
+    uint64_t span_size(Node n) const { return spans_[n].size; }
+    const Trace::ID& node_trace_id(Node n) const { return trace_ids_.id(spans_[n].trace_id); }
+    size_t node_count() const { return spans_.size(); }
+    size_t block_count() const { return blocks_.size(); } // Vertices of the equivalent uncompressed graph.
+    Blocks trace_blocks(const Trace::ID& trace_id) const; // As inserted. Empty if the trace isn't in the graph.
     // Debugging
     void print_graph(bool only_branches, const TraceScoreMap& trace_scores, const std::map<AddressRange, Entry>& elf_entries) const;
 
+    // Everything but the callbacks, which belong to whoever holds the graph.
+    template <class Archive>
+    void save(Archive& ar, const unsigned int version) const;
+    template <class Archive>
+    void load(Archive& ar, const unsigned int version);
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
 protected:
-    bool is_subgraph(const Graph& trace, const Vertex& divergence); // If the point of divergence is when the trace graph ends, then it's a subgraph.
-    bool is_supergraph_prev_trace(const Graph& trace, const Vertex& trace_diverge, const Vertex& graph_diverge);
-    void back_insert(const std::string& trace_id, const std::string& prev_trace_id, const std::vector<Vertex>& path); // Replaces id of trace over existing trace in graph, as the previous trace over that path has been superceded.
-    bool merge_trace(const Graph& trace); // Doesn't merge if it's redundant or a subgraph.
-    void merge_trace(const Graph& trace, const Vertex& trace_diverge, const Vertex& existing_diverge);
-    std::pair<Vertex, Vertex> find_trace_divergence(const TraceGraph::Graph& trace, Vertex& tv, Vertex& ev, std::vector<Vertex>& path); // Returns <trace_vertex, graph_vertex> where the graphs diverge.
-    void mark_cache_vertices();
+    struct Span
+    {
+        uint64_t first; // Into blocks_.
+        uint64_t size;
+        TraceIdTable::Handle trace_id;
+        Node parent;
+        Node first_child;
+        Node last_child;
+        Node next_sibling;
+
+        template <class Archive>
+        void serialize(Archive& ar, const unsigned int version)
+        {
+            (void)version;
+
+            ar & first;
+            ar & size;
+            ar & trace_id;
+            ar & parent;
+            ar & first_child;
+            ar & last_child;
+            ar & next_sibling;
+        }
+    };
+
+    enum class Discovery : uint8_t { undiscovered, queued, visited }; // Of a node, by next_bfs().
+    using Frontier = std::vector<std::queue<Node>>; // By level, each in order of discovery.
+
+    struct Divergence
+    {
+        size_t matched; // Leading blocks of the trace already in the graph.
+        Node node; // Holding the last of them.
+        uint64_t offset; // Blocks of node matched.
+    };
+
+    void back_insert(TraceIdTable::Handle trace_id, TraceIdTable::Handle prev_trace_id, const Nodes& path); // Replaces id of trace over existing trace in graph, as the previous trace over that path has been superceded.
+    bool merge_trace(const Trace& trace); // Doesn't merge if it's redundant or a subgraph.
+    Node append_span(const Blocks& blocks, size_t first, Node parent, TraceIdTable::Handle trace_id); // Spans blocks [first, end) below parent.
+    void split(Node n, uint64_t offset); // n keeps its first offset blocks; the rest, and n's children, move to a new, only child.
+    void add_child(Node parent, Node child);
+    Divergence find_trace_divergence(const Blocks& blocks, Nodes& path) const;
+    void add_blocks_to_path(Node n, Blocks::const_iterator first, Blocks::const_iterator last); // To the stats of n and its ancestors.
+    void add_unexecuted_to_path(Node n, int32_t count); // As above.
+    void set_leaf(TraceIdTable::Handle trace_id, Node n);
+    bool is_unexecuted(TraceIdTable::Handle trace_id) const;
+    void discover(Node n, uint32_t level);
+    void discover_children(Node n);
     void remove(const Trace& trace);
-    Graph compress_to_branches(const Graph& g) const;
-    void compress_to_branches(const Vertex& parent_comp,
-                              Graph& g_comp,
-                              const Vertex& parent_orig,
-                              const Graph& g_orig) const;
-    Vertex find_next_branch_or_leaf(const Vertex& parent, const Graph& g) const;
-    bool is_leaf_branch(const Vertex& v, const Graph& g) const;
-//        void back_insert_block_info(const Trace& trace, const std::vector<Vertex>& path); // TODO: is back_insert a misnomer? I _could_ back insert, but I could also forward insert under the current impl.
 
 private:
-    Graph graph_;
-    Traces traces_;
+    std::vector<Span> spans_;
+    std::vector<Trace::Block> blocks_; // Block arena: each span is a range of it.
+    std::vector<SubtreeStats> subtree_stats_; // By node.
+    std::vector<Node> leaves_; // By trace handle: where the trace ends, if it's in the graph.
+    std::vector<Discovery> discovery_; // By node.
+    std::vector<uint32_t> levels_; // By node: branch points above it, when discovered.
+    Frontier frontier_; // Discovered, but not yet visited, by next_bfs().
+    size_t frontier_level_ = 0; // No shallower level has nodes queued.
+    TraceIdTable trace_ids_;
+    Traces traces_; // IDs only; blocks are held by the graph.
     ExecutedTraces executed_traces_; // Only relevant if bfs selection enabled.
     std::vector<std::function<void(Trace::ID)>> redundant_trace_cbs_;
     std::string last_selected_; // Debugging info.
 };
 
-TraceGraph::Graph make_graph(const Trace& trace);
+template <class Archive>
+void TraceGraph::save(Archive& ar, const unsigned int version) const
+{
+    (void)version;
+
+    auto executed = std::vector<std::pair<Trace::ID, bool>>{}; // traces_ holds the same IDs.
+    auto frontier_level = uint64_t{frontier_level_};
+
+    executed.reserve(executed_traces_.size());
+
+    for(const auto& e : executed_traces_)
+        executed.push_back(std::make_pair(e.first.get_id(), e.second));
+
+    ar & spans_;
+    ar & blocks_;
+    ar & subtree_stats_;
+    ar & leaves_;
+    ar & discovery_;
+    ar & levels_;
+    ar & frontier_;
+    ar & frontier_level;
+    ar & trace_ids_;
+    ar & executed;
+    ar & last_selected_;
+}
+
+template <class Archive>
+void TraceGraph::load(Archive& ar, const unsigned int version)
+{
+    (void)version;
+
+    auto executed = std::vector<std::pair<Trace::ID, bool>>{};
+    auto frontier_level = uint64_t{0};
+
+    ar & spans_;
+    ar & blocks_;
+    ar & subtree_stats_;
+    ar & leaves_;
+    ar & discovery_;
+    ar & levels_;
+    ar & frontier_;
+    ar & frontier_level;
+    ar & trace_ids_;
+    ar & executed;
+    ar & last_selected_;
+
+    frontier_level_ = frontier_level;
+
+    traces_.clear();
+    executed_traces_.clear();
+
+    for(const auto& e : executed)
+    {
+        auto key = Trace(e.first, Trace::Blocks());
+
+        traces_.insert(key);
+        executed_traces_.insert({key, e.second});
+    }
+}
+
 std::string parse_trace_number(const Trace::ID& id);
 std::string parse_iteration_number(const Trace::ID& id);
 std::string parse_tb_number(const Trace::ID& id);
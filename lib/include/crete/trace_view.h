@@ -0,0 +1,103 @@
+#ifndef CRETE_TRACE_VIEW_H
+#define CRETE_TRACE_VIEW_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <crete/dll.h>
+#include <crete/trace.h>
+#include <crete/trace_container.h>
+
+namespace crete
+{
+
+const size_t trace_view_cache_default_capacity = 256; // Mappings, not bytes: the kernel pages them in and out.
+
+/**
+ * @brief Read-only, memory-mapped view of a tb-seq.bin, or of the tb-seq.bin section of a trace container.
+ *
+ * tb-seq.bin is a flat array of host-order uint64_t block addresses, so the mapping is used as-is:
+ * no parsing, and no allocation beyond the mapping itself. A trailing partial block is ignored.
+ * A tb-seq.bin already in memory, of a trace not on disk yet, is used as-is too.
+ *
+ * The ID is the same as that of parse_trace(): the directory holding tb-seq.bin or the container.
+ */
+class CRETE_DLL_EXPORT TraceView : private boost::noncopyable
+{
+public:
+    typedef const Trace::Block* const_iterator;
+
+public:
+    explicit TraceView(const boost::filesystem::path& path); // Path to tb-seq.bin.
+    TraceView(const boost::filesystem::path& trace_dir,
+              const boost::shared_ptr<const TraceContainer>& container); // Holds on to the container.
+    TraceView(const boost::filesystem::path& trace_dir,
+              const boost::shared_ptr<const std::vector<uint8_t> >& data); // A tb-seq.bin already in memory. Holds on to it.
+    ~TraceView();
+
+    const Trace::ID& get_id() const { return id_; }
+    const_iterator begin() const { return blocks_; }
+    const_iterator end() const { return blocks_ + size_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    Trace to_trace() const; // Copies out, with a single allocation.
+
+private:
+    Trace::ID id_;
+    boost::shared_ptr<const TraceContainer> container_;
+    boost::shared_ptr<const std::vector<uint8_t> > data_;
+    void* map_;
+    size_t map_size_;
+    const Trace::Block* blocks_;
+    size_t size_;
+};
+
+/**
+ * @brief Shares one TraceView per trace directory between everything that reads the trace.
+ *
+ * Bounded by the number of live mappings. The least recently used is dropped when full; holders of
+ * it are unaffected, as views are reference counted.
+ */
+class CRETE_DLL_EXPORT TraceViewCache
+{
+public:
+    typedef boost::shared_ptr<const TraceView> View;
+
+public:
+    TraceViewCache(size_t capacity = trace_view_cache_default_capacity);
+
+    View get(const boost::filesystem::path& trace_dir); // Maps the trace's block sequence on a miss.
+    void insert(const boost::filesystem::path& trace_dir, const View& view); // Adopts a view from open(), or of a trace not on disk, unless one is cached already.
+    bool contains(const boost::filesystem::path& trace_dir) const;
+    void erase(const boost::filesystem::path& trace_dir);
+    void clear();
+    size_t count() const;
+    uint64_t maps() const; // Views mapped for the cache - misses and adoptions - over its lifetime.
+
+    static View open(const boost::filesystem::path& trace_dir); // From the trace container if there is one, else tb-seq.bin. Bypasses any cache. Thread-safe.
+
+private:
+    void evict_lru();
+
+    struct Entry
+    {
+        View view;
+        uint64_t last_used;
+    };
+
+    boost::unordered_map<std::string, Entry> entries_;
+    size_t capacity_;
+    uint64_t clock_;
+    uint64_t maps_;
+};
+
+} // namespace crete
+
+#endif // CRETE_TRACE_VIEW_H
@@ -3,8 +3,12 @@
 
 #include <vector>
 #include <deque>
+#include <map>
+#include <queue>
 #include <unordered_map>
 #include <utility>
+#include <iterator>
+#include <tuple>
 #include <type_traits>
 #include <algorithm>
 #include <cstdint>
@@ -383,6 +387,312 @@ auto find_cycles_custom(InputIt first, InputIt last) -> std::vector<std::pair<In
 
 } // unoptimized
 
+namespace detail {
+
+const auto lce_modulus = (uint64_t{1} << 61) - 1; // Mersenne prime: reduction is a shift and an add.
+const auto lce_base = uint64_t{0x1f3d5b79a2c4e687} % lce_modulus;
+const auto lce_direct = size_t{8}; // Most extensions are short: compare elements before fingerprints.
+
+/**
+ * Longest common extension queries over a sequence: how far two positions agree, forwards or backwards.
+ *
+ * Karp-Rabin fingerprints of every prefix, compared by exponential search: O(log lce) per query.
+ * Equal fingerprints may, with negligible probability, hide a mismatch, so callers verify what they use.
+ */
+template <typename RandomIt>
+class LongestCommonExtension
+{
+public:
+    LongestCommonExtension(RandomIt first, RandomIt last) :
+        first_{first},
+        size_{static_cast<size_t>(std::distance(first, last))},
+        prefixes_(size_ + 1),
+        powers_(size_ + 1)
+    {
+        using Value = typename std::iterator_traits<RandomIt>::value_type;
+
+        prefixes_[0] = 0;
+        powers_[0] = 1;
+
+        for(auto i = size_t{0}; i < size_; ++i)
+        {
+            auto x = static_cast<uint64_t>(std::hash<Value>()(first_[i])) + 0x9e3779b97f4a7c15ull; // splitmix64: hashes are often the identity.
+
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            x = x ^ (x >> 31);
+
+            prefixes_[i + 1] = add(multiply(prefixes_[i], lce_base), x % lce_modulus);
+            powers_[i + 1] = multiply(powers_[i], lce_base);
+        }
+    }
+
+    auto size() const -> size_t { return size_; }
+
+    // Of the sequences starting at i and j.
+    auto forward(size_t i, size_t j) const -> size_t
+    {
+        auto limit = size_ - std::max(i, j);
+
+        return extend(limit, [this, i, j](size_t n) { return hash(i, n) == hash(j, n); },
+                             [this, i, j](size_t k) { return first_[i + k] == first_[j + k]; });
+    }
+
+    // Of the sequences ending just before i and j.
+    auto backward(size_t i, size_t j) const -> size_t
+    {
+        auto limit = std::min(i, j);
+
+        return extend(limit, [this, i, j](size_t n) { return hash(i - n, n) == hash(j - n, n); },
+                             [this, i, j](size_t k) { return first_[i - 1 - k] == first_[j - 1 - k]; });
+    }
+
+private:
+    static auto add(uint64_t a, uint64_t b) -> uint64_t
+    {
+        auto r = a + b;
+
+        return r >= lce_modulus ? r - lce_modulus : r;
+    }
+
+    static auto multiply(uint64_t a, uint64_t b) -> uint64_t
+    {
+        auto r = static_cast<unsigned __int128>(a) * b;
+        auto folded = static_cast<uint64_t>(r & lce_modulus) + static_cast<uint64_t>(r >> 61);
+
+        return folded >= lce_modulus ? folded - lce_modulus : folded;
+    }
+
+    auto hash(size_t i, size_t n) const -> uint64_t
+    {
+        return add(prefixes_[i + n], lce_modulus - multiply(prefixes_[i], powers_[n]));
+    }
+
+    template <typename MatchesN, typename MatchesAt>
+    static auto extend(size_t limit,
+                       MatchesN matches_n,
+                       MatchesAt matches_at) -> size_t
+    {
+        auto n = size_t{0};
+
+        for(; n < limit && n < lce_direct; ++n)
+        {
+            if(!matches_at(n))
+                return n;
+        }
+
+        if(n == limit)
+            return n;
+
+        // Gallop to a mismatch, then bisect: matches_n(lo) holds, matches_n(hi) doesn't.
+        auto lo = n;
+        auto hi = limit + 1;
+
+        for(auto step = n; lo + step <= limit; step *= 2)
+        {
+            if(!matches_n(lo + step))
+            {
+                hi = lo + step;
+                break;
+            }
+
+            lo += step;
+        }
+
+        while(hi - lo > 1)
+        {
+            auto mid = lo + (hi - lo) / 2;
+
+            if(matches_n(mid))
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        return lo;
+    }
+
+    RandomIt first_;
+    size_t size_;
+    std::vector<uint64_t> prefixes_; // Of the first i elements.
+    std::vector<uint64_t> powers_;
+};
+
+/* Length of the longest Lyndon word starting at each position, under the element order 'less'.
+ * A suffix ordered before every longer one it prefixes. O(n) suffix comparisons, amortized.
+ */
+template <typename RandomIt, typename Less>
+auto lyndon_array(RandomIt first,
+                  const LongestCommonExtension<RandomIt>& lce,
+                  Less less) -> std::vector<uint32_t>
+{
+    auto n = lce.size();
+    auto lyndon = std::vector<uint32_t>(n);
+
+    auto suffix_less = [&](size_t i, size_t j) // i < j.
+    {
+        auto l = lce.forward(i, j);
+
+        return j + l != n && less(first[i + l], first[j + l]);
+    };
+
+    for(auto i = n; i-- > 0;)
+    {
+        auto j = i + 1;
+
+        while(j < n && suffix_less(i, j))
+            j += lyndon[j];
+
+        lyndon[i] = static_cast<uint32_t>(j - i);
+    }
+
+    return lyndon;
+}
+
+struct Run
+{
+    size_t first;
+    size_t last;
+    size_t period;
+};
+
+inline
+bool operator<(const Run& lhs, const Run& rhs)
+{
+    return std::tie(lhs.first, lhs.last, lhs.period) < std::tie(rhs.first, rhs.last, rhs.period);
+}
+
+inline
+bool operator==(const Run& lhs, const Run& rhs)
+{
+    return lhs.first == rhs.first && lhs.last == rhs.last && lhs.period == rhs.period;
+}
+
+/* Every maximal repetition, by way of the runs theorem: each has a Lyndon root that is the longest
+ * Lyndon word starting at its position, under one element order or its reverse.
+ */
+template <typename RandomIt>
+auto find_runs(RandomIt first, RandomIt last) -> std::vector<Run>
+{
+    using Value = typename std::iterator_traits<RandomIt>::value_type;
+
+    auto lce = LongestCommonExtension<RandomIt>{first, last};
+    auto n = lce.size();
+    auto runs = std::vector<Run>{};
+
+    auto collect = [&](const std::vector<uint32_t>& lyndon)
+    {
+        for(auto i = size_t{0}; i < n; ++i)
+        {
+            auto p = size_t{lyndon[i]};
+            auto j = i + p;
+
+            if(j >= n)
+                continue; // The root must repeat.
+
+            auto l = i - lce.backward(i, j);
+            auto r = j + lce.forward(i, j);
+
+            if(r - l >= 2 * p)
+                runs.push_back(Run{l, r, p});
+        }
+    };
+
+    collect(lyndon_array(first, lce, std::less<Value>()));
+    collect(lyndon_array(first, lce, std::greater<Value>()));
+
+    std::sort(runs.begin(), runs.end());
+    runs.erase(std::unique(runs.begin(), runs.end()),
+               runs.end());
+
+    return runs;
+}
+
+} // namespace detail
+
+/**
+ * Finds the same kind of cycles as find_cycles_custom in O(n log n), where that may be quadratic.
+ *
+ * Every maximal repetition (run) of the sequence is found from its Lyndon roots. Runs are then
+ * claimed longest first, each trimmed to whole repeats of its period, ending where it ends. A run
+ * overlapping one already claimed gives way, but what's left of it is still a cycle if it repeats.
+ *
+ * Remarks:
+ * Requires random access. Every range is a whole number of repeats, and none overlap, which
+ * find_cycles_custom doesn't guarantee; otherwise, the two mostly agree.
+ */
+template <typename RandomIt>
+auto find_cycles_runs(RandomIt first, RandomIt last) -> std::vector<std::pair<RandomIt, RandomIt>>
+{
+    auto cs = std::vector<std::pair<RandomIt, RandomIt>>{};
+
+    if(std::distance(first, last) < 2)
+        return cs;
+
+    auto runs = detail::find_runs(first, last);
+
+    auto trimmed = [](const detail::Run& r) // To whole repeats.
+    {
+        return detail::Run{r.last - (r.last - r.first) / r.period * r.period, r.last, r.period};
+    };
+
+    auto shorter = [](const detail::Run& lhs, const detail::Run& rhs)
+    {
+        auto ll = lhs.last - lhs.first;
+        auto rl = rhs.last - rhs.first;
+
+        return ll < rl || (ll == rl && lhs.first < rhs.first); // On a tie, the rightmost.
+    };
+
+    auto pending = std::priority_queue<detail::Run, std::vector<detail::Run>, decltype(shorter)>{shorter};
+    auto claimed = std::map<size_t, detail::Run>{}; // Disjoint, by first.
+
+    for(const auto& r : runs)
+        pending.push(trimmed(r));
+
+    while(!pending.empty())
+    {
+        auto r = pending.top();
+        pending.pop();
+
+        auto it = claimed.lower_bound(r.first);
+
+        if(it != claimed.begin() && std::prev(it)->second.last > r.first)
+            --it;
+
+        if(it == claimed.end() || it->first >= r.last)
+        {
+            claimed.emplace(r.first, r);
+            continue;
+        }
+
+        // Requeue the unclaimed remainders that still repeat.
+        auto free = r.first;
+
+        for(; it != claimed.end() && it->first < r.last; ++it)
+        {
+            if(it->first >= free + 2 * r.period)
+                pending.push(trimmed(detail::Run{free, it->first, r.period}));
+
+            free = std::max(free, it->second.last);
+        }
+
+        if(r.last >= free + 2 * r.period)
+            pending.push(trimmed(detail::Run{free, r.last, r.period}));
+    }
+
+    for(const auto& c : claimed)
+    {
+        auto f = first + c.second.first;
+        auto l = first + c.second.last;
+
+        if(std::equal(f, l - c.second.period, f + c.second.period)) // Rules out a fingerprint collision.
+            cs.emplace_back(f, l);
+    }
+
+    return cs;
+}
+
 /**
  * Brent's Algorithm. See Wikipedia.
  */
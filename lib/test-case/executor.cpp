@@ -1,5 +1,6 @@
 #include <crete/executor.h>
 #include <crete/test_case.h>
+#include <crete/test_case_pack.h>
 
 #include <boost/filesystem/fstream.hpp>
 #include <boost/date_time.hpp>
@@ -8,6 +9,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
 #include <boost/process.hpp>
@@ -49,22 +51,41 @@ Executor::~Executor()
 
 void Executor::execute_all()
 {
+    // Loose test case files (one test per file).
     for(fs::directory_iterator iter(test_case_dir_), dend;
         iter != dend;
         ++iter)
     {
         current_tc_ = iter->path();
 
-        if(fs::is_regular_file(current_tc_))
+        if(fs::is_regular_file(current_tc_) && !is_test_case_pack_file(current_tc_))
         {
-            clean();
-            prepare();
-            execute();
+            fs::ifstream ifs(current_tc_, ios_base::in | ios_base::binary);
+            current_test_ = read_test_case(ifs);
 
-            print_status(cout);
-            ++iteration_;
+            execute_one();
         }
     }
+
+    // Packed test cases, as written by the dispatch TestPool.
+    TestCasePackReader reader(test_case_dir_);
+
+    for(size_t i = 1; reader.next(current_test_); ++i)
+    {
+        current_tc_ = test_case_dir_ / (test_case_pack_prefix + boost::lexical_cast<std::string>(i));
+
+        execute_one();
+    }
+}
+
+void Executor::execute_one()
+{
+    clean();
+    prepare();
+    execute();
+
+    print_status(cout);
+    ++iteration_;
 }
 
 void Executor::clean()
@@ -80,10 +101,7 @@ void Executor::clean()
 
 void Executor::prepare()
 {
-    fs::ifstream ifs(current_tc_);
-    TestCase tc = read_test_case(ifs);
-
-    const TestCaseElements tces = filter(tc.get_elements());
+    const TestCaseElements tces = filter(current_test_.get_elements());
 
     ElemTypeQueue queue = element_type_sequence();
     config::Arguments args = harness_config_.get_arguments();
@@ -236,12 +254,14 @@ void Executor::count_test_cases()
         iter != dend;
         ++iter)
     {
-        if(fs::is_regular_file(*iter))
+        if(fs::is_regular_file(*iter) && !is_test_case_pack_file(iter->path()))
         {
             ++test_case_count_;
         }
     }
 
+    test_case_count_ += TestCasePackReader(test_case_dir_).count();
+
     iteration_print_threshold_ = static_cast<std::size_t>(0.01f * test_case_count_);
 
     if(iteration_print_threshold_ == 0)
@@ -0,0 +1,221 @@
+#include <crete/lz.h>
+
+#include <cstring>
+
+using namespace std;
+
+namespace crete
+{
+
+namespace
+{
+
+const size_t lz_min_match = 4;
+const size_t lz_max_offset = 65535;
+const int lz_hash_log = 16;
+const size_t lz_last_literals = 5; // Matches never extend into the last few bytes...
+const size_t lz_match_search_limit = 12; // ...and never start this close to the end.
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v = 0;
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - lz_hash_log);
+}
+
+// Lengths that don't fit a token nibble continue in bytes of 255, ending with a byte < 255.
+void put_length(vector<uint8_t>& dst, size_t len)
+{
+    len -= 15;
+
+    while(len >= 255)
+    {
+        dst.push_back(255);
+        len -= 255;
+    }
+
+    dst.push_back(static_cast<uint8_t>(len));
+}
+
+// Sequence: token (literal count | match length - lz_min_match), literals, 16-bit offset.
+// The final sequence holds literals only; its end coincides with the end of the input.
+void put_sequence(vector<uint8_t>& dst,
+                  const uint8_t* literals,
+                  size_t literal_count,
+                  size_t offset,
+                  size_t match_length)
+{
+    const size_t token_pos = dst.size();
+    uint8_t token = 0;
+
+    dst.push_back(0);
+
+    if(literal_count >= 15)
+    {
+        token = 15 << 4;
+        put_length(dst, literal_count);
+    }
+    else
+    {
+        token = static_cast<uint8_t>(literal_count << 4);
+    }
+
+    dst.insert(dst.end(), literals, literals + literal_count);
+
+    if(match_length != 0)
+    {
+        const size_t ml = match_length - lz_min_match;
+
+        dst.push_back(static_cast<uint8_t>(offset & 0xff));
+        dst.push_back(static_cast<uint8_t>(offset >> 8));
+
+        if(ml >= 15)
+        {
+            token |= 15;
+            put_length(dst, ml);
+        }
+        else
+        {
+            token |= static_cast<uint8_t>(ml);
+        }
+    }
+
+    dst[token_pos] = token;
+}
+
+inline bool get_length(const uint8_t* src, size_t size, size_t& ip, size_t& len)
+{
+    uint8_t b = 0;
+
+    do
+    {
+        if(ip >= size)
+            return false;
+
+        b = src[ip++];
+        len += b;
+    } while(b == 255);
+
+    return true;
+}
+
+} // namespace
+
+void lz_compress(const uint8_t* src,
+                 size_t size,
+                 vector<uint8_t>& dst)
+{
+    size_t ip = 0;
+    size_t anchor = 0;
+
+    if(size >= lz_match_search_limit)
+    {
+        vector<uint32_t> table(size_t(1) << lz_hash_log, 0); // Position + 1; 0 is empty.
+        const size_t search_limit = size - lz_match_search_limit;
+        const size_t match_limit = size - lz_last_literals;
+
+        while(ip < search_limit)
+        {
+            const uint32_t seq = read32(src + ip);
+            uint32_t& entry = table[lz_hash(seq)];
+            const uint32_t candidate = entry;
+
+            entry = static_cast<uint32_t>(ip + 1);
+
+            if(candidate != 0 &&
+               ip - (candidate - 1) <= lz_max_offset &&
+               read32(src + candidate - 1) == seq)
+            {
+                const size_t ref = candidate - 1;
+                size_t len = lz_min_match;
+
+                while(ip + len < match_limit && src[ref + len] == src[ip + len])
+                {
+                    ++len;
+                }
+
+                put_sequence(dst, src + anchor, ip - anchor, ip - ref, len);
+
+                ip += len;
+                anchor = ip;
+            }
+            else
+            {
+                ip += 1 + ((ip - anchor) >> 6); // Skip ahead faster the longer nothing matches.
+            }
+        }
+    }
+
+    put_sequence(dst, src + anchor, size - anchor, 0, 0);
+}
+
+bool lz_decompress(const uint8_t* src,
+                   size_t size,
+                   uint8_t* dst,
+                   size_t dst_size)
+{
+    size_t ip = 0;
+    size_t op = 0;
+
+    while(ip < size)
+    {
+        const uint8_t token = src[ip++];
+        size_t literal_count = token >> 4u;
+
+        if(literal_count == 15 && !get_length(src, size, ip, literal_count))
+            return false;
+
+        if(literal_count > size - ip || literal_count > dst_size - op)
+            return false;
+
+        memcpy(dst + op, src + ip, literal_count);
+        ip += literal_count;
+        op += literal_count;
+
+        if(ip == size) // Final, literal-only sequence.
+            break;
+
+        if(size - ip < 2)
+            return false;
+
+        const size_t offset = size_t(src[ip]) | (size_t(src[ip + 1]) << 8);
+        ip += 2;
+
+        if(offset == 0 || offset > op)
+            return false;
+
+        size_t match_length = token & 15u;
+
+        if(match_length == 15 && !get_length(src, size, ip, match_length))
+            return false;
+
+        match_length += lz_min_match;
+
+        if(match_length > dst_size - op)
+            return false;
+
+        if(offset >= match_length)
+        {
+            memcpy(dst + op, dst + op - offset, match_length);
+        }
+        else // Overlapping copy repeats the last 'offset' bytes.
+        {
+            for(size_t i = 0; i < match_length; ++i)
+            {
+                dst[op + i] = dst[op - offset + i];
+            }
+        }
+
+        op += match_length;
+    }
+
+    return op == dst_size;
+}
+
+} // namespace crete
@@ -0,0 +1,356 @@
+#include <crete/test_case_pack.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace crete
+{
+
+namespace
+{
+
+// Returns true and sets 'segment' if 'p' is named pack-<segment><ext>.
+bool parse_segment_number(const fs::path& p, const string& ext, size_t& segment)
+{
+    const string name = p.filename().string();
+
+    if(!boost::starts_with(name, test_case_pack_prefix) ||
+       !boost::ends_with(name, ext))
+    {
+        return false;
+    }
+
+    const size_t prefix_len = strlen(test_case_pack_prefix);
+    const string num = name.substr(prefix_len, name.size() - prefix_len - ext.size());
+
+    if(num.empty() || num.find_first_not_of("0123456789") != string::npos)
+    {
+        return false;
+    }
+
+    segment = boost::lexical_cast<size_t>(num);
+
+    return true;
+}
+
+// Segment numbers of every index file in 'dir', ascending.
+vector<size_t> find_segments(const fs::path& dir)
+{
+    vector<size_t> segments;
+
+    if(!fs::exists(dir))
+    {
+        return segments;
+    }
+
+    for(fs::directory_iterator iter(dir), dend;
+        iter != dend;
+        ++iter)
+    {
+        size_t segment = 0;
+
+        if(fs::is_regular_file(*iter) &&
+           parse_segment_number(iter->path(), test_case_pack_index_ext, segment))
+        {
+            segments.push_back(segment);
+        }
+    }
+
+    sort(segments.begin(), segments.end());
+
+    return segments;
+}
+
+string errno_message(const string& what, const fs::path& p)
+{
+    return what + " failed (" + strerror(errno) + "): " + p.string();
+}
+
+} // namespace
+
+bool is_test_case_pack_file(const fs::path& p)
+{
+    size_t segment = 0;
+
+    return parse_segment_number(p, test_case_pack_data_ext, segment) ||
+           parse_segment_number(p, test_case_pack_index_ext, segment);
+}
+
+fs::path test_case_pack_data_path(const fs::path& dir, size_t segment)
+{
+    ostringstream ss;
+    ss << test_case_pack_prefix << setw(6) << setfill('0') << segment << test_case_pack_data_ext;
+
+    return dir / ss.str();
+}
+
+fs::path test_case_pack_index_path(const fs::path& dir, size_t segment)
+{
+    ostringstream ss;
+    ss << test_case_pack_prefix << setw(6) << setfill('0') << segment << test_case_pack_index_ext;
+
+    return dir / ss.str();
+}
+
+TestCasePackWriter::TestCasePackWriter(const fs::path& dir,
+                                       uint64_t segment_size) :
+    dir_(dir),
+    segment_size_(segment_size),
+    segment_(0),
+    data_fd_(-1),
+    index_fd_(-1),
+    data_offset_(0),
+    count_(0)
+{
+    if(!fs::exists(dir_))
+    {
+        fs::create_directories(dir_);
+    }
+
+    // Never append to segments left by a previous writer; they may end in a torn batch.
+    const vector<size_t> existing = find_segments(dir_);
+
+    if(!existing.empty())
+    {
+        segment_ = existing.back() + 1;
+    }
+
+    open_segment();
+}
+
+TestCasePackWriter::~TestCasePackWriter()
+{
+    try
+    {
+        sync();
+    }
+    catch(...)
+    {
+    }
+
+    close_segment();
+}
+
+void TestCasePackWriter::append(const TestCase& tc)
+{
+    if(data_offset_ >= segment_size_ && count_ > 0)
+    {
+        sync();
+        close_segment();
+
+        ++segment_;
+
+        open_segment();
+    }
+
+    const size_t begin = data_buf_.size();
+
+    {
+        ostringstream os(ios_base::out | ios_base::binary);
+        tc.write(os);
+        data_buf_ += os.str();
+    }
+
+    TestCasePackIndexEntry entry;
+    entry.offset = data_offset_;
+    entry.size = data_buf_.size() - begin;
+
+    index_buf_.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+    data_offset_ += entry.size;
+    ++count_;
+}
+
+void TestCasePackWriter::sync()
+{
+    if(index_buf_.empty())
+    {
+        return;
+    }
+
+    const fs::path data_path = test_case_pack_data_path(dir_, segment_);
+    const fs::path index_path = test_case_pack_index_path(dir_, segment_);
+
+    write_all(data_fd_, data_buf_, data_path);
+
+    if(fdatasync(data_fd_) != 0)
+    {
+        throw runtime_error(errno_message("fdatasync", data_path));
+    }
+
+    write_all(index_fd_, index_buf_, index_path);
+
+    if(fdatasync(index_fd_) != 0)
+    {
+        throw runtime_error(errno_message("fdatasync", index_path));
+    }
+
+    data_buf_.clear();
+    index_buf_.clear();
+}
+
+void TestCasePackWriter::open_segment()
+{
+    const fs::path data_path = test_case_pack_data_path(dir_, segment_);
+    const fs::path index_path = test_case_pack_index_path(dir_, segment_);
+
+    data_fd_ = open(data_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+
+    if(data_fd_ == -1)
+    {
+        throw runtime_error(errno_message("open", data_path));
+    }
+
+    index_fd_ = open(index_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+
+    if(index_fd_ == -1)
+    {
+        throw runtime_error(errno_message("open", index_path));
+    }
+
+    data_offset_ = 0;
+}
+
+void TestCasePackWriter::close_segment()
+{
+    if(data_fd_ != -1)
+    {
+        close(data_fd_);
+        data_fd_ = -1;
+    }
+
+    if(index_fd_ != -1)
+    {
+        close(index_fd_);
+        index_fd_ = -1;
+    }
+}
+
+void TestCasePackWriter::write_all(int fd, const string& buf, const fs::path& p)
+{
+    const char* data = buf.data();
+    size_t left = buf.size();
+
+    while(left > 0)
+    {
+        ssize_t n = ::write(fd, data, left);
+
+        if(n == -1)
+        {
+            if(errno == EINTR)
+                continue;
+
+            throw runtime_error(errno_message("write", p));
+        }
+
+        data += n;
+        left -= n;
+    }
+}
+
+TestCasePackReader::TestCasePackReader(const fs::path& dir) :
+    dir_(dir),
+    current_(0),
+    open_segment_(0)
+{
+    const vector<size_t> segments = find_segments(dir_);
+
+    for(vector<size_t>::const_iterator it = segments.begin();
+        it != segments.end();
+        ++it)
+    {
+        segments_.push_back(test_case_pack_data_path(dir_, *it));
+
+        load_segment_index(segments_.size() - 1);
+    }
+
+    open_segment_ = segments_.size();
+}
+
+bool TestCasePackReader::next(TestCase& tc)
+{
+    if(current_ == entries_.size())
+    {
+        return false;
+    }
+
+    const Entry& e = entries_[current_];
+
+    if(e.segment != open_segment_)
+    {
+        ifs_.close();
+        ifs_.clear();
+        ifs_.open(segments_[e.segment], ios_base::in | ios_base::binary);
+
+        if(!ifs_.good())
+        {
+            throw runtime_error("failed to open file: " + segments_[e.segment].string());
+        }
+
+        open_segment_ = e.segment;
+    }
+
+    // Parse from a copy of just this entry: read_test_case() sanity checks against the whole stream's size.
+    string buf(e.location.size, '\0');
+
+    ifs_.seekg(e.location.offset, ios_base::beg);
+
+    if(!ifs_.read(&buf[0], buf.size()))
+    {
+        throw runtime_error("failed to read test case from: " + segments_[e.segment].string());
+    }
+
+    istringstream is(buf, ios_base::in | ios_base::binary);
+
+    tc = read_test_case(is);
+
+    ++current_;
+
+    return true;
+}
+
+void TestCasePackReader::load_segment_index(size_t segment)
+{
+    const fs::path& data_path = segments_[segment];
+    fs::path index_path = data_path;
+    index_path.replace_extension(test_case_pack_index_ext);
+
+    const uint64_t data_size = fs::exists(data_path) ? fs::file_size(data_path) : 0;
+
+    fs::ifstream ifs(index_path, ios_base::in | ios_base::binary);
+
+    if(!ifs.good())
+    {
+        throw runtime_error("failed to open file: " + index_path.string());
+    }
+
+    Entry e;
+    e.segment = segment;
+
+    // A torn trailing entry, or one pointing past the data, belongs to a batch that never completed.
+    while(ifs.read(reinterpret_cast<char*>(&e.location), sizeof(e.location)))
+    {
+        if(e.location.offset + e.location.size > data_size)
+        {
+            break;
+        }
+
+        entries_.push_back(e);
+    }
+}
+
+} // namespace crete
@@ -0,0 +1,255 @@
+#include <crete/trace_channel.h>
+
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace crete
+{
+
+namespace
+{
+
+const uint64_t trace_channel_max_payload = uint64_t(1) << 30; // Anything larger is a corrupt header.
+
+string errno_message(const string& what)
+{
+    return "trace channel: " + what + " failed (" + strerror(errno) + ")";
+}
+
+sockaddr_un socket_address(const fs::path& path)
+{
+    sockaddr_un addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+
+    if(path.string().size() >= sizeof(addr.sun_path))
+        throw runtime_error("trace channel: socket path too long: " + path.string());
+
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    return addr;
+}
+
+bool wait_readable(int fd, int timeout_ms)
+{
+    pollfd pfd = pollfd();
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    for(;;)
+    {
+        int n = poll(&pfd, 1, timeout_ms);
+
+        if(n == -1)
+        {
+            if(errno == EINTR)
+                continue;
+
+            throw runtime_error(errno_message("poll"));
+        }
+
+        return n > 0;
+    }
+}
+
+} // namespace
+
+TraceChannel::TraceChannel() :
+    listen_fd_(-1),
+    fd_(-1)
+{
+}
+
+TraceChannel::~TraceChannel()
+{
+    close();
+}
+
+void TraceChannel::listen(const fs::path& path)
+{
+    const sockaddr_un addr = socket_address(path);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(listen_fd_ == -1)
+        throw runtime_error(errno_message("socket"));
+
+    unlink(path.c_str());
+
+    if(bind(listen_fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+       ::listen(listen_fd_, 1) != 0)
+    {
+        const string msg = errno_message("bind " + path.string());
+
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+
+        throw runtime_error(msg);
+    }
+
+    listen_path_ = path;
+}
+
+bool TraceChannel::accept(int timeout_ms)
+{
+    if(fd_ != -1)
+        return true;
+
+    if(listen_fd_ == -1 || !wait_readable(listen_fd_, timeout_ms))
+        return false;
+
+    fd_ = ::accept(listen_fd_, 0, 0);
+
+    if(fd_ == -1)
+        throw runtime_error(errno_message("accept"));
+
+    return true;
+}
+
+void TraceChannel::connect(const fs::path& path)
+{
+    const sockaddr_un addr = socket_address(path);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(fd_ == -1)
+        throw runtime_error(errno_message("socket"));
+
+    if(::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        const string msg = errno_message("connect " + path.string());
+
+        ::close(fd_);
+        fd_ = -1;
+
+        throw runtime_error(msg);
+    }
+}
+
+bool TraceChannel::is_connected() const
+{
+    return fd_ != -1;
+}
+
+void TraceChannel::send(uint32_t type, const string& payload)
+{
+    if(fd_ == -1)
+        throw runtime_error("trace channel: not connected");
+
+    TraceChannelHeader header = TraceChannelHeader();
+    header.type = type;
+    header.size = payload.size();
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(payload.data());
+    iov[1].iov_len = payload.size();
+
+    msghdr msg = msghdr();
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    while(msg.msg_iovlen > 0)
+    {
+        ssize_t n = sendmsg(fd_, &msg, MSG_NOSIGNAL); // A gone peer is an error, not a SIGPIPE.
+
+        if(n == -1)
+        {
+            if(errno == EINTR)
+                continue;
+
+            throw runtime_error(errno_message("send"));
+        }
+
+        while(msg.msg_iovlen > 0 && static_cast<size_t>(n) >= msg.msg_iov->iov_len)
+        {
+            n -= msg.msg_iov->iov_len;
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+
+        if(msg.msg_iovlen > 0)
+        {
+            msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + n;
+            msg.msg_iov->iov_len -= n;
+        }
+    }
+}
+
+bool TraceChannel::receive(uint32_t& type, string& payload, int timeout_ms)
+{
+    if(fd_ == -1)
+        throw runtime_error("trace channel: not connected");
+
+    if(!wait_readable(fd_, timeout_ms))
+        return false;
+
+    // Once a message has begun to arrive, the rest of it follows.
+    TraceChannelHeader header;
+    read_all(&header, sizeof(header));
+
+    if(header.size > trace_channel_max_payload)
+        throw runtime_error("trace channel: malformed message");
+
+    payload.resize(header.size);
+
+    if(header.size > 0)
+        read_all(&payload[0], header.size);
+
+    type = header.type;
+
+    return true;
+}
+
+void TraceChannel::close()
+{
+    if(fd_ != -1)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    if(listen_fd_ != -1)
+    {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+
+        unlink(listen_path_.c_str());
+    }
+}
+
+void TraceChannel::read_all(void* data, size_t size)
+{
+    char* pos = static_cast<char*>(data);
+
+    while(size > 0)
+    {
+        ssize_t n = ::read(fd_, pos, size);
+
+        if(n == -1)
+        {
+            if(errno == EINTR)
+                continue;
+
+            throw runtime_error(errno_message("read"));
+        }
+
+        if(n == 0)
+            throw runtime_error("trace channel: peer disconnected");
+
+        pos += n;
+        size -= n;
+    }
+}
+
+} // namespace crete
@@ -0,0 +1,421 @@
+#include <crete/trace_container.h>
+#include <crete/lz.h>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace crete
+{
+
+namespace
+{
+
+const char trace_container_magic[4] = {'C', 'R', 'T', 'C'};
+
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t index_offset;
+    uint32_t count;
+    uint32_t index_crc;
+    uint64_t file_size;
+};
+
+const uint64_t section_alignment = 8;
+
+uint32_t crc32(const void* data, size_t size)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+
+    return crc.checksum();
+}
+
+string errno_message(const string& what, const fs::path& p)
+{
+    return what + " failed (" + strerror(errno) + "): " + p.string();
+}
+
+void write_all(int fd, const void* data, size_t size, const fs::path& p)
+{
+    const char* pos = static_cast<const char*>(data);
+
+    while(size > 0)
+    {
+        ssize_t n = ::write(fd, pos, size);
+
+        if(n == -1)
+        {
+            if(errno == EINTR)
+                continue;
+
+            throw runtime_error(errno_message("write", p));
+        }
+
+        pos += n;
+        size -= n;
+    }
+}
+
+} // namespace
+
+TraceContainerWriter::TraceContainerWriter(const fs::path& path) :
+    path_(path),
+    tmp_path_(path.string() + ".tmp"),
+    fd_(-1),
+    offset_(sizeof(Header))
+{
+    fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if(fd_ == -1)
+        throw runtime_error(errno_message("open", tmp_path_));
+
+    const Header placeholder = Header(); // Filled in by close().
+
+    write_all(fd_, &placeholder, sizeof(placeholder), tmp_path_);
+}
+
+TraceContainerWriter::~TraceContainerWriter()
+{
+    if(fd_ != -1)
+    {
+        ::close(fd_);
+        unlink(tmp_path_.c_str());
+    }
+}
+
+void TraceContainerWriter::add(const string& name, const void* data, size_t size, bool compress)
+{
+    TraceContainerIndexEntry entry = TraceContainerIndexEntry();
+
+    if(name.empty() || name.size() >= sizeof(entry.name))
+        throw runtime_error("invalid trace section name: " + name);
+
+    for(vector<TraceContainerIndexEntry>::const_iterator it = index_.begin(); it != index_.end(); ++it)
+    {
+        if(name == it->name)
+            throw runtime_error("duplicate trace section: " + name);
+    }
+
+    const uint8_t* stored = static_cast<const uint8_t*>(data);
+    vector<uint8_t> packed;
+
+    if(compress && size > 0)
+    {
+        lz_compress(stored, size, packed);
+
+        if(packed.size() < size)
+        {
+            stored = packed.data();
+            entry.flags |= trace_section_lz;
+        }
+    }
+
+    memcpy(entry.name, name.data(), name.size());
+    entry.offset = offset_;
+    entry.stored_size = (entry.flags & trace_section_lz) ? packed.size() : size;
+    entry.size = size;
+    entry.crc = crc32(stored, entry.stored_size);
+
+    const uint64_t padding = (section_alignment - entry.stored_size % section_alignment) % section_alignment;
+    const char zeros[section_alignment] = {};
+
+    write_all(fd_, stored, entry.stored_size, tmp_path_);
+    write_all(fd_, zeros, padding, tmp_path_);
+
+    offset_ += entry.stored_size + padding;
+
+    index_.push_back(entry);
+}
+
+void TraceContainerWriter::add(const string& name, const string& data, bool compress)
+{
+    add(name, data.data(), data.size(), compress);
+}
+
+void TraceContainerWriter::close()
+{
+    const size_t index_size = index_.size() * sizeof(TraceContainerIndexEntry);
+
+    write_all(fd_, index_.data(), index_size, tmp_path_);
+
+    Header header = Header();
+    memcpy(header.magic, trace_container_magic, sizeof(header.magic));
+    header.version = trace_container_version;
+    header.index_offset = offset_;
+    header.count = static_cast<uint32_t>(index_.size());
+    header.index_crc = crc32(index_.data(), index_size);
+    header.file_size = offset_ + index_size;
+
+    if(pwrite(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+        throw runtime_error(errno_message("pwrite", tmp_path_));
+
+    if(fdatasync(fd_) != 0)
+        throw runtime_error(errno_message("fdatasync", tmp_path_));
+
+    ::close(fd_);
+    fd_ = -1;
+
+    fs::rename(tmp_path_, path_);
+}
+
+TraceContainer::TraceContainer(const fs::path& path) :
+    path_(path),
+    map_(MAP_FAILED),
+    map_size_(0),
+    base_(0),
+    index_(0),
+    count_(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd == -1)
+        throw runtime_error(errno_message("open", path));
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw runtime_error(errno_message("fstat", path));
+    }
+
+    map_size_ = static_cast<size_t>(st.st_size);
+
+    if(map_size_ < sizeof(Header))
+    {
+        close(fd);
+        throw runtime_error("truncated trace container: " + path.string());
+    }
+
+    map_ = mmap(0, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if(map_ == MAP_FAILED)
+    {
+        int err = errno;
+        close(fd);
+        throw runtime_error("failed to map file (" + string(strerror(err)) + "): " + path.string());
+    }
+
+    close(fd); // The mapping outlives the descriptor.
+
+    base_ = static_cast<const char*>(map_);
+
+    try
+    {
+        read_index();
+    }
+    catch(...)
+    {
+        munmap(map_, map_size_);
+        throw;
+    }
+
+    madvise(map_, map_size_, MADV_WILLNEED);
+}
+
+TraceContainer::TraceContainer(const fs::path& path, const char* data, size_t size) :
+    path_(path),
+    map_(MAP_FAILED),
+    map_size_(size),
+    base_(data),
+    index_(0),
+    count_(0)
+{
+    if(map_size_ < sizeof(Header))
+        throw runtime_error("truncated trace container: " + path.string());
+
+    read_index();
+}
+
+void TraceContainer::read_index()
+{
+    Header header;
+    memcpy(&header, base_, sizeof(header));
+
+    const uint64_t index_size = uint64_t(header.count) * sizeof(TraceContainerIndexEntry);
+
+    if(memcmp(header.magic, trace_container_magic, sizeof(header.magic)) != 0 ||
+       header.version != trace_container_version ||
+       header.file_size != map_size_ ||
+       header.index_offset % section_alignment != 0 ||
+       header.index_offset > map_size_ ||
+       index_size != map_size_ - header.index_offset)
+    {
+        throw runtime_error("malformed trace container: " + path_.string());
+    }
+
+    if(crc32(base_ + header.index_offset, index_size) != header.index_crc)
+        throw runtime_error("trace container index failed its checksum: " + path_.string());
+
+    index_ = reinterpret_cast<const TraceContainerIndexEntry*>(base_ + header.index_offset);
+    count_ = header.count;
+
+    for(uint32_t i = 0; i < count_; ++i)
+    {
+        const TraceContainerIndexEntry& e = index_[i];
+
+        if(e.name[sizeof(e.name) - 1] != '\0' ||
+           e.offset > header.index_offset ||
+           e.stored_size > header.index_offset - e.offset ||
+           (!(e.flags & trace_section_lz) && e.stored_size != e.size))
+        {
+            throw runtime_error("malformed trace container: " + path_.string());
+        }
+    }
+
+    verified_.resize(count_, false);
+}
+
+TraceContainer::~TraceContainer()
+{
+    if(map_ != MAP_FAILED)
+        munmap(map_, map_size_);
+}
+
+bool TraceContainer::contains(const string& name) const
+{
+    for(uint32_t i = 0; i < count_; ++i)
+    {
+        if(name == index_[i].name)
+            return true;
+    }
+
+    return false;
+}
+
+TraceContainer::Section TraceContainer::section(const string& name) const
+{
+    const TraceContainerIndexEntry& e = find(name);
+    const uint32_t i = static_cast<uint32_t>(&e - index_);
+    const char* stored = base_ + e.offset;
+
+    if(!verified_[i])
+    {
+        if(crc32(stored, e.stored_size) != e.crc)
+            throw runtime_error("trace section " + name + " failed its checksum: " + path_.string());
+
+        verified_[i] = true;
+    }
+
+    Section s;
+    s.size = e.size;
+
+    if(!(e.flags & trace_section_lz))
+    {
+        s.data = stored;
+
+        return s;
+    }
+
+    map<uint32_t, vector<uint64_t> >::iterator it = decompressed_.find(i);
+
+    if(it == decompressed_.end())
+    {
+        vector<uint64_t> buf((e.size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+
+        if(!lz_decompress(reinterpret_cast<const uint8_t*>(stored), e.stored_size,
+                          reinterpret_cast<uint8_t*>(buf.data()), e.size))
+        {
+            throw runtime_error("corrupt trace section " + name + ": " + path_.string());
+        }
+
+        it = decompressed_.insert(make_pair(i, vector<uint64_t>())).first;
+        it->second.swap(buf);
+    }
+
+    s.data = reinterpret_cast<const char*>(it->second.data());
+
+    return s;
+}
+
+vector<string> TraceContainer::names() const
+{
+    vector<string> names;
+
+    for(uint32_t i = 0; i < count_; ++i)
+        names.push_back(index_[i].name);
+
+    return names;
+}
+
+void TraceContainer::extract(const string& name, const fs::path& p) const
+{
+    const Section s = section(name);
+
+    fs::ofstream ofs(p, ios_base::out | ios_base::binary | ios_base::trunc);
+
+    if(!ofs.write(s.data, s.size))
+        throw runtime_error("failed to write file: " + p.string());
+}
+
+const TraceContainerIndexEntry& TraceContainer::find(const string& name) const
+{
+    for(uint32_t i = 0; i < count_; ++i)
+    {
+        if(name == index_[i].name)
+            return index_[i];
+    }
+
+    throw runtime_error("missing trace section " + name + ": " + path_.string());
+}
+
+void TraceArtifactStream::SectionBuf::set(const TraceContainer::Section& s)
+{
+    char* begin = const_cast<char*>(s.data); // Only ever read: the get area of a streambuf isn't const.
+
+    setg(begin, begin, begin + s.size);
+}
+
+TraceArtifactStream::TraceArtifactStream(const fs::path& dir, const string& name) :
+    istream(0)
+{
+    const fs::path container_path = dir / trace_container_file_name;
+
+    if(fs::exists(container_path))
+    {
+        container_.reset(new TraceContainer(container_path));
+
+        if(container_->contains(name))
+        {
+            section_buf_.set(container_->section(name));
+            rdbuf(&section_buf_);
+        }
+        else
+        {
+            setstate(ios_base::failbit);
+        }
+
+        return;
+    }
+
+    if(file_buf_.open((dir / name).c_str(), ios_base::in | ios_base::binary))
+        rdbuf(&file_buf_);
+    else
+        setstate(ios_base::failbit);
+}
+
+bool trace_artifact_exists(const fs::path& dir, const string& name)
+{
+    const fs::path container_path = dir / trace_container_file_name;
+
+    if(fs::exists(container_path))
+        return TraceContainer(container_path).contains(name);
+
+    return fs::exists(dir / name);
+}
+
+} // namespace crete
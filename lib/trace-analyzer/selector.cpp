@@ -89,67 +89,251 @@ auto calculate_least_treaded_score(const Trace::Blocks& blocks) -> Score
     return static_cast<Score>(sum) / blocks.size();
 }
 
-Selector::Selector() :
-    random_engine_(std::time(0)) // Random seed based on execution time.
+auto calculate_least_treaded_score(const TraceGraph::SubtreeStats& stats) -> Score
 {
+    // The sum above is that of each block's frequency, over every occurrence: the sum of squared frequencies.
+    assert(stats.blocks > 0);
 
+    return stats.sketch.second_moment() / stats.blocks;
 }
 
-Selector::~Selector()
+auto ScoreHeap::push(const Trace::ID& id,
+                     Score score,
+                     uint32_t tiebreak) -> bool
 {
+    if(handles_.count(id) != 0)
+    {
+        return false;
+    }
+
+    auto h = Handle{};
 
+    if(free_.empty())
+    {
+        h = static_cast<Handle>(nodes_.size());
+        nodes_.push_back(Node{id, score, tiebreak, 0});
+    }
+    else
+    {
+        h = free_.back();
+        free_.pop_back();
+        nodes_[h] = Node{id, score, tiebreak, 0};
+    }
+
+    handles_.insert({id, h});
+    heap_.push_back(h);
+    place(heap_.size() - 1, h);
+    sift_up(heap_.size() - 1);
+
+    return true;
 }
 
-auto Selector::submit(const Trace& trace) -> void
+auto ScoreHeap::pop() -> boost::optional<Entry>
+{
+    if(heap_.empty())
+    {
+        return boost::optional<Entry>{};
+    }
+
+    const auto& top = nodes_[heap_.front()];
+    auto entry = Entry{top.id, top.score};
+
+    handles_.erase(top.id);
+    remove_at(0);
+
+    return boost::optional<Entry>{entry};
+}
+
+auto ScoreHeap::erase(const Trace::ID& id) -> bool
 {
-    auto score = calculate_score(trace);
+    auto it = handles_.find(id);
 
-    auto success = trace_scores_.insert({trace, score}).second;
+    if(it == end(handles_))
+    {
+        return false;
+    }
 
-    assert(success);
+    auto position = nodes_[it->second].position;
+
+    handles_.erase(it);
+    remove_at(position);
+
+    return true;
 }
 
-void Selector::remove(const Trace& trace)
+auto ScoreHeap::size() const -> std::size_t
 {
-    trace_scores_.erase(trace);
+    return heap_.size();
 }
 
-auto Selector::next() -> const boost::optional<Trace>
+auto ScoreHeap::empty() const -> bool
 {
-    if(trace_scores_.size() == 0)
+    return heap_.empty();
+}
+
+auto ScoreHeap::entries() const -> std::vector<Entry>
+{
+    auto entries = std::vector<Entry>{};
+
+    entries.reserve(heap_.size());
+
+    for(const auto& h : heap_)
     {
-        return boost::optional<Trace>{};
+        entries.emplace_back(nodes_[h].id, nodes_[h].score);
     }
 
-    auto scores = std::multimap<Score, Trace>{};
+    return entries;
+}
+
+auto ScoreHeap::less(Handle lhs, Handle rhs) const -> bool
+{
+    const auto& l = nodes_[lhs];
+    const auto& r = nodes_[rhs];
 
-    for(const auto& t : trace_scores_)
+    if(l.score != r.score)
     {
-        scores.insert({t.second, t.first});
+        return l.score < r.score;
     }
 
-    const auto& lowest_score = begin(scores)->first;
+    return l.tiebreak < r.tiebreak;
+}
 
-    auto selection_range = scores.equal_range(lowest_score);
+auto ScoreHeap::place(std::size_t position, Handle h) -> void
+{
+    heap_[position] = h;
+    nodes_[h].position = position;
+}
 
-    auto index = generate_random(0,
-                                 std::distance(selection_range.first,
-                                               selection_range.second) - 1);
+auto ScoreHeap::sift_up(std::size_t position) -> void
+{
+    auto h = heap_[position];
 
-    std::advance(selection_range.first, index);
+    while(position > 0)
+    {
+        auto parent = (position - 1) / 2;
 
-    assert(selection_range.first != selection_range.second);
+        if(!less(h, heap_[parent]))
+        {
+            break;
+        }
 
-    auto selected = selection_range.first->second;
+        place(position, heap_[parent]);
+        position = parent;
+    }
 
-    remove(selected);
+    place(position, h);
+}
+
+auto ScoreHeap::sift_down(std::size_t position) -> void
+{
+    auto h = heap_[position];
+    auto size = heap_.size();
+
+    for(;;)
+    {
+        auto child = 2 * position + 1;
+
+        if(child >= size)
+        {
+            break;
+        }
+
+        if(child + 1 < size && less(heap_[child + 1], heap_[child]))
+        {
+            ++child;
+        }
+
+        if(!less(heap_[child], h))
+        {
+            break;
+        }
 
-    return boost::optional<Trace>{selected};
+        place(position, heap_[child]);
+        position = child;
+    }
+
+    place(position, h);
+}
+
+auto ScoreHeap::remove_at(std::size_t position) -> void
+{
+    auto h = heap_[position];
+    auto last = heap_.back();
+
+    heap_.pop_back();
+    nodes_[h].id = Trace::ID{}; // Only the handle is kept, for reuse.
+    free_.push_back(h);
+
+    if(position == heap_.size()) // Removed the last.
+    {
+        return;
+    }
+
+    place(position, last);
+    sift_up(position);
+    sift_down(nodes_[last].position);
+}
+
+Selector::Selector() :
+    random_engine_(std::time(0)) // Random seed based on execution time.
+{
+
+}
+
+Selector::~Selector()
+{
+
+}
+
+auto Selector::submit(const Trace& trace) -> void
+{
+    submit(trace, calculate_score(trace));
+}
+
+auto Selector::submit(const Trace& trace,
+                      Score score) -> void
+{
+    auto success = trace_scores_.push(trace.get_id(),
+                                      score,
+                                      random_engine_());
+
+    assert(success);
+}
+
+void Selector::remove(const Trace& trace)
+{
+    trace_scores_.erase(trace.get_id());
+}
+
+auto Selector::next() -> const boost::optional<Trace>
+{
+    auto selected = trace_scores_.pop(); // Ties for the lowest score are broken at random.
+
+    if(!selected)
+    {
+        return boost::optional<Trace>{};
+    }
+
+    return boost::optional<Trace>{Trace{selected->first, Trace::Blocks{}}}; // Selection is by ID.
+}
+
+auto Selector::prescore(const Trace& trace) const -> boost::optional<Score>
+{
+    (void)trace;
+
+    return boost::optional<Score>{};
 }
 
 auto Selector::trace_scores() const -> Selector::TraceScoreMap
 {
-    return trace_scores_;
+    auto scores = TraceScoreMap{};
+
+    for(const auto& e : trace_scores_.entries())
+    {
+        scores.insert({Trace{e.first, Trace::Blocks{}}, e.second});
+    }
+
+    return scores;
 }
 
 auto Selector::generate_random(std::size_t low, std::size_t high) -> std::size_t
@@ -168,6 +352,11 @@ auto WeightGroupSelector::calculate_score(const Trace& trace) -> Score
     return score;
 }
 
+auto WeightGroupSelector::prescore(const Trace& trace) const -> boost::optional<Score>
+{
+    return boost::optional<Score>{calculate_weight_group_score(trace.get_blocks())};
+}
+
 RecursiveDescentSelector::RecursiveDescentSelector(TraceGraph& graph) :
     graph_(graph)
 {
@@ -182,11 +371,11 @@ auto RecursiveDescentSelector::submit(const Trace& trace) -> void
 auto RecursiveDescentSelector::next() -> const boost::optional<Trace>
 {
     // This is calculating the score based on prefer-less-treaded.
-    auto score_fn = [](const Trace::Blocks& blocks) {
-         return calculate_least_treaded_score(blocks);
+    auto score_fn = [](const TraceGraph::SubtreeStats& stats) {
+         return calculate_least_treaded_score(stats);
     };
 
-    return boost::optional<Trace>{graph_.select_by_recursive_score(score_fn)};
+    return boost::optional<Trace>{graph_.select_by_subtree_score(score_fn)};
 }
 
 auto RecursiveDescentSelector::calculate_score(const Trace& trace) -> Score
@@ -245,6 +434,11 @@ auto LeastTreadedSelector::calculate_score(const Trace& trace) -> Score
     return score;
 }
 
+auto LeastTreadedSelector::prescore(const Trace& trace) const -> boost::optional<Score>
+{
+    return boost::optional<Score>{calculate_least_treaded_score(trace.get_blocks())};
+}
+
 void FIFOSelector::submit(const Trace& trace)
 {
     trace_queue_.emplace_front(trace);
@@ -4,11 +4,37 @@
 #include <boost/range/irange.hpp>
 
 #include <crete/util/cycle.h>
+#include <crete/trace_view.h>
+#include <crete/trace_container.h>
+#include <crete/trace_graph.h>
+#include <crete/trace_analyzer.h>
+#include <crete/selector.h>
+#include <crete/test_case.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <chrono>
 #include <numeric>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+
+#include <malloc.h>
+
+// mallinfo2() is glibc 2.33 on; older ones have only mallinfo(), with int fields.
+#if defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2,33)
+#define CRETE_HAVE_MALLINFO2
+#endif
+#endif
 
 using namespace std;
 using namespace crete;
@@ -1655,6 +1681,161 @@ BOOST_AUTO_TEST_CASE(real_trace_3)
     }) / static_cast<float>(v.size()) << endl;
 }
 
+BOOST_AUTO_TEST_CASE(runs_agree_with_custom)
+{
+    auto examples = vector<string>{"xabcabcx",
+                                   "xabcabc",
+                                   "xabcdefabcx",
+                                   "xabcabcyabcabcx",
+                                   "xxxxxx",
+                                   "axxxxxxa",
+                                   "abababababa",
+                                   "abaaxyzabay",
+                                   "abaaxyzaba",
+                                   "xabcabcxabcabcyz",
+                                   "xabcabcbc",
+                                   "xabcabcdebcde",
+                                   "xabcabcabcbcbc",
+                                   "xabababcabcabc"};
+
+    for(auto& v : examples)
+    {
+        auto expected = find_cycles_custom(v.begin(), v.end());
+        auto cs = find_cycles_runs(v.begin(), v.end());
+
+        sort(expected.begin(), expected.end());
+
+        BOOST_CHECK_MESSAGE(cs == expected, v);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(real_trace_1_runs)
+{
+    ifstream ifs("tb-seq-1.bin", ios::in | ios::binary);
+
+    BOOST_REQUIRE(ifs.good());
+
+    auto addr = uint64_t{0u};
+    auto v = vector<uint64_t>{};
+
+    while(!ifs.eof())
+    {
+        ifs.read(reinterpret_cast<char*>(&addr), sizeof(uint64_t));
+        if(!ifs.eof())
+            v.emplace_back(addr);
+    }
+
+    auto expected = find_cycles_custom(v.begin(), v.end());
+    auto cs = find_cycles_runs(v.begin(), v.end());
+
+    sort(expected.begin(), expected.end());
+
+    // The same cycles as real_trace_1.
+    BOOST_CHECK(cs == expected);
+    BOOST_REQUIRE_EQUAL(cs.size(), 5);
+    BOOST_CHECK_EQUAL(distance(v.begin(), cs[0].first), 109);
+    BOOST_CHECK_EQUAL(distance(v.begin(), cs[4].second), 604);
+}
+
+BOOST_AUTO_TEST_CASE(real_trace_2_runs)
+{
+    ifstream ifs("tb-seq-2.bin", ios::in | ios::binary);
+
+    BOOST_REQUIRE(ifs.good());
+
+    auto addr = uint64_t{0u};
+    auto v = vector<uint64_t>{};
+
+    while(!ifs.eof())
+    {
+        ifs.read(reinterpret_cast<char*>(&addr), sizeof(uint64_t));
+        if(!ifs.eof())
+            v.emplace_back(addr);
+    }
+
+    auto covered = [](const vector<pair<vector<uint64_t>::iterator, vector<uint64_t>::iterator>>& cs)
+    {
+        return accumulate(cs.begin(), cs.end(), 0u, [](unsigned c, const pair<vector<uint64_t>::iterator, vector<uint64_t>::iterator>& p)
+        {
+            return c + distance(p.first, p.second);
+        });
+    };
+
+    auto st = chrono::high_resolution_clock::now();
+    auto cs = find_cycles_runs(v.begin(), v.end());
+    auto et = chrono::high_resolution_clock::now();
+    auto unoptimized = unoptimized::find_cycles_custom(v.begin(), v.end());
+    auto uet = chrono::high_resolution_clock::now();
+    auto custom = find_cycles_custom(v.begin(), v.end());
+
+    // Disjoint, and each a whole number of repeats of some period.
+    for(auto i = size_t{0}; i < cs.size(); ++i)
+    {
+        if(i > 0)
+            BOOST_CHECK(cs[i - 1].second <= cs[i].first);
+
+        auto length = distance(cs[i].first, cs[i].second);
+        auto repeats = false;
+
+        for(auto p = 1; !repeats && 2 * p <= length; ++p)
+            repeats = length % p == 0 && equal(cs[i].first, cs[i].second - p, cs[i].first + p);
+
+        BOOST_CHECK(repeats);
+    }
+
+    // Unoptimized finds a few more, but overlapping, so they can't all be compressed.
+    BOOST_CHECK_GE(covered(cs), covered(custom));
+
+    cout << "cycles found: " << cs.size() << " (unoptimized: " << unoptimized.size() << ")" << endl;
+    cout << "time (ms): " << chrono::duration_cast<chrono::milliseconds>(et - st).count()
+         << " (unoptimized: " << chrono::duration_cast<chrono::milliseconds>(uet - et).count() << ")" << endl;
+    cout << "reduction: " << covered(cs) / static_cast<float>(v.size())
+         << " (unoptimized: " << covered(unoptimized) / static_cast<float>(v.size()) << ")" << endl;
+}
+
+// compress() hashes the cycles find_cycles_custom picks, which differ from find_cycles_runs on tb-seq-2.
+BOOST_AUTO_TEST_CASE(compress_real_trace_2)
+{
+    ifstream ifs("tb-seq-2.bin", ios::in | ios::binary);
+
+    BOOST_REQUIRE(ifs.good());
+
+    auto addr = uint64_t{0u};
+    auto v = vector<uint64_t>{};
+
+    while(!ifs.eof())
+    {
+        ifs.read(reinterpret_cast<char*>(&addr), sizeof(uint64_t));
+        if(!ifs.eof())
+            v.emplace_back(addr);
+    }
+
+    auto cs = find_cycles_custom(v.begin() + 1, v.end());
+
+    sort(cs.begin(), cs.end());
+
+    auto expected = vector<uint64_t>{};
+    auto it = v.begin();
+
+    for(auto& range : cs)
+    {
+        if(it < range.first) // Some of these ranges overlap: the blocks shared go into both hashes.
+            expected.insert(expected.end(), it, range.first);
+
+        expected.emplace_back(boost::hash_range(range.first, range.second));
+
+        it = range.second;
+    }
+
+    expected.insert(expected.end(), it, v.end());
+
+    auto trace = Trace("tb-seq-2", v);
+    auto compressed = compress(trace);
+
+    BOOST_CHECK(compressed.get_blocks() == expected);
+    BOOST_CHECK(trace.get_blocks() == v);
+}
+
 #if defined(unoptimized)
 BOOST_AUTO_TEST_CASE(real_trace_2_unoptimized)
 {
@@ -2987,3 +3168,1006 @@ BOOST_AUTO_TEST_CASE(real_trace_2_unoptimized)
 // TODO: then, on to compressing into a single node via hashing.
 
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_view)
+
+BOOST_AUTO_TEST_CASE(view_matches_stream_parse)
+{
+    namespace fs = boost::filesystem;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+
+    fs::create_directories(dir / "trace");
+    fs::copy_file("tb-seq-3.bin", dir / "trace" / "tb-seq.bin");
+
+    // Reference: the previous parse, one 8-byte read and push_back per block.
+    auto st = chrono::high_resolution_clock::now();
+
+    ifstream ifs((dir / "trace" / "tb-seq.bin").string(), ios::in | ios::binary);
+
+    BOOST_REQUIRE(ifs.good());
+
+    auto addr = uint64_t{0u};
+    auto v = vector<uint64_t>{};
+
+    while(ifs.read(reinterpret_cast<char*>(&addr), sizeof(uint64_t)))
+        v.push_back(addr);
+
+    auto et = chrono::high_resolution_clock::now();
+
+    auto cache = TraceViewCache{2};
+
+    auto vst = chrono::high_resolution_clock::now();
+    auto view = cache.get(dir / "trace");
+    auto sum = accumulate(view->begin(), view->end(), uint64_t{0});
+    auto vet = chrono::high_resolution_clock::now();
+
+    BOOST_REQUIRE_EQUAL(view->size(), v.size());
+    BOOST_CHECK(equal(v.begin(), v.end(), view->begin()));
+    BOOST_CHECK_EQUAL(sum, accumulate(v.begin(), v.end(), uint64_t{0}));
+    BOOST_CHECK_EQUAL(view->get_id(), (dir / "trace").generic_string());
+    BOOST_CHECK(view->to_trace().get_blocks() == v);
+
+    // Parsed at most once: later readers share the mapping.
+    BOOST_CHECK(cache.get(dir / "trace") == view);
+    BOOST_CHECK_EQUAL(cache.maps(), 1u);
+
+    cout << "stream parse (us): " << chrono::duration_cast<chrono::microseconds>(et - st).count() << endl;
+    cout << "view + scan (us): " << chrono::duration_cast<chrono::microseconds>(vet - vst).count() << endl;
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(view_of_trace_container)
+{
+    namespace fs = boost::filesystem;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+
+    fs::create_directories(dir / "loose");
+    fs::create_directories(dir / "packed");
+    fs::copy_file("tb-seq-3.bin", dir / "loose" / "tb-seq.bin");
+
+    auto loose = TraceViewCache::open(dir / "loose");
+    auto text = string{};
+
+    for(auto i = 0u; i < 10000u; ++i)
+        text += "call void @qemu_tb_prelogue(i64 " + to_string(i % 16) + ")\n";
+
+    {
+        TraceContainerWriter writer{dir / "packed" / trace_container_file_name};
+
+        writer.add("tb-seq.bin", loose->begin(), loose->size() * sizeof(Trace::Block), false);
+        writer.add("main_function.ll", text, true);
+        writer.add("dump_mo_symbolics.txt", "x", true); // Too small to shrink: stored as is.
+        writer.add("empty.bin", "", true);
+
+        BOOST_CHECK(!fs::exists(dir / "packed" / trace_container_file_name)); // Not until it's whole.
+
+        writer.close();
+    }
+
+    BOOST_REQUIRE_EQUAL(distance(fs::directory_iterator{dir / "packed"}, fs::directory_iterator{}), 1);
+
+    auto packed = TraceViewCache::open(dir / "packed");
+
+    BOOST_CHECK_EQUAL(packed->get_id(), (dir / "packed").generic_string());
+    BOOST_REQUIRE_EQUAL(packed->size(), loose->size());
+    BOOST_CHECK(equal(loose->begin(), loose->end(), packed->begin()));
+
+    {
+        TraceContainer container{dir / "packed" / trace_container_file_name};
+        auto ll = container.section("main_function.ll");
+
+        BOOST_CHECK_EQUAL(container.names().size(), 4u);
+        BOOST_CHECK(string(ll.data, ll.size) == text);
+        BOOST_CHECK(fs::file_size(dir / "packed" / trace_container_file_name) < loose->size() * sizeof(Trace::Block) + text.size() / 2);
+        BOOST_CHECK_EQUAL(container.section("empty.bin").size, 0u);
+        BOOST_CHECK(!container.contains("dump_sync_memos.bin"));
+        BOOST_CHECK_THROW(container.section("dump_sync_memos.bin"), std::runtime_error);
+    }
+
+    // Readers take either layout.
+    {
+        TraceArtifactStream is{dir / "packed", "dump_mo_symbolics.txt"};
+        auto line = string{};
+
+        BOOST_CHECK(getline(is, line) && line == "x");
+        BOOST_CHECK(!TraceArtifactStream(dir / "packed", "concrete_inputs.bin"));
+        BOOST_CHECK(TraceArtifactStream(dir / "loose", "tb-seq.bin"));
+        BOOST_CHECK(!TraceArtifactStream(dir / "loose", "concrete_inputs.bin"));
+        BOOST_CHECK(trace_artifact_exists(dir / "packed", "tb-seq.bin"));
+        BOOST_CHECK(trace_artifact_exists(dir / "loose", "tb-seq.bin"));
+        BOOST_CHECK(!trace_artifact_exists(dir / "loose", "main_function.ll"));
+    }
+
+    // A flipped bit in a section is caught on reading it, not before.
+    {
+        fstream fs((dir / "packed" / trace_container_file_name).string(), ios::in | ios::out | ios::binary);
+        auto byte = char{};
+
+        fs.seekg(64);
+        fs.read(&byte, 1);
+        byte ^= 1;
+        fs.seekp(64);
+        fs.write(&byte, 1);
+    }
+
+    {
+        TraceContainer container{dir / "packed" / trace_container_file_name};
+
+        BOOST_CHECK_THROW(container.section("tb-seq.bin"), std::runtime_error);
+        BOOST_CHECK_EQUAL(container.section("dump_mo_symbolics.txt").size, 1u);
+    }
+
+    // Truncated mid-write: the header no longer matches.
+    fs::resize_file(dir / "packed" / trace_container_file_name, fs::file_size(dir / "packed" / trace_container_file_name) - 1);
+
+    BOOST_CHECK_THROW(TraceContainer{dir / "packed" / trace_container_file_name}, std::runtime_error);
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_graph_memory)
+
+// Vertex layout prior to interning: the full trace ID in every vertex.
+struct LegacyVertexProperty
+{
+    Trace::Block unique_hash;
+    std::string trace_id;
+    bool cache = false;
+};
+
+auto heap_in_use() -> size_t
+{
+#if defined(CRETE_HAVE_MALLINFO2)
+    return mallinfo2().uordblks;
+#else
+    return static_cast<unsigned int>(mallinfo().uordblks); // Wraps past 4GB; the graphs here use far less.
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(bytes_per_vertex)
+{
+    // Traces share a common prefix, then diverge for the rest of their length.
+    const auto trace_count = size_t{20};
+    const auto prefix = size_t{10000};
+    const auto length = size_t{50000};
+
+    auto make_id = [](size_t i)
+    {
+        return "dispatch/2016-07-11.12-00-00.000000/trace/runtime-dump-" + to_string(i) + "-1.0";
+    };
+    auto make_trace = [&](size_t i)
+    {
+        auto blocks = Trace::Blocks(length);
+
+        for(auto b = size_t{0}; b < length; ++b)
+            blocks[b] = b < prefix ? b : (i + 1) * length + b;
+
+        return Trace(make_id(i), blocks);
+    };
+
+    using LegacyGraph = boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS, LegacyVertexProperty>;
+
+    auto legacy_vertices = size_t{0};
+    auto legacy_bytes = size_t{0};
+    {
+        auto before = heap_in_use();
+
+        LegacyGraph g;
+
+        for(auto i = size_t{0}; i < trace_count; ++i)
+        {
+            auto trace = make_trace(i);
+            const auto& blocks = trace.get_blocks();
+            auto parent = i == 0 ? LegacyGraph::vertex_descriptor{0} : LegacyGraph::vertex_descriptor{prefix - 1};
+
+            for(auto b = i == 0 ? size_t{0} : prefix; b < length; ++b)
+            {
+                auto u = add_vertex(g);
+
+                g[u].unique_hash = blocks[b];
+                g[u].trace_id = trace.get_id();
+
+                if(b != 0)
+                    add_edge(parent, u, g);
+
+                parent = u;
+            }
+        }
+
+        legacy_vertices = num_vertices(g);
+        legacy_bytes = heap_in_use() - before;
+    }
+
+    auto vertices = size_t{0};
+    auto nodes = size_t{0};
+    auto bytes = size_t{0};
+    {
+        auto before = heap_in_use();
+
+        TraceGraph g;
+
+        for(auto i = size_t{0}; i < trace_count; ++i)
+        {
+            BOOST_REQUIRE(g.insert(make_trace(i)));
+        }
+
+        vertices = g.block_count();
+        nodes = g.node_count();
+        bytes = heap_in_use() - before;
+    }
+
+    BOOST_REQUIRE_EQUAL(vertices, legacy_vertices);
+    BOOST_CHECK_EQUAL(nodes, trace_count + 1); // The shared prefix, and a span per trace below it.
+
+    auto legacy_per_vertex = static_cast<double>(legacy_bytes) / legacy_vertices;
+    auto per_vertex = static_cast<double>(bytes) / vertices;
+
+    cout << "vertices: " << vertices << " (" << nodes << " spans)" << endl;
+    cout << "bytes per vertex (string trace_id): " << legacy_per_vertex << endl;
+    cout << "bytes per vertex (spans): " << per_vertex << endl;
+
+    BOOST_CHECK_LT(per_vertex, legacy_per_vertex);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_analyzer)
+
+BOOST_AUTO_TEST_CASE(concurrent_prepare_matches_serial_insert)
+{
+    namespace fs = boost::filesystem;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+    auto base = TraceView("tb-seq-3.bin").to_trace().get_blocks();
+    auto paths = vector<fs::path>{};
+
+    // Traces share a prefix of the real one, then go their own way; some are repeats (subgraphs).
+    for(auto i = size_t{0}; i < 32; ++i)
+    {
+        auto blocks = Trace::Blocks(base.begin(), base.begin() + base.size() / 2 + (i % 8) * 1000);
+
+        for(auto b = size_t{0}; b < (i % 3) * 5000; ++b)
+            blocks.push_back(i * 1000000 + b);
+
+        auto p = dir / ("runtime-dump-" + to_string(i));
+
+        fs::create_directories(p);
+        ofstream ofs((p / "tb-seq.bin").string(), ios::out | ios::binary);
+        ofs.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(Trace::Block));
+
+        paths.push_back(p);
+    }
+
+    TraceAnalyzer serial("bfs");
+    auto serial_inserted = vector<bool>{};
+
+    auto st = chrono::high_resolution_clock::now();
+    for(const auto& p : paths)
+        serial_inserted.push_back(serial.insert_trace(p));
+    auto et = chrono::high_resolution_clock::now();
+
+    TraceAnalyzer concurrent("bfs");
+    auto concurrent_inserted = vector<bool>{};
+    auto prepared = vector<TraceAnalyzer::Prepared>(paths.size());
+    atomic<size_t> next{0};
+
+    auto cst = chrono::high_resolution_clock::now();
+    {
+        auto workers = vector<thread>{};
+
+        for(auto w = 0u; w < max(thread::hardware_concurrency(), 2u); ++w)
+        {
+            workers.emplace_back([&] {
+                for(auto i = next++; i < paths.size(); i = next++)
+                    prepared[i] = concurrent.prepare_trace(paths[i]);
+            });
+        }
+
+        for(auto& w : workers)
+            w.join();
+    }
+    for(auto i = size_t{0}; i < paths.size(); ++i)
+        concurrent_inserted.push_back(concurrent.commit_trace(paths[i], prepared[i]));
+    auto cet = chrono::high_resolution_clock::now();
+
+    BOOST_CHECK(serial_inserted == concurrent_inserted);
+
+    for(;;)
+    {
+        auto s = serial.next();
+        auto c = concurrent.next();
+
+        BOOST_REQUIRE_EQUAL(bool(s), bool(c));
+
+        if(!s)
+            break;
+
+        BOOST_CHECK_EQUAL(s->get_id(), c->get_id());
+    }
+
+    cout << "serial insert (us): " << chrono::duration_cast<chrono::microseconds>(et - st).count() << endl;
+    cout << "concurrent prepare + commit (us): " << chrono::duration_cast<chrono::microseconds>(cet - cst).count() << endl;
+
+    fs::remove_all(dir);
+}
+
+// As dispatch does: traces analyzed from memory, never written out. More of them than the view cache
+// holds, so some are executed after their views are gone.
+BOOST_AUTO_TEST_CASE(in_memory_traces_match_on_disk)
+{
+    namespace fs = boost::filesystem;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+    auto mem_dir = fs::temp_directory_path() / fs::unique_path(); // Never created.
+    auto base = TraceView("tb-seq-1.bin").to_trace().get_blocks();
+    auto count = trace_view_cache_default_capacity + 44;
+
+    TraceAnalyzer on_disk("bfs");
+    TraceAnalyzer in_memory("bfs");
+
+    for(auto i = size_t{0}; i < count; ++i)
+    {
+        auto blocks = Trace::Blocks(base.begin(), base.begin() + 1 + i % base.size());
+
+        for(auto b = size_t{0}; b < i % 7; ++b)
+            blocks.push_back(i * 1000000 + b);
+
+        auto name = "runtime-dump-" + to_string(i);
+        auto p = dir / name;
+
+        fs::create_directories(p);
+        ofstream ofs((p / "tb-seq.bin").string(), ios::out | ios::binary);
+        ofs.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(Trace::Block));
+        ofs.close();
+
+        auto data = boost::make_shared<const vector<uint8_t>>(reinterpret_cast<const uint8_t*>(blocks.data()),
+                                                              reinterpret_cast<const uint8_t*>(blocks.data() + blocks.size()));
+        auto view = TraceViewCache::View(new TraceView(mem_dir / name, data));
+
+        BOOST_CHECK(equal(view->begin(), view->end(), blocks.begin()));
+
+        BOOST_CHECK_EQUAL(in_memory.commit_trace(mem_dir / name, in_memory.prepare_trace(mem_dir / name, view)),
+                          on_disk.insert_trace(p));
+    }
+
+    BOOST_CHECK_EQUAL(in_memory.blocks_discovered_count(), on_disk.blocks_discovered_count());
+
+    for(;;)
+    {
+        auto d = on_disk.next();
+        auto m = in_memory.next();
+
+        BOOST_REQUIRE_EQUAL(bool(d), bool(m));
+
+        if(!d)
+            break;
+
+        BOOST_CHECK_EQUAL(fs::path(m->get_id()).filename(), fs::path(d->get_id()).filename());
+
+        on_disk.submit_executed(fs::path(d->get_id()));
+        in_memory.submit_executed(fs::path(m->get_id()));
+    }
+
+    BOOST_CHECK(!fs::exists(mem_dir));
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(unexecuted_block_registry_matches_rescan)
+{
+    // Against the definition: a trace is pending while any of its blocks is in no executed trace.
+    auto rng = mt19937{7};
+    auto traces = vector<Trace::Blocks>{};
+
+    for(auto i = 0; i < 500; ++i)
+    {
+        auto blocks = Trace::Blocks{};
+
+        for(auto j = 0u; j < 50 + rng() % 50; ++j)
+            blocks.push_back(rng() % 2000);
+
+        traces.push_back(blocks);
+    }
+
+    UnexecutedBlockRegistry registry;
+    auto executed = set<Trace::Block>{};
+    auto pending = set<Trace::ID>{};
+
+    auto has_unexecuted = [&](const Trace::Blocks& blocks)
+    {
+        return any_of(blocks.begin(), blocks.end(), [&](Trace::Block b) { return executed.count(b) == 0; });
+    };
+
+    for(auto i = size_t{0}; i < traces.size(); ++i)
+    {
+        auto id = to_string(i);
+
+        BOOST_CHECK_EQUAL(registry.insert(id, traces[i]), has_unexecuted(traces[i]));
+
+        if(has_unexecuted(traces[i]))
+            pending.insert(id);
+
+        if(i % 3 == 0)
+        {
+            const auto& run = traces[rng() % (i + 1)];
+
+            registry.executed(run);
+            executed.insert(run.begin(), run.end());
+
+            for(auto it = pending.begin(); it != pending.end();)
+                it = has_unexecuted(traces[stoul(*it)]) ? next(it) : pending.erase(it);
+        }
+
+        if(i % 7 == 0 && !pending.empty())
+        {
+            auto id = registry.pop();
+
+            BOOST_REQUIRE(id);
+            BOOST_CHECK_EQUAL(*id, *pending.begin());
+
+            pending.erase(pending.begin());
+        }
+
+        BOOST_REQUIRE_EQUAL(registry.size(), pending.size());
+        BOOST_CHECK_EQUAL(registry.covered_count(), executed.size());
+    }
+
+    while(auto id = registry.pop())
+    {
+        BOOST_REQUIRE(!pending.empty());
+        BOOST_CHECK_EQUAL(*id, *pending.begin());
+
+        pending.erase(pending.begin());
+    }
+
+    BOOST_CHECK(pending.empty());
+}
+
+BOOST_AUTO_TEST_CASE(save_load_resumes_selection)
+{
+    namespace fs = boost::filesystem;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+    auto traces = vector<Trace::Blocks>{};
+    auto paths = vector<fs::path>{};
+    auto rng = mt19937{11};
+
+    for(auto i = size_t{0}; i < 64; ++i)
+    {
+        auto blocks = Trace::Blocks{1, 2, 3};
+
+        for(auto b = size_t{0}; b < 20 + rng() % 20; ++b)
+            blocks.push_back(rng() % 8);
+
+        traces.push_back(blocks);
+        paths.push_back(dir / ("runtime-dump-" + to_string(i)));
+    }
+
+    for(const auto& strat : {"bfs", "exp-2", "weighted"})
+    {
+        auto ties_random = string(strat) == "weighted";
+
+        for(auto i = size_t{0}; i < paths.size(); ++i)
+        {
+            fs::create_directories(paths[i]);
+            ofstream ofs((paths[i] / "tb-seq.bin").string(), ios::out | ios::binary);
+            ofs.write(reinterpret_cast<const char*>(traces[i].data()), traces[i].size() * sizeof(Trace::Block));
+        }
+
+        auto select = [](TraceAnalyzer& analyzer) -> boost::optional<fs::path>
+        {
+            auto t = analyzer.next();
+
+            if(!t)
+                return boost::optional<fs::path>();
+
+            analyzer.submit_executed(fs::path(t->get_id()));
+
+            return fs::path(t->get_id());
+        };
+
+        TraceAnalyzer original(strat);
+        auto half = paths.size() / 2;
+
+        for(auto i = size_t{0}; i < half; ++i)
+        {
+            original.insert_trace(paths[i]);
+
+            if(i % 4 == 3)
+                select(original);
+        }
+
+        stringstream ss;
+        {
+            boost::archive::binary_oarchive oa(ss);
+            oa << original;
+        }
+
+        TraceAnalyzer restored(strat); // Carries on as the original does.
+        TraceAnalyzer replayed(strat); // Only told what the original selected, as when replaying a journal.
+        {
+            auto snapshot = ss.str();
+            stringstream ss1(snapshot), ss2(snapshot);
+            boost::archive::binary_iarchive ia1(ss1), ia2(ss2);
+
+            ia1 >> restored;
+            ia2 >> replayed;
+        }
+
+        BOOST_CHECK_EQUAL(restored.blocks_discovered_count(), original.blocks_discovered_count());
+
+        auto original_rest = set<fs::path>{};
+        auto replayed_rest = set<fs::path>{};
+
+        for(auto i = half; i < paths.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(restored.insert_trace(paths[i]), original.insert_trace(paths[i]));
+            replayed.insert_trace(paths[i]);
+
+            if(i % 4 != 3)
+                continue;
+
+            auto o = select(original);
+            auto r = select(restored);
+
+            BOOST_REQUIRE_EQUAL(bool(o), bool(r));
+
+            if(!o)
+                continue;
+
+            if(!ties_random)
+                BOOST_CHECK_EQUAL(*r, *o);
+
+            if(!ties_random) // Otherwise, the restored analyzer may yet select it.
+                fs::remove(*o / "tb-seq.bin"); // As dispatch does, once forwarded.
+
+            replayed.resubmit_executed(*o);
+        }
+
+        while(auto o = select(original))
+        {
+            original_rest.insert(*o);
+
+            auto r = select(restored);
+
+            BOOST_REQUIRE(r);
+
+            if(!ties_random)
+                BOOST_CHECK_EQUAL(*r, *o);
+        }
+
+        BOOST_CHECK(!restored.next());
+
+        while(auto r = select(replayed))
+            replayed_rest.insert(*r);
+
+        BOOST_CHECK(replayed_rest == original_rest);
+        BOOST_CHECK_EQUAL(replayed.blocks_discovered_count(), original.blocks_discovered_count());
+    }
+
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(selector)
+
+BOOST_AUTO_TEST_CASE(score_heap_order_and_erase)
+{
+    auto heap = trace::ScoreHeap{};
+
+    BOOST_CHECK(heap.push("c", 3.0, 0));
+    BOOST_CHECK(heap.push("a", 1.0, 7));
+    BOOST_CHECK(heap.push("b", 2.0, 0));
+    BOOST_CHECK(heap.push("a2", 1.0, 3)); // Ties go to the lower random key.
+    BOOST_CHECK(!heap.push("b", 0.0, 0));
+    BOOST_CHECK(heap.erase("b"));
+    BOOST_CHECK(!heap.erase("b"));
+    BOOST_CHECK(heap.push("d", 0.5, 0)); // Reuses b's handle.
+
+    auto order = vector<string>{};
+
+    while(auto e = heap.pop())
+        order.push_back(e->first);
+
+    BOOST_CHECK((order == vector<string>{"d", "a2", "a", "c"}));
+    BOOST_CHECK(heap.empty());
+}
+
+BOOST_AUTO_TEST_CASE(next_is_lowest_score_then_random_tie)
+{
+    // Least-treaded: a trace looping over one block scores higher than one of distinct blocks.
+    const auto trace_count = size_t{100000};
+
+    trace::LeastTreadedSelector selector;
+
+    auto st = chrono::high_resolution_clock::now();
+    for(auto i = size_t{0}; i < trace_count; ++i)
+    {
+        auto blocks = i % 10 == 0 ? Trace::Blocks{1, 2, 3, 4} : Trace::Blocks{1, 1, 1, 1};
+
+        selector.submit(Trace{"t" + to_string(i), blocks});
+    }
+
+    auto firsts = set<string>{};
+    auto selected = size_t{0};
+
+    for(auto i = size_t{0}; i < trace_count / 10; ++i)
+    {
+        auto t = selector.next();
+
+        BOOST_REQUIRE(t);
+        BOOST_CHECK_EQUAL(stoul(t->get_id().substr(1)) % 10, 0u);
+
+        if(i < 100)
+            firsts.insert(t->get_id());
+    }
+
+    while(selector.next())
+        ++selected;
+    auto et = chrono::high_resolution_clock::now();
+
+    BOOST_CHECK_EQUAL(selected, trace_count - trace_count / 10);
+
+    // Not in submission order: of t0, t10, ..., t990, only about a hundredth should be among the first 100 picked.
+    auto in_order = count_if(firsts.begin(), firsts.end(), [](const string& id) { return stoul(id.substr(1)) < 1000; });
+
+    BOOST_CHECK_LT(in_order, 20);
+
+    cout << "submit + drain " << trace_count << " traces (ms): " << chrono::duration_cast<chrono::milliseconds>(et - st).count() << endl;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(trace_graph)
+
+BOOST_AUTO_TEST_CASE(subtree_score_descent)
+{
+    auto score = [](const TraceGraph::SubtreeStats& stats) { return trace::calculate_least_treaded_score(stats); };
+
+    TraceGraph g;
+
+    BOOST_CHECK(!g.select_by_subtree_score(score));
+
+    auto loop = Trace::Blocks{1, 2};
+    auto straight = Trace::Blocks{1, 2};
+
+    for(auto i = 0u; i < 200; ++i)
+    {
+        loop.push_back(3 + i % 2); // Well trodden.
+        straight.push_back(1000 + i);
+    }
+
+    BOOST_REQUIRE(g.insert(Trace{"loop", loop}));
+    BOOST_REQUIRE(g.insert(Trace{"straight", straight}));
+    BOOST_REQUIRE_EQUAL(g.subtree_stats(0).blocks, loop.size() + straight.size() - 2);
+    BOOST_REQUIRE_EQUAL(g.subtree_stats(0).unexecuted_leaves, 2u);
+
+    auto first = g.select_by_subtree_score(score);
+
+    BOOST_REQUIRE(first);
+    BOOST_CHECK_EQUAL(first->get_id(), "straight");
+
+    g.submit_executed(*first);
+
+    auto second = g.select_by_subtree_score(score);
+
+    BOOST_REQUIRE(second);
+    BOOST_CHECK_EQUAL(second->get_id(), "loop");
+
+    g.submit_executed(*second);
+
+    BOOST_CHECK_EQUAL(g.subtree_stats(0).unexecuted_leaves, 0u);
+    BOOST_CHECK(!g.select_by_subtree_score(score));
+}
+
+BOOST_AUTO_TEST_CASE(subtree_score_deep_graph)
+{
+    // Each trace branches off the previous one a block further down: a path of branch points as long as there are traces.
+    const auto trace_count = size_t{2000};
+
+    auto score = [](const TraceGraph::SubtreeStats& stats) { return trace::calculate_least_treaded_score(stats); };
+
+    TraceGraph g;
+    auto spine = Trace::Blocks{};
+
+    for(auto i = size_t{0}; i < trace_count; ++i)
+    {
+        spine.push_back(i);
+
+        auto blocks = spine;
+
+        blocks.push_back(trace_count + i); // Diverges from the spine.
+
+        BOOST_REQUIRE(g.insert(Trace{to_string(i), blocks}));
+    }
+
+    BOOST_CHECK_EQUAL(g.subtree_stats(0).unexecuted_leaves, trace_count);
+
+    auto st = chrono::high_resolution_clock::now();
+    auto selected = set<string>{};
+
+    while(auto t = g.select_by_subtree_score(score))
+    {
+        BOOST_REQUIRE(selected.insert(t->get_id()).second);
+
+        g.submit_executed(*t);
+    }
+    auto et = chrono::high_resolution_clock::now();
+
+    BOOST_CHECK_EQUAL(selected.size(), trace_count);
+
+    cout << "select all " << trace_count << " traces, " << g.node_count() << " nodes (ms): " << chrono::duration_cast<chrono::milliseconds>(et - st).count() << endl;
+}
+
+BOOST_AUTO_TEST_CASE(bfs_resumes_across_merges)
+{
+    // As above: a path of branch points as long as there are traces, and the shallowest is selected first.
+    const auto trace_count = size_t{2000};
+
+    TraceGraph g;
+    auto spine = Trace::Blocks{};
+
+    for(auto i = size_t{0}; i < trace_count; ++i)
+    {
+        spine.push_back(i);
+
+        auto blocks = spine;
+
+        blocks.push_back(trace_count + i);
+
+        BOOST_REQUIRE(g.insert(Trace{to_string(i), blocks}));
+    }
+
+    auto st = chrono::high_resolution_clock::now();
+
+    for(auto i = size_t{0}; i < trace_count / 2; ++i)
+    {
+        auto t = g.next_bfs();
+
+        BOOST_REQUIRE(t);
+        BOOST_CHECK_EQUAL(t->get_id(), to_string(i));
+    }
+
+    // A branch above the frontier is selected next, and one below it once the frontier gets there.
+    BOOST_REQUIRE(g.insert(Trace{"shallow", Trace::Blocks{0, 1, 3 * trace_count}}));
+    BOOST_REQUIRE(g.insert(Trace{"deep", Trace::Blocks{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 3 * trace_count}}));
+
+    auto t = g.next_bfs();
+
+    BOOST_REQUIRE(t);
+    BOOST_CHECK_EQUAL(t->get_id(), "shallow");
+
+    t = g.next_bfs();
+
+    BOOST_REQUIRE(t);
+    BOOST_CHECK_EQUAL(t->get_id(), "deep");
+
+    auto selected = set<string>{};
+
+    while(auto t = g.next_bfs())
+    {
+        BOOST_REQUIRE(selected.insert(t->get_id()).second);
+    }
+    auto et = chrono::high_resolution_clock::now();
+
+    BOOST_CHECK_EQUAL(selected.size(), trace_count - trace_count / 2);
+
+    cout << "bfs over " << trace_count << " traces, " << g.node_count() << " nodes (ms): " << chrono::duration_cast<chrono::milliseconds>(et - st).count() << endl;
+}
+
+BOOST_AUTO_TEST_CASE(mid_span_splits)
+{
+    TraceGraph g;
+
+    auto a = Trace::Blocks{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    auto b = Trace::Blocks{1, 2, 3, 4, 5, 6, 7, 8, 70}; // Splits a's span near its end.
+    auto c = Trace::Blocks{1, 2, 80}; // Splits it again near its start, above a branch point.
+
+    BOOST_REQUIRE(g.insert(Trace{"a", a}));
+    BOOST_REQUIRE(g.insert(Trace{"b", b}));
+    BOOST_REQUIRE(g.insert(Trace{"c", c}));
+    BOOST_CHECK(!g.insert(Trace{"sub", Trace::Blocks{1, 2, 3}})); // Within the graph.
+
+    // 0: [1, 2], 3: [3 .. 8], 1: [9, 10] (a), 2: [70] (b), 4: [80] (c)
+    BOOST_REQUIRE_EQUAL(g.node_count(), 5u);
+    BOOST_CHECK_EQUAL(g.block_count(), a.size() + 1 + 1);
+    BOOST_CHECK_EQUAL(g.span_size(0), 2u);
+    BOOST_CHECK_EQUAL(g.span_size(1), 2u);
+    BOOST_CHECK_EQUAL(g.span_size(2), 1u);
+    BOOST_CHECK_EQUAL(g.span_size(3), 6u);
+    BOOST_CHECK_EQUAL(g.span_size(4), 1u);
+    BOOST_CHECK_EQUAL(g.block(3, 0), 3u);
+    BOOST_CHECK_EQUAL(g.block(1, 0), 9u);
+    BOOST_CHECK_EQUAL(g.node_trace_id(1), "a");
+    BOOST_CHECK_EQUAL(g.node_trace_id(2), "b");
+    BOOST_CHECK_EQUAL(g.node_trace_id(4), "c");
+
+    BOOST_CHECK(g.trace_blocks("a") == a);
+    BOOST_CHECK(g.trace_blocks("b") == b);
+    BOOST_CHECK(g.trace_blocks("c") == c);
+
+    // The stats of the split-off tails are their subtrees', as if the blocks were inserted there.
+    auto check_stats = [&g](TraceGraph::Node n, const Trace::Blocks& subtree, uint32_t unexecuted)
+    {
+        auto sketch = BlockSketch{};
+
+        sketch.add(subtree.begin(), subtree.end());
+
+        BOOST_CHECK_EQUAL(g.subtree_stats(n).blocks, subtree.size());
+        BOOST_CHECK_EQUAL(g.subtree_stats(n).unexecuted_leaves, unexecuted);
+        BOOST_CHECK_EQUAL(g.subtree_stats(n).sketch.second_moment(), sketch.second_moment());
+    };
+
+    check_stats(0, Trace::Blocks{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 70, 80}, 3);
+    check_stats(3, Trace::Blocks{3, 4, 5, 6, 7, 8, 9, 10, 70}, 2);
+    check_stats(1, Trace::Blocks{9, 10}, 1);
+    check_stats(2, Trace::Blocks{70}, 1);
+    check_stats(4, Trace::Blocks{80}, 1);
+}
+
+BOOST_AUTO_TEST_CASE(leaf_extended_in_place)
+{
+    TraceGraph g;
+    auto replaced = vector<Trace::ID>{};
+
+    g.insert_callback([&replaced](Trace::ID id) { replaced.push_back(id); });
+
+    auto a = Trace::Blocks{1, 2, 3};
+    auto b = Trace::Blocks{1, 2, 3, 4, 5};
+
+    BOOST_REQUIRE(g.insert(Trace{"a", a}));
+    BOOST_REQUIRE(g.insert(Trace{"b", b})); // a's span is the arena's last: b grows it.
+
+    BOOST_CHECK(replaced == vector<Trace::ID>{"a"});
+    BOOST_CHECK(!g.contains("a"));
+    BOOST_CHECK(g.contains("b"));
+    BOOST_CHECK(g.trace_blocks("a").empty());
+    BOOST_CHECK(g.trace_blocks("b") == b);
+
+    BOOST_REQUIRE_EQUAL(g.node_count(), 1u);
+    BOOST_CHECK_EQUAL(g.block_count(), b.size());
+    BOOST_CHECK_EQUAL(g.span_size(0), b.size());
+    BOOST_CHECK_EQUAL(g.node_trace_id(0), "b");
+    BOOST_CHECK_EQUAL(g.subtree_stats(0).blocks, b.size());
+    BOOST_CHECK_EQUAL(g.subtree_stats(0).unexecuted_leaves, 1u);
+
+    auto t = g.next_bfs();
+
+    BOOST_REQUIRE(t);
+    BOOST_CHECK_EQUAL(t->get_id(), "b");
+    BOOST_CHECK(!g.next_bfs());
+}
+
+BOOST_AUTO_TEST_CASE(supergraph_replaces_trace_on_path)
+{
+    TraceGraph g;
+    auto replaced = vector<Trace::ID>{};
+
+    g.insert_callback([&replaced](Trace::ID id) { replaced.push_back(id); });
+
+    auto a = Trace::Blocks{1, 2, 3, 4};
+    auto b = Trace::Blocks{1, 2, 9};
+    auto c = Trace::Blocks{1, 2, 3, 4, 5, 6}; // Extends a, whose span is no longer the arena's last.
+
+    BOOST_REQUIRE(g.insert(Trace{"a", a}));
+    BOOST_REQUIRE(g.insert(Trace{"b", b}));
+
+    auto t = g.next_bfs(); // Visits the root, for a.
+
+    BOOST_REQUIRE(t);
+    BOOST_CHECK_EQUAL(t->get_id(), "a");
+    BOOST_CHECK_EQUAL(g.subtree_stats(0).unexecuted_leaves, 1u);
+
+    BOOST_REQUIRE(g.insert(Trace{"c", c}));
+
+    BOOST_CHECK(replaced == vector<Trace::ID>{"a"});
+    BOOST_CHECK(!g.contains("a"));
+    BOOST_CHECK(g.trace_blocks("a").empty());
+    BOOST_CHECK(g.trace_blocks("b") == b);
+    BOOST_CHECK(g.trace_blocks("c") == c);
+
+    // 0: [1, 2], 1: [3, 4], 2: [9] (b), 3: [5, 6] (c). c takes over a's nodes.
+    BOOST_REQUIRE_EQUAL(g.node_count(), 4u);
+    BOOST_CHECK_EQUAL(g.node_trace_id(0), "c");
+    BOOST_CHECK_EQUAL(g.node_trace_id(1), "c");
+    BOOST_CHECK_EQUAL(g.node_trace_id(2), "b");
+    BOOST_CHECK_EQUAL(g.node_trace_id(3), "c");
+    BOOST_CHECK_EQUAL(g.span_size(3), 2u);
+    BOOST_CHECK_EQUAL(g.subtree_stats(0).blocks, 7u);
+    BOOST_CHECK_EQUAL(g.subtree_stats(1).blocks, 4u);
+    BOOST_CHECK_EQUAL(g.subtree_stats(0).unexecuted_leaves, 2u); // a was executed; b and c are not.
+    BOOST_CHECK_EQUAL(g.subtree_stats(1).unexecuted_leaves, 1u);
+
+    // The root, visited for a, is visited again for c.
+    auto selected = set<string>{};
+
+    while(auto t = g.next_bfs())
+        BOOST_REQUIRE(selected.insert(t->get_id()).second);
+
+    BOOST_CHECK(selected == (set<string>{"b", "c"}));
+}
+
+BOOST_AUTO_TEST_CASE(print_graph_expands_spans)
+{
+    namespace fs = boost::filesystem;
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+    auto prev_path = fs::current_path();
+
+    // Labels are read from each trace's directory: its number from the name, its value from concrete_inputs.bin.
+    auto make_trace_dir = [&dir](unsigned n)
+    {
+        auto trace_dir = dir / ("runtime-dump-" + to_string(n));
+        auto elem = TestCaseElement{};
+        auto tc = TestCase{};
+
+        elem.name = vector<uint8_t>{'x'};
+        elem.name_size = elem.name.size();
+        elem.data = vector<uint8_t>{static_cast<uint8_t>(n)};
+        elem.data_size = elem.data.size();
+        tc.add_element(elem);
+
+        fs::create_directories(trace_dir);
+        fs::ofstream ofs(trace_dir / "concrete_inputs.bin", ios::out | ios::binary);
+        tc.write(ofs);
+
+        return trace_dir.string();
+    };
+
+    TraceGraph g;
+
+    BOOST_REQUIRE(g.insert(Trace{make_trace_dir(1), Trace::Blocks{1, 2, 3, 4, 5, 6}}));
+    BOOST_REQUIRE(g.insert(Trace{make_trace_dir(2), Trace::Blocks{1, 2, 3, 7, 8}}));
+    BOOST_REQUIRE(g.insert(Trace{make_trace_dir(3), Trace::Blocks{1, 9}}));
+    BOOST_REQUIRE_EQUAL(g.node_count(), 5u);
+    BOOST_REQUIRE_EQUAL(g.block_count(), 9u);
+
+    fs::current_path(dir); // print_graph() writes below the working directory.
+
+    // Vertices and edges of the one graph printed.
+    auto print = [&g](bool only_branches)
+    {
+        g.print_graph(only_branches, TraceGraph::TraceScoreMap{}, std::map<AddressRange, Entry>{});
+
+        auto files = vector<fs::path>(fs::directory_iterator{fs::path("graph") / "tot"}, fs::directory_iterator{});
+
+        BOOST_REQUIRE_EQUAL(files.size(), 1u);
+
+        ifstream ifs(files.front().string());
+        auto dot = string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+        auto count = [&dot](const string& s)
+        {
+            auto n = size_t{0};
+
+            for(auto pos = dot.find(s); pos != string::npos; pos = dot.find(s, pos + 1))
+                ++n;
+
+            return n;
+        };
+
+        ifs.close();
+        fs::remove(files.front());
+
+        return make_pair(count("label="), count("->"));
+    };
+
+    auto expanded = print(false);
+    auto branches = print(true);
+
+    fs::current_path(prev_path);
+    fs::remove_all(dir);
+
+    // A vertex per block, chained along each span; or one per span, labelled by its last block.
+    BOOST_CHECK_EQUAL(expanded.first, g.block_count());
+    BOOST_CHECK_EQUAL(expanded.second, g.block_count() - 1);
+    BOOST_CHECK_EQUAL(branches.first, g.node_count());
+    BOOST_CHECK_EQUAL(branches.second, g.node_count() - 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
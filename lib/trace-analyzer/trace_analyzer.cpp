@@ -31,9 +31,9 @@ auto TraceAnalyzer::operator=(const TraceAnalyzer& other) -> TraceAnalyzer&
 {
     // TODO: redo with copy-and-swap idiom for exception saftey.
     trace_graph_ = other.trace_graph_;
-    traces_with_unexecuted_blocks_ = other.traces_with_unexecuted_blocks_;
-    global_block_weights_ = other.global_block_weights_;
+    unexecuted_blocks_ = other.unexecuted_blocks_;
     strat_ = other.strat_;
+    views_ = other.views_;
 
     // Re-create the selector.
     // If selector has reference to internal, e.g., graph_,
@@ -47,14 +47,42 @@ auto TraceAnalyzer::operator=(const TraceAnalyzer& other) -> TraceAnalyzer&
 
 bool TraceAnalyzer::insert_trace(const filesystem::path& path)
 {
-    std::cerr << "before parse_trace: " << (path / "tb-seq.bin").string() << std::endl;
-    auto trace = parse_trace(path / "tb-seq.bin");
+    return commit_trace(path, prepare_trace(path));
+}
+
+TraceAnalyzer::Prepared TraceAnalyzer::prepare_trace(const filesystem::path& path) const
+{
+    return prepare_trace(path, TraceViewCache::open(path));
+}
+
+TraceAnalyzer::Prepared TraceAnalyzer::prepare_trace(const filesystem::path& path, const TraceViewCache::View& view) const
+{
+    assert(trace_selector_);
+    assert(view->get_id() == path.generic_string());
+
+    auto prepared = Prepared{};
+
+    prepared.view = view;
+    prepared.trace = prepared.view->to_trace();
 
     if(compress_traces_)
     {
-        trace = compress(trace);
+        prepared.trace = compress(prepared.trace);
     }
 
+    prepared.score = trace_selector_->prescore(prepared.trace);
+
+    return prepared;
+}
+
+bool TraceAnalyzer::commit_trace(const filesystem::path& path, const Prepared& prepared)
+{
+    std::cerr << "before parse_trace: " << (path / "tb-seq.bin").string() << std::endl;
+    const auto& trace = prepared.trace;
+
+    if(prepared.view) // None for a trace replayed from its blocks alone.
+        views_.insert(path, prepared.view);
+
     auto success = trace_graph_.insert(trace);
 
     if(success)
@@ -62,7 +90,10 @@ bool TraceAnalyzer::insert_trace(const filesystem::path& path)
         std::cerr << "successful parse_trace" << std::endl;
         assert(trace_selector_);
 
-        trace_selector_->submit(trace);
+        if(prepared.score)
+            trace_selector_->submit(trace, *prepared.score);
+        else
+            trace_selector_->submit(trace);
 
         submit_to_unexecuted_block_registry(trace);
     }
@@ -87,12 +118,11 @@ boost::optional<Trace> TraceAnalyzer::next()
 boost::optional<Trace> TraceAnalyzer::next_with_unexecuted_blocks()
 {
     auto ret = optional<Trace>{};
+    auto id = unexecuted_blocks_.pop();
 
-    if(traces_with_unexecuted_blocks_.size() > 0)
+    if(id)
     {
-        auto it = traces_with_unexecuted_blocks_.begin();
-        ret = optional<Trace>{*it};
-        traces_with_unexecuted_blocks_.erase(it);
+        ret = optional<Trace>{Trace(*id, Trace::Blocks())};
     }
 
     return ret;
@@ -109,7 +139,7 @@ void TraceAnalyzer::print_graph(bool only_branches, std::map<AddressRange, Entry
 
 size_t TraceAnalyzer::blocks_discovered_count() const
 {
-    return global_block_weights_.size();
+    return unexecuted_blocks_.covered_count();
 }
 
 void TraceAnalyzer::set_selection_strategy(const string& strat)
@@ -152,74 +182,81 @@ void TraceAnalyzer::set_selection_strategy(const string& strat)
 
 void TraceAnalyzer::submit_to_unexecuted_block_registry(const Trace& trace)
 {
-    if(contains_unexecuted(trace.get_blocks()))
-    {
-        traces_with_unexecuted_blocks_.insert(trace);
-    }
+    unexecuted_blocks_.insert(trace.get_id(), trace.get_blocks());
 }
 
 void TraceAnalyzer::submit_executed(const Trace& trace)
 {
     trace_graph_.submit_executed(trace);
 
-    update_global_block_weights(trace);
-    update_traces_with_unexecuted_blocks();
+    unexecuted_blocks_.executed(trace.get_blocks());
 }
 
-void TraceAnalyzer::update_global_block_weights(const Trace& trace)
+void TraceAnalyzer::submit_executed(const filesystem::path& path)
 {
-    const auto& blocks = trace.get_blocks();
-    for(const auto& b : blocks)
+    // Held only in memory, and its view since dropped from the cache.
+    if(!views_.contains(path) && !trace_artifact_exists(path, "tb-seq.bin"))
     {
-        auto it = global_block_weights_.find(b);
+        auto trace = Trace(path.generic_string(), Trace::Blocks());
 
-        if(it == global_block_weights_.end())
-        {
-            global_block_weights_.insert(make_pair(b, 1));
-        }
-        else
-        {
-            it->second += 1; // Add 1 to weight.
-        }
+        trace.get_blocks() = trace_graph_.trace_blocks(trace.get_id());
+
+        submit_executed(trace);
+
+        return;
     }
+
+    auto v = view(path);
+
+    trace_graph_.submit_executed(Trace(v->get_id(), Trace::Blocks())); // Only the ID is used.
+
+    unexecuted_blocks_.executed(*v);
+
+    views_.erase(path); // Executed traces are not selected again.
 }
 
-void TraceAnalyzer::update_traces_with_unexecuted_blocks()
+void TraceAnalyzer::resubmit_executed(const filesystem::path& path)
 {
-    auto& ts = traces_with_unexecuted_blocks_;
-    auto to_erase = vector<Trace>{};
+    assert(trace_selector_);
+
+    auto trace = Trace(path.generic_string(), Trace::Blocks());
 
-    for(const auto& t : ts)
+    trace_selector_->remove(trace);
+
+    if(!trace_graph_.contains(trace.get_id())) // Superseded since.
+        return;
+
+    if(trace_artifact_exists(path, "tb-seq.bin"))
     {
-        if(!contains_unexecuted(t.get_blocks()))
-        {
-            to_erase.push_back(t);
-        }
+        submit_executed(path);
+
+        return;
     }
 
-    for(const auto& t : to_erase)
-    {
-        auto it = ts.find(t);
+    trace.get_blocks() = trace_graph_.trace_blocks(trace.get_id());
 
-        assert(it != ts.end());
+    submit_executed(trace);
 
-        ts.erase(it);
-    }
+    views_.erase(path);
 }
 
-bool TraceAnalyzer::contains_unexecuted(const Trace::Blocks& blocks)
+void TraceAnalyzer::withdraw(const filesystem::path& path)
 {
-    for(const auto& b : blocks)
-    {
-        auto it = global_block_weights_.find(b);
+    assert(trace_selector_);
 
-        if(it == global_block_weights_.end())
-            return true;
-        if(it->second == 0) // Under current impl. I don't think this is possible.
-            return true;
-    }
+    auto trace = Trace(path.generic_string(), Trace::Blocks());
+
+    trace_selector_->remove(trace);
 
-    return false;
+    if(trace_graph_.contains(trace.get_id()))
+        trace_graph_.executed(trace, true); // The graph-driven selectors skip executed traces.
+
+    views_.erase(path);
+}
+
+TraceViewCache::View TraceAnalyzer::view(const filesystem::path& path)
+{
+    return views_.get(path);
 }
 
 void TraceAnalyzer::initialize_selector_factory()
@@ -261,19 +298,65 @@ void TraceAnalyzer::initialize_log()
     assert(0 && "pending implementation of crete::logger");
 }
 
-Trace parse_trace(const boost::filesystem::path& path)
+boost::optional<Trace::ID> UnexecutedBlockRegistry::pop()
+{
+    if(pending_.empty())
+        return boost::optional<Trace::ID>();
+
+    auto id = *pending_.begin();
+
+    pending_.erase(pending_.begin());
+
+    return id;
+}
+
+UnexecutedBlockRegistry::BlockHandle UnexecutedBlockRegistry::intern(Trace::Block b)
 {
-    filesystem::ifstream ifs(path, ios_base::in | ios_base::binary);
-    if(!ifs.good())
-        throw runtime_error("failed to open file: " + path.generic_string());
+    auto it = handles_.find(b);
+
+    if(it != handles_.end())
+        return it->second;
 
-    Trace::Blocks blocks;
+    auto h = static_cast<BlockHandle>(covered_.size());
 
-    auto block_addr = uint64_t{0};
-    while(ifs.read(reinterpret_cast<char*>(&block_addr), sizeof(uint64_t)))
-        blocks.push_back(block_addr);
+    handles_.insert(make_pair(b, h));
+    covered_.push_back(false);
+    holders_.push_back(std::vector<TraceIdTable::Handle>());
+    last_counted_.push_back(0);
 
-    return Trace{path.parent_path().generic_string(), blocks};
+    return h;
+}
+
+void UnexecutedBlockRegistry::count(TraceIdTable::Handle trace, BlockHandle b)
+{
+    if(covered_[b] || last_counted_[b] == trace + 1)
+        return;
+
+    last_counted_[b] = trace + 1;
+    holders_[b].push_back(trace);
+    ++remaining_[trace];
+}
+
+void UnexecutedBlockRegistry::cover(BlockHandle b)
+{
+    if(covered_[b])
+        return;
+
+    covered_[b] = true;
+    ++covered_count_;
+
+    for(auto trace : holders_[b])
+    {
+        if(--remaining_[trace] == 0)
+            pending_.erase(trace_ids_.id(trace));
+    }
+
+    std::vector<TraceIdTable::Handle>().swap(holders_[b]); // Covered for good: release the list.
+}
+
+Trace parse_trace(const boost::filesystem::path& path)
+{
+    return TraceView(path).to_trace();
 }
 
 }
@@ -1,7 +1,5 @@
 #include <crete/trace_graph.h>
 
-#include "breadth_first_search.hpp"
-
 #include <boost/graph/graphviz.hpp> // testing
 #include <boost/graph/mcgregor_common_subgraphs.hpp>
 #include <boost/graph/depth_first_search.hpp>
@@ -14,8 +12,10 @@
 
 #include <iostream> // testing
 #include <functional>
+#include <queue>
 
 #include <crete/test_case.h>
+#include <crete/trace_container.h>
 
 using namespace boost;
 namespace fs = boost::filesystem;
@@ -23,34 +23,6 @@ namespace fs = boost::filesystem;
 namespace crete
 {
 
-template <typename Trace>
-struct FoundTrace
-{
-    FoundTrace(const Trace& trace) : trace_(trace) {}
-    Trace trace_;
-};
-
-class bfs_execution_visitor: public default_bfs_visitor
-{
-public:
-    bfs_execution_visitor(TraceGraph& tg) : tg_(tg) {}
-
-    template < typename Vertex, typename Graph >
-    void discover_vertex(Vertex u, const Graph& g) const
-    {
-        if(!tg_.executed(g[u].trace_id))
-        {
-            tg_.executed(Trace(g[u].trace_id, Trace::Blocks()), true);
-
-            // Seems like a hack. Why doesn't BGL just allow for returning bool to stop the search?
-            // Net answers suggest throwing an exception. Same effect, but unusal.
-            throw FoundTrace<decltype(VertexProperty::trace_id)>(g[u].trace_id);
-        }
-    }
-
-    TraceGraph& tg_;
-};
-
 std::string parse_trace_number(const Trace::ID& id)
 {
     auto s = id;
@@ -89,9 +61,7 @@ std::string parse_tb_number(const Trace::ID& id)
 
 std::string parse_trace_value(const Trace::ID& id)
 {
-    auto value_path = fs::path{id}/"concrete_inputs.bin";
-
-    fs::fstream ifs(value_path);
+    TraceArtifactStream ifs(fs::path{id}, "concrete_inputs.bin");
     auto tc = read_test_case(ifs);
     auto elems = tc.get_elements();
 
@@ -114,28 +84,32 @@ std::string parse_trace_value(const Trace::ID& id)
     return v.data();
 }
 
-template <class Name>
 class label_writer
 {
 public:
+  using Origin = std::vector<std::pair<TraceGraph::Node, uint64_t>>; // Span node and offset into it, by output vertex.
+
   label_writer(const TraceGraph& trace_graph,
-               Name _name,
+               const TraceGraph::Graph& graph,
+               const Origin& origin,
                const TraceGraph::TraceScoreMap& trace_scores,
                const std::set<TraceGraph::Score>& scores,
                const std::map<AddressRange, Entry>& elf_entries) :
       tg_(trace_graph),
-      name(_name),
+      graph_(graph),
+      origin_(origin),
       trace_scores_(trace_scores),
       scores_(scores),
       elf_entries_(elf_entries)
   {
   }
   template <class Vertex>
-  void operator()(std::ostream& out, const Vertex& v) const
+  void operator()(std::ostream& out, const Vertex& vertex) const
   {
       TraceGraph::Score score{0u};
-      auto trace_id = name[v].trace_id;
-      auto block_id = name[v].unique_hash;
+      const auto& o = origin_[vertex];
+      auto trace_id = tg_.node_trace_id(o.first);
+      auto block_id = tg_.block(o.first, o.second);
 
       auto it = trace_scores_.find(Trace{trace_id, Trace::Blocks()});
       if(it != trace_scores_.end())
@@ -185,7 +159,7 @@ public:
     // </label>
 
     // <shape>
-    if(name[v].cache)
+    if(out_degree(vertex, graph_) > 1)
     {
         out << " shape=\"diamond\" ";
     }
@@ -235,7 +209,8 @@ public:
   }
 private:
   const TraceGraph& tg_;
-  Name name;
+  const TraceGraph::Graph& graph_;
+  const Origin& origin_;
   const TraceGraph::TraceScoreMap& trace_scores_;
   const std::set<TraceGraph::Score>& scores_;
   const std::map<AddressRange, Entry>& elf_entries_;
@@ -245,6 +220,7 @@ private:
 
 void write_file(const TraceGraph& trace_graph,
                 const TraceGraph::Graph& graph,
+                const label_writer::Origin& origin,
                 const TraceGraph::TraceScoreMap& trace_scores,
                 const std::set<TraceGraph::Score>& scores,
                 const std::map<AddressRange, Entry>& elf_entries,
@@ -255,12 +231,13 @@ void write_file(const TraceGraph& trace_graph,
         filesystem::create_directories(root);
 
     boost::filesystem::ofstream ofsg(root / file);
-    label_writer<TraceGraph::Graph> vwriter(trace_graph, graph, trace_scores, scores, elf_entries);
+    label_writer vwriter(trace_graph, graph, origin, trace_scores, scores, elf_entries);
     write_graphviz(ofsg, graph, vwriter, default_writer());
 }
 
 void write_file_total(const TraceGraph& trace_graph,
                       const TraceGraph::Graph& graph,
+                      const label_writer::Origin& origin,
                       const TraceGraph::TraceScoreMap& trace_scores,
                       const std::set<TraceGraph::Score>& scores,
                       const std::map<AddressRange, Entry>& elf_entries)
@@ -269,6 +246,7 @@ void write_file_total(const TraceGraph& trace_graph,
 
     write_file(trace_graph,
                graph,
+               origin,
                trace_scores,
                scores,
                elf_entries,
@@ -288,35 +266,85 @@ void write_file_sub(const TraceGraph& trace_graph,
 //    write_file(trace_graph, graph, filesystem::path("graph") / "sub", n + ".dot");
 }
 
+const TraceGraph::Node TraceGraph::no_node;
+
 TraceGraph::TraceGraph()
 {
 
 }
 
+TraceIdTable::Handle TraceIdTable::intern(const Trace::ID& id)
+{
+    auto it = handles_.find(id);
+
+    if(it != handles_.end())
+        return it->second;
+
+    auto h = static_cast<Handle>(ids_.size());
+
+    ids_.push_back(id);
+    handles_.insert(std::make_pair(id, h));
+
+    return h;
+}
+
+boost::optional<TraceIdTable::Handle> TraceIdTable::find(const Trace::ID& id) const
+{
+    auto it = handles_.find(id);
+
+    if(it == handles_.end())
+        return boost::optional<Handle>();
+
+    return it->second;
+}
+
+void BlockSketch::add(const BlockSketch& other)
+{
+    for(size_t i = 0; i < width; ++i)
+        counters_[i] += other.counters_[i];
+}
+
+double BlockSketch::second_moment() const
+{
+    auto sum = 0.0;
+
+    for(auto c : counters_)
+        sum += static_cast<double>(c) * c;
+
+    return sum / width;
+}
+
 bool TraceGraph::insert(const Trace& trace)
 {
-    auto g = make_graph(trace);
+    auto key = Trace(trace.get_id(), Trace::Blocks()); // Keyed by ID; the blocks live in the graph.
 
     if(traces_.size() == 0)
     {
-        traces_.insert(trace);
-        executed_traces_.insert({trace, false});
-        graph_ = g;
+        traces_.insert(key);
+        executed_traces_.insert({key, false});
+        spans_.clear();
+        blocks_.clear();
+        subtree_stats_.clear();
+        leaves_.assign(leaves_.size(), no_node);
+        discovery_.clear();
+        levels_.clear();
+        frontier_.clear();
+        frontier_level_ = 0;
+        if(!trace.get_blocks().empty())
+            append_span(trace.get_blocks(), 0, no_node, trace_ids_.intern(trace.get_id()));
         return true;
     }
 
-    if(merge_trace(g))
+    if(merge_trace(trace))
     {
-        traces_.insert(trace);
-        executed_traces_.insert({trace, false});
+        traces_.insert(key);
+        executed_traces_.insert({key, false});
     }
     else
     {
         return false;
     }
 
-    mark_cache_vertices();
-
     return true;
 }
 
@@ -327,25 +355,35 @@ void TraceGraph::insert_callback(std::function<void (Trace::ID)> cb)
 
 boost::optional<Trace> TraceGraph::next_bfs()
 {
-    if(graph_.vertex_set().empty())
+    // Breadth-first over branch points: a span, however long, is a single step. Everything ahead of the
+    // frontier has been visited and found executed, so the search resumes there. Spans merged since are
+    // queued as they're discovered (see append_span() and back_insert()), by their level.
+    while(frontier_level_ < frontier_.size())
     {
-        return boost::optional<Trace>();
-    }
+        if(frontier_[frontier_level_].empty())
+        {
+            ++frontier_level_;
+            continue;
+        }
 
-    boost::optional<Trace> trace;
+        auto n = frontier_[frontier_level_].front();
+        frontier_[frontier_level_].pop();
 
-    try
-    {
-        bfs_execution_visitor vis(*this);
-        breadth_first_search(graph_, vertex(0, graph_), visitor(vis));
-    }
-    catch(FoundTrace<decltype(VertexProperty::trace_id)>& found)
-    {
-        trace = boost::optional<Trace>(Trace(found.trace_, Trace::Blocks()));
-        last_selected_ = trace->get_id();
+        discovery_[n] = Discovery::visited;
+        discover_children(n);
+
+        const auto& trace_id = node_trace_id(n);
+
+        if(!executed(trace_id))
+        {
+            executed(Trace(trace_id, Trace::Blocks()), true);
+            last_selected_ = trace_id;
+
+            return boost::optional<Trace>(Trace(trace_id, Trace::Blocks()));
+        }
     }
 
-    return trace;
+    return boost::optional<Trace>();
 }
 
 void TraceGraph::submit_executed(const Trace& trace)
@@ -365,139 +403,119 @@ void TraceGraph::print_graph(bool only_branches,
         scores.insert(t.second);
     }
 
-    if(only_branches)
-    {
-        auto branch_only_graph = compress_to_branches(graph_);
-        write_file_total(*this, branch_only_graph, trace_scores, scores, elf_entries);
-    }
-    else
-    {
-        write_file_total(*this, graph_, trace_scores, scores, elf_entries);
-    }
-}
-
-std::string TraceGraph::last_selected() const
-{
-    return last_selected_;
-}
-
-optional<Trace> TraceGraph::select_by_recursive_score(std::function<Score(const Blocks&)> calculate_score) const
-{
-    auto vs = vertices(graph_);
-
-    auto root = *vs.first;
-
-    auto trace = select_by_recursive_score(calculate_score, root, graph_);
+    if(spans_.empty())
+        return;
 
-    return trace;
-}
+    // The graph is branch-only already; expand the spans into a vertex per block if asked to.
+    auto g = Graph{};
+    auto origin = label_writer::Origin{};
+    auto pending = std::queue<std::pair<Node, boost::optional<Vertex>>>{}; // <node, output vertex of its parent>
 
-optional<Trace> TraceGraph::select_by_recursive_score(std::function<Score(const Blocks&)> calculate_score,
-                                            const Vertex& root,
-                                            const Graph& graph) const
-{
-    auto odegree = out_degree(root, graph);
+    pending.push(std::make_pair(Node{0}, boost::optional<Vertex>{}));
 
-    auto leaf = bool{odegree == 0};
-    if(leaf)
+    while(!pending.empty())
     {
-        auto trace = Trace{ graph[root].trace_id , Blocks{} };
+        auto n = pending.front().first;
+        auto parent = pending.front().second;
+        pending.pop();
 
-        if(!executed(trace))
-            return trace;
+        const auto& span = spans_[n];
 
-        return optional<Trace>{};
-    }
+        for(auto i = only_branches ? span.size - 1 : 0; i < span.size; ++i) // A span is labelled by the block it ends on.
+        {
+            auto v = add_vertex(g);
+            origin.push_back(std::make_pair(n, i));
 
-    auto edges = out_edges(root, graph);
+            if(parent)
+                add_edge(*parent, v, g);
 
-    auto nonbranch = bool{odegree == 1};
-    if(nonbranch)
-    {
-        return select_by_recursive_score(calculate_score,
-                                         target(*edges.first, graph),
-                                         graph);
-    }
+            parent = v;
+        }
 
-    auto branch_scores = BranchScoreMap{};
+        for(auto c = span.first_child; c != no_node; c = spans_[c].next_sibling)
+        {
+            pending.push(std::make_pair(c, parent));
+        }
+    }
 
-    for(;
-        edges.first != edges.second;
-        ++edges.first)
-    {
-        auto tv = target(*edges.first, graph);
+    write_file_total(*this, g, origin, trace_scores, scores, elf_entries);
+}
 
-        auto blocks = Blocks{};
+std::string TraceGraph::last_selected() const
+{
+    return last_selected_;
+}
 
-        collect_descendant_blocks(tv, graph, blocks);
+TraceGraph::Blocks TraceGraph::trace_blocks(const Trace::ID& trace_id) const
+{
+    auto blocks = Blocks{};
+    auto h = trace_ids_.find(trace_id);
 
-        auto score = calculate_score(blocks);
+    if(!h || *h >= leaves_.size() || leaves_[*h] == no_node)
+        return blocks;
 
-        branch_scores.insert(std::make_pair(score,
-                                            tv));
-    }
+    auto path = Nodes{};
 
+    for(auto n = leaves_[*h]; n != no_node; n = spans_[n].parent)
+        path.push_back(n);
 
-    for(const auto& bs : branch_scores)
+    for(auto n : adaptors::reverse(path))
     {
-        auto lowest_scoring = bs.second;
+        auto first = blocks_.begin() + spans_[n].first;
 
-        auto trace = select_by_recursive_score(calculate_score, lowest_scoring, graph);
-        if(trace)
-            return trace;
+        blocks.insert(blocks.end(), first, first + spans_[n].size);
     }
 
-    return optional<Trace>{}; // All child traces have been executed.
+    return blocks;
 }
 
-void TraceGraph::collect_descendant_blocks(const TraceGraph::Vertex& root,
-                                           const TraceGraph::Graph& graph,
-                                           TraceGraph::Blocks& blocks) const
+optional<Trace> TraceGraph::select_by_subtree_score(std::function<Score(const SubtreeStats&)> calculate_score) const
 {
-    const auto& block = graph[root].unique_hash;
-
-    blocks.push_back(block);
+    if(spans_.empty() || subtree_stats_[0].unexecuted_leaves == 0)
+        return optional<Trace>{};
 
-    auto edges = out_edges(root, graph);
+    auto n = Node{0};
 
-    for(;
-        edges.first != edges.second;
-        ++edges.first)
+    // Subtrees are only entered if they hold a trace to execute, so the walk never backtracks.
+    while(spans_[n].first_child != no_node)
     {
-        auto tv = target(*edges.first, graph);
+        auto lowest = no_node;
+        auto lowest_score = Score{0};
 
-        collect_descendant_blocks(tv, graph, blocks);
-    }
-}
+        for(auto c = spans_[n].first_child; c != no_node; c = spans_[c].next_sibling)
+        {
+            if(subtree_stats_[c].unexecuted_leaves == 0)
+                continue;
 
-bool TraceGraph::is_subgraph(const TraceGraph::Graph& trace, const TraceGraph::Vertex& divergence)
-{
-    if(out_degree(divergence, trace) == 0)
-        return true;
-    return false;
-}
+            auto score = calculate_score(subtree_stats_[c]);
 
-bool TraceGraph::is_supergraph_prev_trace(const TraceGraph::Graph& trace,
-                                          const TraceGraph::Vertex& trace_diverge,
-                                          const TraceGraph::Vertex& graph_diverge)
-{
-    if(out_degree(graph_diverge, graph_) == 0 &&
-       out_degree(trace_diverge, trace) != 0)
-        return true;
+            if(lowest == no_node || score < lowest_score)
+            {
+                lowest = c;
+                lowest_score = score;
+            }
+        }
+
+        assert(lowest != no_node);
+
+        n = lowest;
+    }
 
-    return false;
+    return Trace{ node_trace_id(n) , Blocks{} };
 }
 
-void TraceGraph::back_insert(const std::string& trace_id,
-                             const std::string& prev_trace_id,
-                             const std::vector<Vertex>& path)
+void TraceGraph::back_insert(TraceIdTable::Handle trace_id,
+                             TraceIdTable::Handle prev_trace_id,
+                             const Nodes& path)
 {
-    for(auto& v : adaptors::reverse(path))
+    for(auto n : adaptors::reverse(path))
     {
-        if(graph_[v].trace_id == prev_trace_id)
+        if(spans_[n].trace_id == prev_trace_id)
         {
-            graph_[v].trace_id = trace_id;
-//            graph_[v].block = 0; //"superceded<block_name_here>"; // TODO: extract the new, corresponding trace[v].block.
+            spans_[n].trace_id = trace_id;
+
+            if(discovery_[n] == Discovery::visited) // Visited for the previous trace, but this one's to be executed.
+                discover(n, levels_[n]);
         }
         else
         {
@@ -506,256 +524,296 @@ void TraceGraph::back_insert(const std::string& trace_id,
     }
 }
 
-bool TraceGraph::merge_trace(const TraceGraph::Graph& trace)
+bool TraceGraph::merge_trace(const Trace& trace)
 {
-//    using IndexMap = property_map<Graph, vertex_index_t>::type;
-//    IndexMap index = get(vertex_index, graph);
-
-    auto tvs = vertices(trace);
-    auto evs = vertices(graph_);
+    const auto& blocks = trace.get_blocks();
 
-    if(tvs.first == tvs.second ||
-       evs.first == evs.second)
+    if(blocks.empty() ||
+       spans_.empty())
         return false;
 
-    auto tv = *tvs.first;
-    auto ev = *evs.first;
+    assert(blocks.front() == blocks_[spans_[0].first]); // First vertex is incorrect (should never happen, if my thinking is correct).
 
-    assert(trace[tv] == graph_[ev]); // First vertex is incorrect (should never happen, if my thinking is correct).
+    Nodes path;
+    auto diverge = find_trace_divergence(blocks, path);
 
-    std::vector<Vertex> path;
-    Vertex trace_diverge, existing_diverge;
-    std::tie(trace_diverge, existing_diverge) = find_trace_divergence(trace, tv, ev, path);
-
-    if(is_subgraph(trace, trace_diverge))
+    if(diverge.matched == blocks.size()) // Trace ends within the graph: it's a subgraph.
     {
         return false;
     }
-    else if(is_supergraph_prev_trace(trace, trace_diverge, existing_diverge))
+
+    auto trace_id = trace_ids_.intern(trace.get_id());
+
+    if(diverge.offset < spans_[diverge.node].size) // Diverges mid-span: that's a new branch point.
+    {
+        split(diverge.node, diverge.offset);
+    }
+    else if(spans_[diverge.node].first_child == no_node) // Trace extends a previous trace: a supergraph of it.
     {
-        auto prev_trace_id = graph_[existing_diverge].trace_id;
+        auto prev_trace_id = spans_[diverge.node].trace_id;
+        auto prev_trace = trace_ids_.id(prev_trace_id); // Copy: callbacks may outlive the table.
+
+        // The previous trace's leaf goes, whether grown into the new one's or left above it.
+        if(is_unexecuted(prev_trace_id))
+            add_unexecuted_to_path(diverge.node, -1);
+        set_leaf(prev_trace_id, no_node);
 
-        back_insert(trace[trace_diverge].trace_id, prev_trace_id, path);
-        remove(Trace(prev_trace_id, Trace::Blocks()));
-        std::cout << "Supergraph found. Need to remove subtrace from pool: " << prev_trace_id << " replaced by: " << trace[trace_diverge].trace_id << std::endl;
+        back_insert(trace_id, prev_trace_id, path);
+        remove(Trace(prev_trace, Trace::Blocks()));
+        std::cout << "Supergraph found. Need to remove subtrace from pool: " << prev_trace << " replaced by: " << trace.get_id() << std::endl;
         for(auto& cb : redundant_trace_cbs_)
         {
-            cb(prev_trace_id);
+            cb(prev_trace);
         }
-    }
 
-    auto nexttv = target(*out_edges(trace_diverge, trace).first, trace);
+        auto& span = spans_[diverge.node];
+
+        if(span.first + span.size == blocks_.size()) // The span is the arena's last: grow it in place.
+        {
+            blocks_.insert(blocks_.end(), blocks.begin() + diverge.matched, blocks.end());
+            span.size += blocks.size() - diverge.matched;
 
-    merge_trace(trace, nexttv, existing_diverge);
+            add_blocks_to_path(diverge.node, blocks.begin() + diverge.matched, blocks.end());
+            add_unexecuted_to_path(diverge.node, 1);
+            set_leaf(trace_id, diverge.node);
 
-//    back_insert_block_info(trace, path);
+            return true;
+        }
+    }
+
+    append_span(blocks, diverge.matched, diverge.node, trace_id);
 
     return true;
 }
 
-void TraceGraph::merge_trace(const TraceGraph::Graph& trace,
-                             const TraceGraph::Vertex& trace_diverge,
-                             const TraceGraph::Vertex& existing_diverge)
+TraceGraph::Node TraceGraph::append_span(const Blocks& blocks,
+                                         size_t first,
+                                         Node parent,
+                                         TraceIdTable::Handle trace_id)
 {
-    // Note: maybe there's a provided way to merge the trace to graph_, but I didn't find it.
-    auto u = add_vertex(graph_);
-    graph_[u] = trace[trace_diverge];
-    add_edge(existing_diverge, u, graph_);
+    assert(first < blocks.size());
 
-    auto tedges = out_edges(trace_diverge, trace);
+    auto n = static_cast<Node>(spans_.size());
+    spans_.push_back(Span{blocks_.size(), blocks.size() - first, trace_id, parent, no_node, no_node, no_node});
+    blocks_.insert(blocks_.end(), blocks.begin() + first, blocks.end());
+    subtree_stats_.push_back(SubtreeStats{});
+    discovery_.push_back(Discovery::undiscovered);
+    levels_.push_back(0);
 
-    if(tedges.first == tedges.second)
-        return;
+    if(parent != no_node)
+        add_child(parent, n);
 
-    auto nextv = target(*tedges.first, trace);
+    if(parent == no_node)
+    {
+        discover(n, 0);
+    }
+    else if(discovery_[parent] == Discovery::visited) // Otherwise, it's discovered along with its parent's other children.
+    {
+        auto branch = spans_[parent].first_child != spans_[parent].last_child;
 
-    merge_trace(trace, nextv, u);
+        discover(n, levels_[parent] + (branch ? 1 : 0)); // A lone child stands in for its parent.
+    }
+
+    add_blocks_to_path(n, blocks.begin() + first, blocks.end());
+    add_unexecuted_to_path(n, 1); // A new trace is yet to be executed.
+    set_leaf(trace_id, n);
+
+    return n;
 }
 
-std::pair<TraceGraph::Vertex, TraceGraph::Vertex> TraceGraph::find_trace_divergence(
-        const TraceGraph::Graph& trace,
-        Vertex& tv,
-        Vertex& ev,
-        std::vector<Vertex>& path)
+void TraceGraph::split(Node n, uint64_t offset)
 {
-    path.push_back(ev);
-    auto tv_edges = out_edges(tv, trace);
+    assert(offset > 0 && offset < spans_[n].size);
 
-    if(tv_edges.first == tv_edges.second) // At the end of trace - no child vertex. Trace is a subgraph!
-        return {tv, ev};
+    auto tail = static_cast<Node>(spans_.size());
+    auto span = spans_[n]; // Copy: push_back may reallocate.
 
-    auto nexttv = target(*tv_edges.first, trace);
-    auto edges = out_edges(ev, graph_);
+    spans_.push_back(Span{span.first + offset,
+                          span.size - offset,
+                          span.trace_id,
+                          n,
+                          span.first_child,
+                          span.last_child,
+                          no_node});
 
-    for(; edges.first != edges.second; ++edges.first)
-    {
-        auto targetv = target(*edges.first, graph_);
-        if(trace[nexttv] == graph_[targetv])
-        {
+    auto& head = spans_[n];
 
-            return find_trace_divergence(trace, nexttv, targetv, path);
-        }
-    }
+    head.size = offset;
+    head.first_child = tail;
+    head.last_child = tail;
 
-    return {tv, ev}; // Reached when trace is not a subgraph.
-}
+    for(auto c = span.first_child; c != no_node; c = spans_[c].next_sibling)
+        spans_[c].parent = tail;
 
-void TraceGraph::mark_cache_vertices()
-{
-    auto vs = vertices(graph_);
+    if(span.first_child == no_node)
+        set_leaf(span.trace_id, tail);
+
+    // If n was visited, the tail's trace was found executed, and its children discovered, already.
+    discovery_.push_back(discovery_[n] == Discovery::visited ? Discovery::visited : Discovery::undiscovered);
+    levels_.push_back(levels_[n] + 1);
+
+    // The tail's subtree is n's, less the head's blocks. Sketch whichever part of the span is shorter.
+    auto stats = subtree_stats_[n];
+    auto first = blocks_.cbegin() + span.first;
+
+    stats.blocks -= offset;
 
-    for(; vs.first != vs.second; ++vs.first)
+    if(offset <= span.size - offset)
     {
-        auto v = *vs.first;
-        if(out_degree(v, graph_) > 1)
-        {
-            graph_[v].cache = true;
-        }
+        stats.sketch.subtract(first, first + offset);
     }
+    else
+    {
+        stats.sketch = BlockSketch{};
+        stats.sketch.add(first + offset, first + span.size);
+
+        for(auto c = span.first_child; c != no_node; c = spans_[c].next_sibling)
+            stats.sketch.add(subtree_stats_[c].sketch);
+    }
+
+    subtree_stats_.push_back(stats);
 }
 
-void TraceGraph::remove(const Trace& trace)
+void TraceGraph::add_child(Node parent, Node child)
 {
-    traces_.erase(std::find(traces_.begin(), traces_.end(), trace));
-    assert(executed_traces_.erase(trace) != 0);
+    auto& p = spans_[parent];
+
+    if(p.last_child == no_node)
+        p.first_child = child;
+    else
+        spans_[p.last_child].next_sibling = child;
+
+    p.last_child = child;
 }
 
-TraceGraph::Graph TraceGraph::compress_to_branches(const TraceGraph::Graph& g) const
+TraceGraph::Divergence TraceGraph::find_trace_divergence(const Blocks& blocks,
+                                                         Nodes& path) const
 {
-    auto vs = vertices(g);
-    auto vfirst = *vs.first;
-    auto compressed = Graph{};
+    auto n = Node{0};
+    auto ti = size_t{0};
+    auto offset = uint64_t{0};
+
+    path.push_back(n);
 
-    if(is_leaf_branch(vfirst, g))
+    for(;;)
     {
-        auto nv = add_vertex(compressed);
-        compressed[nv] = g[vfirst];
-        return compressed;
-    }
+        const auto& span = spans_[n];
+        auto first = blocks_.begin() + span.first + offset;
+        auto count = std::min<uint64_t>(span.size - offset, blocks.size() - ti);
+        auto matched = static_cast<uint64_t>(std::mismatch(first, first + count, blocks.begin() + ti).first - first);
 
-    auto next_v = find_next_branch_or_leaf(vfirst, g);
-    auto nv = add_vertex(compressed);
-    compressed[nv] = g[next_v];
+        offset += matched;
+        ti += matched;
 
-    auto edges = out_edges(next_v, g);
+        if(offset < span.size || ti == blocks.size())
+            break; // Diverges within the span, or the trace ends.
 
-    for(; edges.first != edges.second; ++edges.first)
-    {
-        compress_to_branches(nv,
-                             compressed,
-                             target(*edges.first, g),
-                             g);
-    }
+        auto c = span.first_child;
 
-    return compressed;
-}
+        while(c != no_node && blocks_[spans_[c].first] != blocks[ti])
+            c = spans_[c].next_sibling;
 
-void TraceGraph::compress_to_branches(const TraceGraph::Vertex& parent_comp,
-                                      TraceGraph::Graph& g_comp,
-                                      const Vertex& parent_orig,
-                                      const Graph& g_orig) const
-{
-    if(is_leaf_branch(parent_orig, g_orig))
-    {
-        auto nv = add_vertex(g_comp);
-        g_comp[nv] = g_orig[parent_orig];
-        add_edge(parent_comp, nv, g_comp);
-        return;
+        if(c == no_node)
+            break; // Reached when trace is not a subgraph.
+
+        n = c;
+        offset = 0;
+
+        path.push_back(n);
     }
 
-    auto next_v = find_next_branch_or_leaf(parent_orig, g_orig);
+    return Divergence{ti, n, offset};
+}
 
-    auto nv = add_vertex(g_comp);
-    g_comp[nv] = g_orig[next_v];
-    add_edge(parent_comp, nv, g_comp);
+void TraceGraph::add_blocks_to_path(Node n,
+                                    Blocks::const_iterator first,
+                                    Blocks::const_iterator last)
+{
+    auto sketch = BlockSketch{};
 
-    auto edges = out_edges(next_v, g_orig);
+    sketch.add(first, last);
 
-    for(; edges.first != edges.second; ++edges.first)
+    for(; n != no_node; n = spans_[n].parent)
     {
-        auto t = target(*edges.first, g_orig);
-        compress_to_branches(nv,
-                             g_comp,
-                             t,
-                             g_orig);
+        subtree_stats_[n].blocks += std::distance(first, last);
+        subtree_stats_[n].sketch.add(sketch);
     }
 }
 
-TraceGraph::Vertex TraceGraph::find_next_branch_or_leaf(const TraceGraph::Vertex& parent,
-                                                        const TraceGraph::Graph& g) const
+void TraceGraph::add_unexecuted_to_path(Node n, int32_t count)
 {
-    auto degree = out_degree(parent, g);
-
-    if(degree != 1)
-        return parent;
+    for(; n != no_node; n = spans_[n].parent)
+        subtree_stats_[n].unexecuted_leaves += count;
+}
 
-    auto only_child = target(*out_edges(parent, g).first, g);
+void TraceGraph::set_leaf(TraceIdTable::Handle trace_id, Node n)
+{
+    if(leaves_.size() <= trace_id)
+        leaves_.resize(trace_id + 1, no_node);
 
-    return find_next_branch_or_leaf(only_child, g);
+    leaves_[trace_id] = n;
 }
 
-bool TraceGraph::is_leaf_branch(const TraceGraph::Vertex& v, const TraceGraph::Graph& g) const
+bool TraceGraph::is_unexecuted(TraceIdTable::Handle trace_id) const
 {
-    auto odegree = out_degree(v, g);
-    if(odegree == 0)
-        return true;
-    else if(odegree != 1)
-        return false;
+    auto it = executed_traces_.find(Trace(trace_ids_.id(trace_id), Trace::Blocks()));
 
-    auto only_child = target(*out_edges(v, g).first, g);
-
-    return is_leaf_branch(only_child, g);
+    return it != executed_traces_.end() && !it->second;
 }
 
-//void TraceGraph::back_insert_block_info(const Trace& trace,
-//                                        const std::vector<TraceGraph::Vertex>& path)
-//{
-//    const auto& blocks = trace.get_blocks();
+void TraceGraph::executed(const Trace& trace, bool exec)
+{
+    auto& e = executed_traces_.at(trace);
 
-//    assert(blocks.size() == path.size());
+    if(e == exec)
+        return;
 
-//    auto size = blocks.size();
+    e = exec;
 
-//    for(auto i = 0u; i < size; ++i)
-//    {
-//        graph_[path[i]].block = blocks[i];
-//    }
-//}
+    auto h = trace_ids_.find(trace.get_id());
 
-bool operator==(const VertexProperty& rhs, const VertexProperty& lhs)
-{
-    return rhs.unique_hash == lhs.unique_hash;
+    if(h && *h < leaves_.size() && leaves_[*h] != no_node)
+        add_unexecuted_to_path(leaves_[*h], exec ? -1 : 1);
 }
 
-bool operator!=(const VertexProperty& rhs, const VertexProperty& lhs)
+void TraceGraph::discover(Node n, uint32_t level)
 {
-    return !(rhs == lhs);
-}
+    if(discovery_[n] == Discovery::queued)
+        return;
 
-TraceGraph::Graph make_graph(const Trace& trace)
-{
-    auto size = trace.size();
+    discovery_[n] = Discovery::queued;
+    levels_[n] = level;
 
-    TraceGraph::Graph g(size);
+    if(frontier_.size() <= level)
+        frontier_.resize(level + 1);
 
-    static auto count = 0u; // TODO: temporary - use trace.get_id() instead.
+    frontier_[level].push(n);
+    frontier_level_ = std::min<size_t>(frontier_level_, level);
+}
 
-    for(size_t i = 1; i < size; ++i)
-    {
-        add_edge(i - 1, i, g);
-    }
-    for(size_t i = 0; i < size; ++i)
+void TraceGraph::discover_children(Node n)
+{
+    for(auto c = spans_[n].first_child; c != no_node; c = spans_[c].next_sibling)
     {
-        g[i].unique_hash = trace.get_blocks()[i];
+        auto relevant = c;
 
+        while(spans_[relevant].first_child != no_node &&
+              spans_[relevant].first_child == spans_[relevant].last_child) // Not a branch point: look through it.
+        {
+            discovery_[relevant] = Discovery::visited;
+            levels_[relevant] = levels_[n] + 1;
+            relevant = spans_[relevant].first_child;
+        }
 
-//        g[i].trace_id = std::to_string(count); // TODO: temporary. Should use the actual id: trace.get_id();.
-        g[i].trace_id = trace.get_id();
+        if(discovery_[relevant] == Discovery::undiscovered)
+            discover(relevant, levels_[n] + 1);
     }
+}
 
-    ++count;
-
-    return g;
+void TraceGraph::remove(const Trace& trace)
+{
+    traces_.erase(std::find(traces_.begin(), traces_.end(), trace));
+    assert(executed_traces_.erase(trace) != 0);
 }
 
 size_t crete::TraceHash::operator()(const crete::Trace& trace) const
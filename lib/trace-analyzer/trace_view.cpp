@@ -0,0 +1,201 @@
+#include <crete/trace_view.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace crete
+{
+
+TraceView::TraceView(const fs::path& path) :
+    id_(path.parent_path().generic_string()),
+    map_(MAP_FAILED),
+    map_size_(0),
+    blocks_(0),
+    size_(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd == -1)
+        throw runtime_error("failed to open file: " + path.generic_string());
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw runtime_error("failed to stat file: " + path.generic_string());
+    }
+
+    map_size_ = static_cast<size_t>(st.st_size);
+
+    if(map_size_ >= sizeof(Trace::Block)) // mmap rejects zero-length mappings.
+    {
+        map_ = mmap(0, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(map_ == MAP_FAILED)
+        {
+            int err = errno;
+            close(fd);
+            throw runtime_error("failed to map file (" + string(strerror(err)) + "): " + path.generic_string());
+        }
+
+        madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+        blocks_ = static_cast<const Trace::Block*>(map_);
+        size_ = map_size_ / sizeof(Trace::Block);
+    }
+
+    close(fd); // The mapping outlives the descriptor.
+}
+
+TraceView::TraceView(const fs::path& trace_dir,
+                     const boost::shared_ptr<const TraceContainer>& container) :
+    id_(trace_dir.generic_string()),
+    container_(container),
+    map_(MAP_FAILED),
+    map_size_(0),
+    blocks_(0),
+    size_(0)
+{
+    const TraceContainer::Section s = container_->section("tb-seq.bin");
+
+    blocks_ = reinterpret_cast<const Trace::Block*>(s.data); // Sections are 8-byte aligned.
+    size_ = s.size / sizeof(Trace::Block);
+}
+
+TraceView::TraceView(const fs::path& trace_dir,
+                     const boost::shared_ptr<const vector<uint8_t> >& data) :
+    id_(trace_dir.generic_string()),
+    data_(data),
+    map_(MAP_FAILED),
+    map_size_(0),
+    blocks_(0),
+    size_(0)
+{
+    blocks_ = reinterpret_cast<const Trace::Block*>(data_->data()); // Allocations are aligned for any scalar.
+    size_ = data_->size() / sizeof(Trace::Block);
+}
+
+TraceView::~TraceView()
+{
+    if(map_ != MAP_FAILED)
+        munmap(map_, map_size_);
+}
+
+Trace TraceView::to_trace() const
+{
+    return Trace(id_, Trace::Blocks(begin(), end()));
+}
+
+TraceViewCache::TraceViewCache(size_t capacity) :
+    capacity_(capacity > 0 ? capacity : 1),
+    clock_(0),
+    maps_(0)
+{
+}
+
+TraceViewCache::View TraceViewCache::get(const fs::path& trace_dir)
+{
+    const string key = trace_dir.generic_string();
+
+    boost::unordered_map<string, Entry>::iterator it = entries_.find(key);
+
+    if(it != entries_.end())
+    {
+        it->second.last_used = ++clock_;
+
+        return it->second.view;
+    }
+
+    Entry e;
+    e.view = open(trace_dir);
+    e.last_used = ++clock_;
+
+    ++maps_;
+
+    if(entries_.size() >= capacity_)
+        evict_lru();
+
+    entries_.insert(make_pair(key, e));
+
+    return e.view;
+}
+
+void TraceViewCache::insert(const fs::path& trace_dir, const View& view)
+{
+    const string key = trace_dir.generic_string();
+
+    if(entries_.count(key) != 0)
+        return;
+
+    Entry e;
+    e.view = view;
+    e.last_used = ++clock_;
+
+    ++maps_;
+
+    if(entries_.size() >= capacity_)
+        evict_lru();
+
+    entries_.insert(make_pair(key, e));
+}
+
+TraceViewCache::View TraceViewCache::open(const fs::path& trace_dir)
+{
+    const fs::path container_path = trace_dir / trace_container_file_name;
+
+    if(fs::exists(container_path))
+        return View(new TraceView(trace_dir, boost::shared_ptr<const TraceContainer>(new TraceContainer(container_path))));
+
+    return View(new TraceView(trace_dir / "tb-seq.bin"));
+}
+
+void TraceViewCache::evict_lru()
+{
+    // Eviction only happens on a miss, which is dominated by the mmap anyway.
+    boost::unordered_map<string, Entry>::iterator lru = entries_.begin();
+
+    for(boost::unordered_map<string, Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+    {
+        if(it->second.last_used < lru->second.last_used)
+            lru = it;
+    }
+
+    entries_.erase(lru);
+}
+
+bool TraceViewCache::contains(const fs::path& trace_dir) const
+{
+    return entries_.count(trace_dir.generic_string()) != 0;
+}
+
+void TraceViewCache::erase(const fs::path& trace_dir)
+{
+    entries_.erase(trace_dir.generic_string());
+}
+
+void TraceViewCache::clear()
+{
+    entries_.clear();
+}
+
+size_t TraceViewCache::count() const
+{
+    return entries_.size();
+}
+
+uint64_t TraceViewCache::maps() const
+{
+    return maps_;
+}
+
+} // namespace crete
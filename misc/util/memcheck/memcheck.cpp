@@ -255,13 +255,11 @@ void MemoryCheckerExecutor::process_log(const filesystem::path& log_path)
             fs::create_directory(defect_dir);
         }
 
-        auto current_tc = current_test_case();
-        auto tc_filename = current_tc.filename();
-        // Boost 1.55 copy_file won't work with -std=c++11 (bug), so have to use alternative.
-        // TODO: replace with fs::copy_file after upgrading Boost.
-        fs::ifstream ifs_tc(current_tc);
-        fs::ofstream ofs_tc(defect_dir / tc_filename);
-        ofs_tc << ifs_tc.rdbuf();
+        auto tc_filename = current_test_case().filename();
+        // Written from the loaded test case, as packed test cases have no file of their own.
+        fs::ofstream ofs_tc(defect_dir / tc_filename,
+                            std::ios_base::out | std::ios_base::binary);
+        current_test().write(ofs_tc);
 
         fs::rename(log_path,
                    defect_dir / (tc_filename.generic_string() + ".report." + to_string(type_) + ".txt"));